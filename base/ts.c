@@ -12,10 +12,22 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <math.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 
 #include "ts.h"
+#include "ts_packet.h"
+#include "ts_bitrate.h"
+#include "ts_reader.h"
+#include "ts_analyze.h"
+#include "ts_trace.h"
+#include "ts_timeline.h"
+#include "ts_jitter.h"
+#include "ts_pes.h"
+#include "ts_stats.h"
 
 #define	DEBUG	1
 #if DEBUG
@@ -30,246 +42,860 @@
 */
 #define BIT_RATE_COUNT_PCR		( 1000 )
 
+/**
+* @def		DUMP_BUFFER_SIZE
+* @brief	Output buffer of the dump. Flushed with write() when less than one line is left
+*/
+#define DUMP_BUFFER_SIZE		( 4 * 1024 * 1024 )
+#define DUMP_LINE_MAX			( 2048 )
+
+/**
+* @def		OPTION_STATS
+* @brief	getopt_long() value of --stats
+*/
+#define OPTION_STATS			( 0x100 )
+
+/**
+* @def		OPTION_NO_CACHE
+* @brief	getopt_long() value of --no-cache
+*/
+#define OPTION_NO_CACHE			( 0x101 )
+
+/**
+* @brief	Columns of the header dump
+*/
+typedef enum {
+	DUMP_COLUMN_SYNC_BYTE = 0,
+	DUMP_COLUMN_TEI,
+	DUMP_COLUMN_PUSI,
+	DUMP_COLUMN_PRIORITY,
+	DUMP_COLUMN_PID,
+	DUMP_COLUMN_SCRAMBLE,
+	DUMP_COLUMN_ADAPTATION_CONTROL,
+	DUMP_COLUMN_CC,
+	DUMP_COLUMN_PCR,
+	DUMP_COLUMN_ADAPTATION_FIELD,
+	DUMP_COLUMN_RAW,
+	DUMP_COLUMN_MAX,
+} DUMP_COLUMN;
+
+#define DUMP_COLUMN_ALL			( ( 1 << DUMP_COLUMN_MAX ) - 1 )
+
+typedef struct {
+	char*		Buffer;
+	size_t		Length;
+	int			Fd;
+} DUMP_OUTPUT;
+
+/**
+* @brief	Destination of the PES demux
+*/
+typedef struct {
+	const char*	Prefix;					// NULL lists the PES instead of writing them
+	int			Fd[ 8192 ];				// -1 when not selected, or closed after a write error
+	bool		Error;
+	int			ErrorNumber;			// errno of the first write error
+	uint16_t	ErrorPid;
+} ES_OUTPUT;
+
 struct {
 	bool		DumpTsHeader;			// Dump TS Header
+	uint32_t	DumpColumns;			// Bit mask of DUMP_COLUMN
 	bool		CalcTsBitrate;			// Calculate bitrate 
 	uint32_t	BitrateCountPcr;
+	bool		ShowStats;				// Per PID summary
+	uint32_t	Threads;				// Worker threads of the analysis
+	char*		TracePrefix;			// Write header trace
+	uint32_t	BitrateWindow;			// Bitrate time line window ( ms )
+	bool		ShowJitter;				// PCR accuracy
+	bool		ShowHistogram;			// Histograms of the PCR accuracy
+	char*		PesPids;				// PIDs of the PES demux, comma separated
+	char*		EsPrefix;				// Write elementary streams
+	TS_READER_MODE	ReaderMode;			// -A, --no-cache
 } Options;
 
+static	const char*		DumpColumnName[ DUMP_COLUMN_MAX ] = {
+	"Sync byte",
+	"Transport Error Indicator",
+	"Payload Unit Start Indicator",
+	"Transport Priority",
+	"PID",
+	"Transport Scrambling Control",
+	"Adaptation field control",
+	"Continuity counter",
+	"PCR",
+	"Adaptation field",
+	"TS Packet raw data",
+};
+
+// Labels are indexed by the 2 bit field. Odd key has always been shown as reserved.
+static	const char*		ScrambleName[ 4 ] = {
+	"Not scrambled",
+	"Reserved for future use",
+	"Scrambled with even key",
+	"Reserved for future use",
+};
+
+static	const char*		AdaptationControlName[ 4 ] = {
+	"Reserved for future use",
+	"Payload only",
+	"Adaptation field only",
+	"Adaptation field followed by payload",
+};
+
+// "XX" of every byte value. The third byte is the separator written by dump_put_hex().
+static	char			HexTable[ 256 ][ 2 ];
+
+static	const struct option	LongOptions[] = {
+	{ "stats",		optional_argument,	NULL,	OPTION_STATS },
+	{ "no-cache",	no_argument,		NULL,	OPTION_NO_CACHE },
+	{ NULL,			0,					NULL,	0 },
+};
+
 
 static	bool			ts_dump( const char* ts_file );
-static	void			ts_dump_header( const uint8_t* ts_packet, const uint8_t ts_packet_length );
-static	double			ts_calc_bitrate( const char* ts_file, const uint32_t use_pcr_count );
+static	void			ts_dump_header( DUMP_OUTPUT* out, const uint8_t* ts_packet, const TS_PACKET_BATCH* batch, uint32_t n );
+static	bool			ts_show_stats( const char* ts_file, uint32_t threads );
+static	bool			ts_write_trace( const char* ts_file, const char* prefix );
+static	bool			ts_show_bitrate_timeline( const char* ts_file, uint32_t window_ms );
+static	bool			ts_show_jitter( const char* ts_file, bool histogram );
+static	bool			ts_demux_pes( const char* ts_file, const char* pid_list, const char* prefix );
+static	void			ts_demux_pes_handler( void* context, const TS_PES* pes );
+static	bool			write_all( int fd, const uint8_t* data, size_t size );
+static	bool			parse_columns( const char* list, uint32_t* columns );
 static	void			show_help( void );
 
+static	bool			dump_flush( DUMP_OUTPUT* out );
+static inline	void	dump_put_str( DUMP_OUTPUT* out, const char* str );
+static inline	void	dump_put_hex( DUMP_OUTPUT* out, const uint8_t* data, uint32_t length, char separator );
+static inline	void	dump_put_dec( DUMP_OUTPUT* out, uint64_t value );
+static inline	void	dump_put_hexnum( DUMP_OUTPUT* out, uint32_t value );
+
+/**
+* @brief		Write out buffered text
+* @param[in]	out				Output
+* @return		bool			false if write failed
+*/
+static	bool			dump_flush( DUMP_OUTPUT* out )
+{
+	size_t		done = 0;
+	ssize_t		written;
+	
+	while( done < out->Length ){
+		written = write( out->Fd, &out->Buffer[ done ], out->Length - done );
+		if( 0 < written ){
+			done += written;
+		}else if( ( 0 > written ) && ( EINTR == errno ) ){
+			continue;
+		}else{
+			out->Length = 0;
+			return false;
+		}
+	}
+	out->Length = 0;
+	
+	return true;
+}
+
+/**
+* @brief		Append string
+* @param[in]	out				Output
+* @param[in]	str				String
+*/
+static inline	void	dump_put_str( DUMP_OUTPUT* out, const char* str )
+{
+	size_t		length = strlen( str );
+	
+	memcpy( &out->Buffer[ out->Length ], str, length );
+	out->Length += length;
+}
+
+/**
+* @brief		Append bytes in hexadecimal
+* @param[in]	out				Output
+* @param[in]	data			Bytes
+* @param[in]	length			Number of bytes
+* @param[in]	separator		Character after every byte
+*/
+static inline	void	dump_put_hex( DUMP_OUTPUT* out, const uint8_t* data, uint32_t length, char separator )
+{
+	char*		p = &out->Buffer[ out->Length ];
+	uint32_t	i;
+	
+	for( i = 0 ; i < length ; i++, p += 3 ){
+		memcpy( p, HexTable[ data[ i ] ], 2 );
+		p[ 2 ] = separator;
+	}
+	out->Length += ( size_t )length * 3;
+}
+
+/**
+* @brief		Append unsigned decimal
+* @param[in]	out				Output
+* @param[in]	value			Value
+*/
+static inline	void	dump_put_dec( DUMP_OUTPUT* out, uint64_t value )
+{
+	char		digits[ 20 ];
+	uint32_t	n = 0;
+	
+	do{
+		digits[ n++ ] = '0' + ( value % 10 );
+		value /= 10;
+	}while( 0 < value );
+	
+	while( 0 < n ){
+		out->Buffer[ out->Length++ ] = digits[ --n ];
+	}
+}
+
+/**
+* @brief		Append hexadecimal number without leading zeros
+* @param[in]	out				Output
+* @param[in]	value			Value
+*/
+static inline	void	dump_put_hexnum( DUMP_OUTPUT* out, uint32_t value )
+{
+	int			shift = 28;
+	
+	while( ( 0 < shift ) && ( 0 == ( value >> shift ) ) ){
+		shift -= 4;
+	}
+	for( ; 0 <= shift ; shift -= 4 ){
+		out->Buffer[ out->Length++ ] = "0123456789ABCDEF"[ ( value >> shift ) & 0x0F ];
+	}
+}
+
 /**
 * @brief		Dump TS Packet
 * @param[in]	in_filename		Input TS file path
 * @return		bool			Result
-* @details		Display data of TS packet in hexadecimal.
+* @details		Display data of TS packet in hexadecimal.\n
+*				Lines are formatted into a large buffer and written to stdout with write().
 */
 static	bool			ts_dump( const char* ts_file )
 {
-	FILE*		ifp = NULL;
+	TS_READER			reader;
+	DUMP_OUTPUT			out;
 	
-	uint8_t		i;
-	uint8_t		ts_buffer[ TS_PACKET_SIZE ];
+	uint32_t			i;
+	const uint8_t*		ts_buffer = NULL;
+	TS_PACKET_BATCH*	batch = NULL;
+	uint32_t			read_count;
+	uint32_t			n;
+	bool				show_raw = true;
 	
-	bool		result = false;
+	bool				result = false;
 	
-	ifp = fopen( ts_file, "rb" );
-	if( ifp ){
-		while( TS_PACKET_SIZE == fread( ts_buffer, 1, sizeof( ts_buffer ), ifp ) ){
-			if( TS_SYNC_BYTE != ts_buffer[ 0 ] ){
-				continue;
-			}
-			
-			if( Options.DumpTsHeader ){
-				ts_dump_header( ts_buffer, TS_PACKET_SIZE );
+	for( i = 0 ; i < 256 ; i++ ){
+		HexTable[ i ][ 0 ] = "0123456789ABCDEF"[ i >> 4 ];
+		HexTable[ i ][ 1 ] = "0123456789ABCDEF"[ i & 0x0F ];
+	}
+	
+	memset( &out, 0, sizeof( out ) );
+	out.Fd = STDOUT_FILENO;
+	out.Buffer = malloc( DUMP_BUFFER_SIZE );
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( ( NULL == out.Buffer ) || ( NULL == batch ) ){
+		free( out.Buffer );
+		free( batch );
+		return false;
+	}
+	
+	if( ts_reader_open( &reader, ts_file, Options.ReaderMode ) ){
+		result = true;
+		
+		if( Options.DumpTsHeader ){
+			show_raw = ( Options.DumpColumns & ( 1 << DUMP_COLUMN_RAW ) ) ? true : false;
+			for( i = 0 ; i < DUMP_COLUMN_MAX ; i++ ){
+				if( Options.DumpColumns & ( 1 << i ) ){
+					if( 0 < out.Length ){
+						dump_put_str( &out, "," );
+					}
+					dump_put_str( &out, DumpColumnName[ i ] );
+				}
 			}
+			dump_put_str( &out, "\n" );
+		}
+		
+		while( result && ( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+			ts_parse_batch( ts_buffer, read_count, batch );
 			
-			for( i = 0 ; i < TS_PACKET_SIZE ; i++ ){
-				printf( "%02X,", ts_buffer[ i ] );
+			for( n = 0 ; n < batch->Count ; n++ ){
+				if( DUMP_BUFFER_SIZE - DUMP_LINE_MAX < out.Length ){
+					if( !dump_flush( &out ) ){
+						result = false;
+						break;
+					}
+				}
+				
+				if( Options.DumpTsHeader ){
+					ts_dump_header( &out, &ts_buffer[ n * TS_PACKET_SIZE ], batch, n );
+				}
+				if( show_raw ){
+					dump_put_hex( &out, &ts_buffer[ n * TS_PACKET_SIZE ], TS_PACKET_SIZE, ',' );
+				}
+				out.Buffer[ out.Length++ ] = '\n';
 			}
-			printf( "\n" );
+		}
+		if( result ){
+			result = dump_flush( &out );
 		}
 		
-		fclose( ifp );
-		result = true;
+		if( 0 < reader.ResyncCount ){
+			fprintf( stderr, "%s: Resync = %lu / Skipped bytes = %lu\n", ts_file, reader.ResyncCount, reader.SkippedBytes );
+		}
+		ts_reader_close( &reader );
 	}else{
 		perror( "Input file open." );
 	}
+	
+	free( batch );
+	free( out.Buffer );
 
 	return result;
 }
 
 /**
 * @brief		Dump TS Packet header
-* @param[in]	ts_packet			TS packet
-* @param[in]	ts_packet_length	length of ts_packet
+* @param[in]	out				Output
+* @param[in]	ts_packet		TS packet
+* @param[in]	batch			Decoded headers
+* @param[in]	n				Index of ts_packet in batch
 * @return		void
-* @details		Display data of TS packet header.
+* @details		Display data of TS packet header.\n
+*				Only the columns selected in Options.DumpColumns are written, each followed by a comma.
 */
-static	void			ts_dump_header( const uint8_t* ts_packet, const uint8_t ts_packet_length )
+static	void			ts_dump_header( DUMP_OUTPUT* out, const uint8_t* ts_packet, const TS_PACKET_BATCH* batch, uint32_t n )
 {
-	TS_HEADER		header;
+	uint32_t		columns = Options.DumpColumns;
+	uint16_t		flags = batch->Flags[ n ];
+	uint8_t			adaptation_control = ( ts_packet[ 3 ] & 0x30 ) >> 4;
+	
+	if( columns & ( 1 << DUMP_COLUMN_SYNC_BYTE ) ){
+		dump_put_str( out, "0x" );
+		dump_put_hex( out, ts_packet, 1, ',' );
+	}
+	if( columns & ( 1 << DUMP_COLUMN_TEI ) ){
+		dump_put_str( out, ( flags & TS_PKT_FLAG_TEI ) ? "NG," : "OK," );
+	}
+	if( columns & ( 1 << DUMP_COLUMN_PUSI ) ){
+		dump_put_str( out, ( flags & TS_PKT_FLAG_PUSI ) ? "ON," : "OFF," );
+	}
+	if( columns & ( 1 << DUMP_COLUMN_PRIORITY ) ){
+		dump_put_str( out, ( flags & TS_PKT_FLAG_PRIORITY ) ? "Higher," : "Normal," );
+	}
+	if( columns & ( 1 << DUMP_COLUMN_PID ) ){
+		dump_put_str( out, "0x" );
+		dump_put_hexnum( out, batch->Pid[ n ] );
+		dump_put_str( out, "," );
+	}
+	if( columns & ( 1 << DUMP_COLUMN_SCRAMBLE ) ){
+		dump_put_str( out, ScrambleName[ TS_PKT_SCRAMBLE( flags ) ] );
+		dump_put_str( out, "," );
+	}
+	if( columns & ( 1 << DUMP_COLUMN_ADAPTATION_CONTROL ) ){
+		dump_put_str( out, AdaptationControlName[ adaptation_control ] );
+		dump_put_str( out, "," );
+	}
+	if( columns & ( 1 << DUMP_COLUMN_CC ) ){
+		dump_put_dec( out, batch->ContinuityCounter[ n ] );
+		dump_put_str( out, "," );
+	}
+	if( columns & ( 1 << DUMP_COLUMN_PCR ) ){
+		if( flags & TS_PKT_FLAG_PCR ){
+			dump_put_dec( out, batch->Pcr[ n ] );
+			dump_put_str( out, "," );
+		}else{
+			dump_put_str( out, "-," );
+		}
+	}
+	if( columns & ( 1 << DUMP_COLUMN_ADAPTATION_FIELD ) ){
+		if(    ( PID_NULL == batch->Pid[ n ] )
+			|| ( TS_ADAPTATION_FIELD_CONTROL_NONE == adaptation_control ) ){
+			dump_put_str( out, "-," );
+		}else{
+			// From adaptation_field_length, adaptation_field_length bytes.
+			uint32_t	length = ts_packet[ 4 ];
+			
+			if( TS_PACKET_SIZE - 4 < length ){
+				length = TS_PACKET_SIZE - 4;
+			}
+			dump_put_hex( out, &ts_packet[ 4 ], length, ' ' );
+			dump_put_str( out, "," );
+		}
+	}
+}
 
-	static	bool	show_header = true;
+
+/**
+* @brief		Show per PID summary
+* @param[in]	ts_file			TS file path
+* @param[in]	threads			Number of worker threads
+* @return		bool			Result
+* @details		All counters are collected in one pass over the file.\n
+*				Bitrate is calculated from the PCR of the PID with the most PCRs.
+*/
+static	bool			ts_show_stats( const char* ts_file, uint32_t threads )
+{
+	TS_ANALYSIS*	analysis;
+	uint32_t		pid;
+	uint32_t		pcr_pid = PID_NULL;
+	double			duration = 0.0;
 	
-	assert( TS_PACKET_SIZE == ts_packet_length );
+	analysis = malloc( sizeof( TS_ANALYSIS ) );
+	if( NULL == analysis ){
+		return false;
+	}
+	if( !ts_analyze_file( ts_file, Options.ReaderMode, threads, analysis ) ){
+		perror( "Input file open." );
+		free( analysis );
+		return false;
+	}
 	
-	header.SyncByte						 = ts_packet[ 0 ];
-	header.TransportErrorIndicator		 = ( 0x80 & ts_packet[ 1 ] ) >> 7;
-	header.PayloadUnitStartIndicator	 = ( 0x40 & ts_packet[ 1 ] ) >> 6;
-	header.TransportPriority			 = ( 0x20 & ts_packet[ 1 ] ) >> 6;
-	header.Pid							 = GET_PID( ts_packet[ 1 ], ts_packet[ 2 ]  );
-	header.TransportScramblingControl	 = ( ts_packet[ 3 ] & 0xC0 ) >> 6;
-	header.AdaptationFieldControl		 = ( ts_packet[ 3 ] & 0x30 ) >> 4;
-	header.ContinuityCounter			 = ts_packet[ 3 ] & 0x0F;
+	for( pid = 0 ; pid < TS_PID_MAX ; pid++ ){
+		if(    ( analysis->Pid[ pid ].PcrCount > 1 )
+			&& ( ( PID_NULL == pcr_pid ) || ( analysis->Pid[ pid ].PcrCount > analysis->Pid[ pcr_pid ].PcrCount ) ) ){
+			pcr_pid = pid;
+		}
+	}
+	if(    ( PID_NULL != pcr_pid )
+		&& ( analysis->Pid[ pcr_pid ].LastPcr > analysis->Pid[ pcr_pid ].FirstPcr ) ){
+		const TS_PID_STATS*	stats = &analysis->Pid[ pcr_pid ];
+		
+		// Extend the PCR interval to the whole file by the byte position.
+		duration  = ( stats->LastPcr - stats->FirstPcr ) / ( double )PCR_CLOCK_EXT;
+		duration *= ( double )( analysis->Packets * TS_PACKET_SIZE ) / ( stats->LastPcrOffset - stats->FirstPcrOffset );
+	}
 	
-	if(    (    ( TS_ADAPTATION_FIELD_CONTROL_ONLY == header.AdaptationFieldControl )
-			 || ( TS_ADAPTATION_FIELD_CONTROL_WITH_PAYLOAD == header.AdaptationFieldControl ) )
-		&& ( 0x10 & ts_packet[ 5 ] ) ){
-		GET_PCR_EXT( &ts_packet[ 6 ], header.Pcr );
+	printf( "PID,Packets,Payload bytes,TEI errors,Scrambled(even),Scrambled(odd),Adaptation field,CC errors,PCR,PCR discontinuity,CRC errors,Bitrate(bps)\n" );
+	for( pid = 0 ; pid < TS_PID_MAX ; pid++ ){
+		const TS_PID_STATS*	stats = &analysis->Pid[ pid ];
 		
-	}else{
-		header.Pcr = PCR_NONE;
-	}
-	
-	if( show_header ){
-		printf( "Sync byte,Transport Error Indicator,Payload Unit Start Indicator,"\
-				"Transport Priority,PID,Transport Scrambling Control,"\
-				"Adaptation field control,Continuity counter,PCR,Adaptation field,"\
-				"TS Packet raw data\n");
-		show_header = false;
-	}
-	
-	printf( "0x%02X,%s,%s,%s,0x%X,%s,%s,%d,", 
-			header.SyncByte, 
-			( header.TransportErrorIndicator ) ? "NG" : "OK",
-			( header.PayloadUnitStartIndicator ) ? "ON" : "OFF",
-			( header.TransportPriority ) ? "Higher" : "Normal",
-			header.Pid,
-			( ( TS_SCRAMBLE_NONE == header.TransportScramblingControl ) 
-					? 
-						"Not scrambled"
-					:
-						( ( TS_SCRAMBLE_EVEN == header.TransportScramblingControl ) 
-							?
-								"Scrambled with even key"
-							:
-								( ( TS_SCRAMBLE_EVEN == header.TransportScramblingControl ) 
-									?
-										"Scrambled with even key"
-									:
-										"Reserved for future use" )
-						)
-			),
-			( ( TS_ADAPTATION_FIELD_CONTROL_NONE == header.AdaptationFieldControl ) 
-					? 
-						"Payload only"
-					:
-						( ( TS_ADAPTATION_FIELD_CONTROL_ONLY == header.AdaptationFieldControl ) 
-							?
-								"Adaptation field only"
-							:
-								( ( TS_ADAPTATION_FIELD_CONTROL_WITH_PAYLOAD == header.AdaptationFieldControl ) 
-									?
-										"Adaptation field followed by payload"
-									:
-										"Reserved for future use" )
-						)
-			),
-			header.ContinuityCounter
-	);
-	if( PCR_NONE == header.Pcr ){
-		printf( "-," );
-	}else{
-		printf( "%ld,", header.Pcr );
+		if( 0 == stats->Packets ){
+			continue;
+		}
+		printf( "0x%04X,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,",
+				pid, stats->Packets, stats->PayloadBytes, stats->TeiErrors, stats->ScrambledEven, stats->ScrambledOdd,
+				stats->AdaptationFields, stats->CcErrors, stats->PcrCount, stats->PcrDiscontinuities, stats->CrcErrors );
+		if( 0.0 < duration ){
+			printf( "%.0f\n", stats->Packets * TS_PACKET_SIZE * 8 / duration );
+		}else{
+			printf( "-\n" );
+		}
+	}
+	printf( "Total packets = %lu\n", analysis->Packets );
+	if( 0 < analysis->SkippedBytes ){
+		printf( "Skipped bytes = %lu\n", analysis->SkippedBytes );
 	}
 	
-	if(    ( PID_NULL == header.Pid )
-		|| ( TS_ADAPTATION_FIELD_CONTROL_NONE == header.AdaptationFieldControl ) ){
-		printf( "-," );
-	}else{
-		int i;
-		for( i = 0 ; i < ts_packet[ 4 ] ; i++ ){
-			printf( "%02X ", ts_packet[ 4 + i ] );
+	free( analysis );
+	
+	return true;
+}
+
+/**
+* @brief		Write header trace
+* @param[in]	ts_file			TS file path
+* @param[in]	prefix			Trace prefix
+* @return		bool			Result
+*/
+static	bool			ts_write_trace( const char* ts_file, const char* prefix )
+{
+	TS_READER			reader;
+	TS_TRACE_WRITER*	writer;
+	TS_PACKET_BATCH*	batch;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	bool				result;
+	
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	writer = malloc( sizeof( TS_TRACE_WRITER ) );
+	if( ( NULL == batch ) || ( NULL == writer ) ){
+		free( batch );
+		free( writer );
+		return false;
+	}
+	
+	if( !ts_reader_open( &reader, ts_file, Options.ReaderMode ) ){
+		perror( "Input file open." );
+		free( batch );
+		free( writer );
+		return false;
+	}
+	
+	result = ts_trace_create( writer, prefix, ts_file );
+	if( result ){
+		while( result && ( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+			ts_parse_batch( ts_buffer, read_count, batch );
+			result = ts_trace_write( writer, batch, ts_reader_tell( &reader ) - ( uint64_t )read_count * TS_PACKET_SIZE );
+		}
+		if( !ts_trace_finish( writer ) ){
+			result = false;
 		}
-		printf( "," );
 	}
+	if( result ){
+		printf( "Trace = %s%s / Packets = %lu / PCR = %lu / TOT = %lu\n",
+				prefix, TS_TRACE_SUFFIX, writer->Header.Packets, writer->Header.PcrCount, writer->Header.TotCount );
+	}else{
+		perror( "Trace file write." );
+	}
+	
+	ts_reader_close( &reader );
+	free( batch );
+	free( writer );
+	
+	return result;
 }
 
 /**
-* @brief		Calculate bit rate of TS file
+* @brief		Show bitrate over time
 * @param[in]	ts_file			TS file path
-* @param[in]	use_pcr_count	Sampling PCR count
-* @return		double			bitrate. if error return 0.0
+* @param[in]	window_ms		Window ( ms )
+* @return		bool			Result
+* @details		The bitrate of each window comes from the PCR time line, so VBR streams are followed.
 */
-static	double		ts_calc_bitrate( const char* ts_file, const uint32_t use_pcr_count )
+static	bool			ts_show_bitrate_timeline( const char* ts_file, uint32_t window_ms )
 {
-	FILE*		ifp = NULL;
+	TS_TIMELINE*	timeline;
+	uint64_t		window = ( uint64_t )window_ms * ( PCR_CLOCK_EXT / 1000 );
+	uint64_t		duration;
+	uint64_t		time;
+	uint64_t		start_offset;
+	uint64_t		end_offset;
 	
-	uint8_t		ts_packet[ TS_PACKET_SIZE ];
+	timeline = malloc( sizeof( TS_TIMELINE ) );
+	if( NULL == timeline ){
+		return false;
+	}
+	if( !ts_timeline_build( ts_file, Options.ReaderMode, timeline ) ){
+		perror( "Input file open." );
+		free( timeline );
+		return false;
+	}
+	if( 2 > timeline->Count ){
+		printf( "%s : Not enough PCR.\n", ts_file );
+		ts_timeline_free( timeline );
+		free( timeline );
+		return false;
+	}
 	
-	uint64_t	total_packet = 0;
+	duration = ts_timeline_time( timeline, timeline->EndOffset );
+	printf( "Time(s),Offset,Bitrate(bps)\n" );
+	for( time = 0 ; time < duration ; time += window ){
+		start_offset = ts_timeline_offset( timeline, time );
+		end_offset = ts_timeline_offset( timeline, ( time + window < duration ) ? ( time + window ) : duration );
+		printf( "%.3f,%lu,%.0f\n", ( double )time / PCR_CLOCK_EXT, start_offset,
+				( double )( end_offset - start_offset ) * 8 * PCR_CLOCK_EXT / ( ( time + window < duration ) ? window : ( duration - time ) ) );
+	}
+	printf( "Duration = %.3f s / Average bitrate = %.0f bps / PCR discontinuity = %lu\n",
+			( double )duration / PCR_CLOCK_EXT,
+			( double )timeline->EndOffset * 8 * PCR_CLOCK_EXT / duration,
+			timeline->Discontinuities );
 	
-	uint64_t	start_pcr = PCR_NONE;
-	uint64_t	end_pcr = PCR_NONE;
-	int			pcr_count = 0;
-	double		bitrate = 0.0;
-	uint16_t	pcr_pid = PID_NULL;
+	ts_timeline_free( timeline );
+	free( timeline );
 	
-	ifp = fopen( ts_file, "rb" );
-	total_packet = 0;
-	if( ifp ){
-		while( TS_PACKET_SIZE == fread( ts_packet, 1, sizeof( ts_packet ), ifp ) ){
-			if( TS_SYNC_BYTE != ts_packet[ 0 ] ){
-				break;
-			}
+	return true;
+}
+
+/**
+* @brief		Show PCR accuracy per PCR PID
+* @param[in]	ts_file			TS file path
+* @param[in]	histogram		Show histograms too
+* @return		bool			Result
+*/
+static	bool			ts_show_jitter( const char* ts_file, bool histogram )
+{
+	TS_JITTER*		jitter;
+	uint32_t		pid;
+	uint32_t		i;
+	
+	jitter = malloc( sizeof( TS_JITTER ) );
+	if( NULL == jitter ){
+		printf( "%s()[%d] Memory allocation error.\n", __func__, __LINE__ );
+		return false;
+	}
+	if( !ts_jitter_file( ts_file, Options.ReaderMode, jitter ) ){
+		// errno tells an open error from an allocation error of a PCR PID.
+		perror( "Jitter analysis." );
+		free( jitter );
+		return false;
+	}
+	
+	printf( "PID,PCR,Interval avg(ms),Interval p99(ms),Interval max(ms),Interval over 40ms,"\
+			"Jitter p50(ns),Jitter p99(ns),Jitter p99.9(ns),Jitter max(ns),"\
+			"FO min(ppm),FO max(ppm),Drift max(ppm/s),Discontinuity\n" );
+	for( pid = 0 ; pid < 8192 ; pid++ ){
+		const TS_PCR_JITTER*	j = jitter->Pid[ pid ];
+		
+		if( NULL == j ){
+			continue;
+		}
+		printf( "0x%04X,%lu,%.3f,%.0f,%.3f,%lu,%.0f,%.0f,%.0f,%.0f,%.3f,%.3f,%.4f,%lu\n",
+				pid, j->PcrCount,
+				( 0 < j->IntervalCount ) ? ( double )j->IntervalSum / j->IntervalCount * 1000 / PCR_CLOCK_EXT : 0.0,
+				ts_jitter_percentile( j->IntervalHistogram, TS_JITTER_INTERVAL_BINS, TS_JITTER_INTERVAL_BIN_US / 1000.0, 99, ( double )j->IntervalMax * 1000 / PCR_CLOCK_EXT ),
+				( double )j->IntervalMax * 1000 / PCR_CLOCK_EXT,
+				j->IntervalOver,
+				ts_jitter_percentile( j->JitterHistogram, TS_JITTER_OJ_BINS, TS_JITTER_OJ_BIN_NS, 50, j->JitterMax ),
+				ts_jitter_percentile( j->JitterHistogram, TS_JITTER_OJ_BINS, TS_JITTER_OJ_BIN_NS, 99, j->JitterMax ),
+				ts_jitter_percentile( j->JitterHistogram, TS_JITTER_OJ_BINS, TS_JITTER_OJ_BIN_NS, 99.9, j->JitterMax ),
+				j->JitterMax,
+				j->FrequencyOffsetMin, j->FrequencyOffsetMax, j->DriftMax,
+				j->Discontinuities );
+	}
+	
+	if( histogram ){
+		printf( "PID,Histogram,From,To,Count\n" );
+		for( pid = 0 ; pid < 8192 ; pid++ ){
+			const TS_PCR_JITTER*	j = jitter->Pid[ pid ];
 			
-			if( 0 < pcr_count ){
-				total_packet++;
-			}else{
-				total_packet = 0;
+			if( NULL == j ){
+				continue;
 			}
-			
-			if( ts_packet[ 3 ] & TS_ADAPTATION_FIELD ){			// Is adaptaion_file ON ?
-				if( ts_packet[ 5 ] & ADAPTATION_FIELD_PCR ){	// PCR Flag ?
-					if( PID_NULL == pcr_pid ){
-						pcr_pid = GET_PID( ts_packet[ 1 ], ts_packet[ 2 ] );
-					}
-					
-					if( pcr_pid != GET_PID( ts_packet[ 1 ], ts_packet[ 2 ] ) ){
-						continue;
-					}
-					
-					if( 0 == pcr_count ){
-						GET_PCR_EXT( &ts_packet[ 6 ], start_pcr );
-						DEBUG_PRINT( "Start PCR = %lu\n", start_pcr );
-						pcr_count++;
-					}else if( 0 < pcr_count ){
-						GET_PCR_EXT( &ts_packet[ 6 ], end_pcr );
-						
-						if( start_pcr > end_pcr ){
-							DEBUG_PRINT( "PCR RESET %lu => %lu\n", start_pcr, end_pcr );
-							pcr_count = 0;
-							total_packet = 0;
-							continue;
-						}
-						
-						pcr_count++;
-						
-						if( use_pcr_count < pcr_count ){
-							break;
-						}
-					}
+			for( i = 0 ; i < TS_JITTER_INTERVAL_BINS ; i++ ){
+				if( 0 < j->IntervalHistogram[ i ] ){
+					printf( "0x%04X,Interval(ms),%u,%u,%lu\n", pid,
+							i * TS_JITTER_INTERVAL_BIN_US / 1000, ( i + 1 ) * TS_JITTER_INTERVAL_BIN_US / 1000, j->IntervalHistogram[ i ] );
+				}
+			}
+			for( i = 0 ; i < TS_JITTER_OJ_BINS ; i++ ){
+				if( 0 < j->JitterHistogram[ i ] ){
+					printf( "0x%04X,Jitter(ns),%u,%u,%lu\n", pid,
+							i * TS_JITTER_OJ_BIN_NS, ( i + 1 ) * TS_JITTER_OJ_BIN_NS, j->JitterHistogram[ i ] );
 				}
 			}
 		}
-		fclose( ifp );
+	}
+	
+	ts_jitter_free( jitter );
+	free( jitter );
+	
+	return true;
+}
+
+/**
+* @brief		Write whole data
+* @param[in]	fd				File descriptor
+* @param[in]	data			Data
+* @param[in]	size			Size of data
+* @return		bool			false if write failed
+*/
+static	bool			write_all( int fd, const uint8_t* data, size_t size )
+{
+	ssize_t		written;
+	
+	while( 0 < size ){
+		written = write( fd, data, size );
+		if( 0 < written ){
+			data += written;
+			size -= written;
+		}else if( ( 0 > written ) && ( EINTR == errno ) ){
+			continue;
+		}else{
+			if( 0 == written ){
+				errno = EIO;
+			}
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+/**
+* @brief		PES handler of ts_demux_pes()
+* @param[in]	context			ES_OUTPUT
+* @param[in]	pes				PES
+* @details		The ES data is written straight from the PES blocks, without the PES header.
+*/
+static	void			ts_demux_pes_handler( void* context, const TS_PES* pes )
+{
+	ES_OUTPUT*			out = context;
+	const TS_PES_BLOCK*	block;
+	uint32_t			skip = pes->HeaderSize;
+	
+	if( NULL == out->Prefix ){
+		printf( "0x%04X,%lu,0x%02X,%u,", pes->Pid, pes->Offset, pes->StreamId, pes->Size - pes->HeaderSize );
+		if( TS_PES_TIMESTAMP_NONE != pes->Pts ){
+			printf( "%lu,", pes->Pts );
+		}else{
+			printf( "-," );
+		}
+		if( TS_PES_TIMESTAMP_NONE != pes->Dts ){
+			printf( "%lu\n", pes->Dts );
+		}else{
+			printf( "-\n" );
+		}
+		return;
+	}
+	
+	for( block = pes->Blocks ; ( NULL != block ) && ( 0 <= out->Fd[ pes->Pid ] ) ; block = block->Next ){
+		if( !write_all( out->Fd[ pes->Pid ], &block->Data[ skip ], block->Length - skip ) ){
+			// The ES file is incomplete from here, stop writing it.
+			if( !out->Error ){
+				out->Error = true;
+				out->ErrorNumber = errno;
+				out->ErrorPid = pes->Pid;
+			}
+			close( out->Fd[ pes->Pid ] );
+			out->Fd[ pes->Pid ] = -1;
+		}
+		skip = 0;
+	}
+}
+
+/**
+* @brief		Demux PES of the selected PIDs
+* @param[in]	ts_file			TS file path
+* @param[in]	pid_list		Comma separated PIDs
+* @param[in]	prefix			Elementary stream files are prefix + ".0xPPPP.es". NULL lists the PES
+* @return		bool			Result
+*/
+static	bool			ts_demux_pes( const char* ts_file, const char* pid_list, const char* prefix )
+{
+	TS_READER			reader;
+	TS_PES_DEMUX*		demux;
+	TS_PACKET_BATCH*	batch;
+	ES_OUTPUT*			out;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	uint32_t			pid;
+	char				path[ 4096 ];
+	char*				end;
+	long				value;
+	bool				result = true;
+	
+	demux = malloc( sizeof( TS_PES_DEMUX ) );
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	out = malloc( sizeof( ES_OUTPUT ) );
+	if( ( NULL == demux ) || ( NULL == batch ) || ( NULL == out ) ){
+		free( demux );
+		free( batch );
+		free( out );
+		return false;
+	}
+	out->Prefix = prefix;
+	out->Error = false;
+	for( pid = 0 ; pid < 8192 ; pid++ ){
+		out->Fd[ pid ] = -1;
+	}
+	ts_pes_init( demux, ts_demux_pes_handler, out );
+	
+	while( result && ( '\0' != *pid_list ) ){
+		value = strtol( pid_list, &end, 0 );
+		if( ( end == pid_list ) || ( 0 > value ) || ( PID_NULL <= value ) || ( ( ',' != *end ) && ( '\0' != *end ) ) ){
+			printf( "Invalid PID list. %s\n", pid_list );
+			result = false;
+			break;
+		}
+		pid_list = ( ',' == *end ) ? ( end + 1 ) : end;
+		if( !ts_pes_add_pid( demux, value ) ){
+			result = false;
+			break;
+		}
+		if( ( NULL != prefix ) && ( 0 > out->Fd[ value ] ) ){
+			snprintf( path, sizeof( path ), "%s.0x%04lX.es", prefix, value );
+			out->Fd[ value ] = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+			if( 0 > out->Fd[ value ] ){
+				perror( "Output file open." );
+				result = false;
+			}
+		}
+	}
+	
+	if( result ){
+		if( ts_reader_open( &reader, ts_file, Options.ReaderMode ) ){
+			if( NULL == prefix ){
+				printf( "PID,Offset,Stream ID,ES bytes,PTS,DTS\n" );
+			}
+			while( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ){
+				ts_parse_batch( ts_buffer, read_count, batch );
+				ts_pes_batch( demux, batch, ts_reader_tell( &reader ) - ( uint64_t )read_count * TS_PACKET_SIZE );
+			}
+			ts_pes_flush( demux );
+			ts_reader_close( &reader );
+		}else{
+			perror( "Input file open." );
+			result = false;
+		}
+	}
+	if( out->Error ){
+		printf( "Output file write error. [%s.0x%04X.es] %s\n", prefix, out->ErrorPid, strerror( out->ErrorNumber ) );
+		result = false;
+	}
+	
+	for( pid = 0 ; pid < 8192 ; pid++ ){
+		const TS_PES_STREAM*	stream = demux->Pid[ pid ];
 		
-		if(    ( PCR_NONE != start_pcr )
-			&& ( PCR_NONE != end_pcr ) ){
-			DEBUG_PRINT("End   PCR = %lu / Total = %lu\n", end_pcr, total_packet );
-			bitrate = ( total_packet * TS_PACKET_SIZE * 8 ) / ( ( end_pcr - start_pcr ) / ( double )PCR_CLOCK_EXT );
-			DEBUG_PRINT( "TS Bitrate = %lf\n", bitrate );
+		if( 0 <= out->Fd[ pid ] ){
+			close( out->Fd[ pid ] );
+		}
+		if( result && ( NULL != prefix ) && ( NULL != stream ) ){
+			printf( "0x%04X PES = %lu / ES bytes = %lu / Dropped = %lu / File = %s.0x%04X.es\n",
+					pid, stream->PesCount, stream->Bytes, stream->Dropped, prefix, pid );
 		}
 	}
 	
-	return bitrate;
+	ts_pes_free( demux );
+	free( demux );
+	free( batch );
+	free( out );
+	
+	return result;
 }
 
+/**
+* @brief		Parse column list of -C
+* @param[in]	list			Comma separated column numbers ( 1 - DUMP_COLUMN_MAX )
+* @param[out]	columns			Bit mask of DUMP_COLUMN
+* @return		bool			false if a number is out of range
+*/
+static	bool			parse_columns( const char* list, uint32_t* columns )
+{
+	char*		end;
+	long		column;
+	
+	*columns = 0;
+	while( '\0' != *list ){
+		column = strtol( list, &end, 10 );
+		if( ( end == list ) || ( 1 > column ) || ( DUMP_COLUMN_MAX < column ) ){
+			return false;
+		}
+		*columns |= 1 << ( column - 1 );
+		list = ( ',' == *end ) ? ( end + 1 ) : end;
+		if( ( '\0' != *list ) && ( ',' != *end ) ){
+			return false;
+		}
+	}
+	
+	return ( 0 != *columns );
+}
 
 /**
 * @brief		Show help
 */
 static	void			show_help( void )
 {
-	printf( " -i\tInput TS file path.\n" );
+	printf( " -i\tInput TS file path. \"-\" reads stdin.\n" );
 	printf( " -H\tDump TS Header\n" );
+	printf( " -C\tColumns of -H, comma separated numbers (default = all).\n" );
+	printf( "\t1:Sync byte 2:TEI 3:PUSI 4:Priority 5:PID 6:Scrambling 7:Adaptation field control\n" );
+	printf( "\t8:Continuity counter 9:PCR 10:Adaptation field 11:TS Packet raw data\n" );
 	printf( " -b\tCalculate bit rate of TS file\n" );
 	printf( " -c\tCalculate bit rate of TS file. Use packet number(32bit, default = %d).\n", BIT_RATE_COUNT_PCR );
+	printf( " -B\tShow bit rate over time. Window in ms.\n" );
+	printf( " -J\tShow PCR interval, jitter, frequency offset and drift per PCR PID.\n" );
+	printf( " -G\tShow histograms with -J.\n" );
+	printf( " -S\tShow per PID summary\n" );
+	printf( " -j\tNumber of worker threads for -S (default = 1).\n" );
+	printf( " -P\tList PES of the PIDs, comma separated (exp 0x100,0x101). PTS / DTS are 90kHz.\n" );
+	printf( " -E\tWrite elementary streams of -P PIDs. Files are named prefix + \".0xPPPP.es\".\n" );
+	printf( " -T\tWrite header trace. Files are named prefix + \"%s\", \".pid\", \".flags\", ...\n", TS_TRACE_SUFFIX );
+	printf( " -A\tRead the input from a read-ahead thread instead of mmap ( network storage ).\n" );
+	printf( " --no-cache\n\tRead the input with O_DIRECT from a read-ahead thread, so a full scan does not evict the page cache.\n" );
+	printf( " --stats[=file]\n\tWrite read / seek / resync counters and phase times as one JSON line to stderr or appended to file.\n" );
 	printf( " -h\tShow Help.\n" );
 }
 
@@ -279,12 +905,17 @@ static	void			show_help( void )
 int						main( int args, char* argc[] )
 {
 	char*				in_filename = NULL;
-	char				ch;
+	bool				stats = false;
+	char*				stats_filename = NULL;
+	int					ch;
+	int					result = 0;
 	
 	memset( &Options, 0, sizeof( Options ) );
 	Options.BitrateCountPcr = BIT_RATE_COUNT_PCR;
+	Options.DumpColumns = DUMP_COLUMN_ALL;
+	Options.Threads = 1;
 	
-	while( (ch = getopt( args, argc, "i:Hbc:h") ) != -1 ){
+	while( (ch = getopt_long( args, argc, "i:HC:bc:B:JGSj:T:P:E:Ah", LongOptions, NULL ) ) != -1 ){
 		if( ch == 255 ){
 			break;
 		}
@@ -295,12 +926,53 @@ int						main( int args, char* argc[] )
 			case 'H':
 				Options.DumpTsHeader = true;
 				break;
+			case 'C':
+				if( !parse_columns( optarg, &Options.DumpColumns ) ){
+					printf( "Invalid column list. %s\n", optarg );
+					return -1;
+				}
+				Options.DumpTsHeader = true;
+				break;
 			case 'b':
 				Options.CalcTsBitrate = true;
 				break;
 			case 'c':
 				Options.BitrateCountPcr = atol( optarg );
 				break;
+			case 'B':
+				Options.BitrateWindow = atol( optarg );
+				break;
+			case 'J':
+				Options.ShowJitter = true;
+				break;
+			case 'G':
+				Options.ShowHistogram = true;
+				break;
+			case 'S':
+				Options.ShowStats = true;
+				break;
+			case 'j':
+				Options.Threads = atol( optarg );
+				break;
+			case 'T':
+				Options.TracePrefix = optarg;
+				break;
+			case 'P':
+				Options.PesPids = optarg;
+				break;
+			case 'E':
+				Options.EsPrefix = optarg;
+				break;
+			case 'A':
+				Options.ReaderMode = TS_READER_MODE_THREAD;
+				break;
+			case OPTION_NO_CACHE:
+				Options.ReaderMode = TS_READER_MODE_DIRECT;
+				break;
+			case OPTION_STATS:
+				stats = true;
+				stats_filename = optarg;
+				break;
 			case 'h':
 			default:
 				show_help();
@@ -314,12 +986,44 @@ int						main( int args, char* argc[] )
 		return -1;
 	}
 	
-	if( Options.CalcTsBitrate ){
-		printf( "%s Bitrate = %f bps.\n", in_filename, ts_calc_bitrate( in_filename, Options.BitrateCountPcr ) );
+	if( ( NULL != Options.EsPrefix ) && ( NULL == Options.PesPids ) ){
+		printf( "Please select PIDs of -E. -P pid,pid\n" );
+		return -1;
+	}
+	
+	if( stats ){
+		ts_stats_enable();
+		ts_stats_phase( TS_STATS_PHASE_SCAN );
+	}
+	
+	if( Options.ShowStats ){
+		ts_show_stats( in_filename, Options.Threads );
+	}else if( NULL != Options.PesPids ){
+		if( !ts_demux_pes( in_filename, Options.PesPids, Options.EsPrefix ) ){
+			result = -1;
+		}
+	}else if( Options.ShowJitter ){
+		if( !ts_show_jitter( in_filename, Options.ShowHistogram ) ){
+			result = -1;
+		}
+	}else if( 0 < Options.BitrateWindow ){
+		if( !ts_show_bitrate_timeline( in_filename, Options.BitrateWindow ) ){
+			result = -1;
+		}
+	}else if( NULL != Options.TracePrefix ){
+		if( !ts_write_trace( in_filename, Options.TracePrefix ) ){
+			result = -1;
+		}
+	}else if( Options.CalcTsBitrate ){
+		printf( "%s Bitrate = %f bps.\n", in_filename, ts_calc_bitrate( in_filename, Options.ReaderMode, Options.BitrateCountPcr ) );
 	}else{
 		ts_dump( in_filename );
 	}
 	
-	return 0;
+	if( !ts_stats_report( stats_filename, "ts_base", in_filename ) ){
+		perror( "Stats output." );
+	}
+	
+	return result;
 }
 
@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+# Throughput of ts_base and ts_tot_spliter on a synthetic TS made by ts_gen.
+# Run from the top directory ( make bench ). Settings are taken from the environment:
+#
+#   BENCH_SECONDS   Duration of the stream            ( default 60 )
+#   BENCH_BITRATE   Bitrate of the stream in bps      ( default 40000000 )
+#   BENCH_PROGRAMS  Programs / PCR PIDs               ( default 4 )
+#   BENCH_NULL      Null packets in percent           ( default 20 )
+#   BENCH_VBR       cbr, sine or burst                ( default sine )
+#   BENCH_ERRORS    Sync error about every N packets  ( default 0, none )
+#   BENCH_RUNS      Runs per case, the best is taken  ( default 3 )
+#   BENCH_DIR       Directory of the stream           ( default bench/data )
+#
+
+BENCH_SECONDS=${BENCH_SECONDS:-60}
+BENCH_BITRATE=${BENCH_BITRATE:-40000000}
+BENCH_PROGRAMS=${BENCH_PROGRAMS:-4}
+BENCH_NULL=${BENCH_NULL:-20}
+BENCH_VBR=${BENCH_VBR:-sine}
+BENCH_ERRORS=${BENCH_ERRORS:-0}
+BENCH_RUNS=${BENCH_RUNS:-3}
+BENCH_DIR=${BENCH_DIR:-bench/data}
+
+STREAM=$BENCH_DIR/bench-$BENCH_SECONDS-$BENCH_BITRATE-$BENCH_PROGRAMS-$BENCH_NULL-$BENCH_VBR-$BENCH_ERRORS.ts
+SPLIT_OUT=$BENCH_DIR/split.ts
+
+for tool in ./ts_gen ./ts_base ./ts_tot_spliter; do
+	if [ ! -x $tool ]; then
+		echo "$tool is not built. Run make first."
+		exit 1
+	fi
+done
+
+mkdir -p $BENCH_DIR || exit 1
+if [ ! -f $STREAM ]; then
+	./ts_gen -o $STREAM -d $BENCH_SECONDS -r $BENCH_BITRATE -p $BENCH_PROGRAMS -n $BENCH_NULL -v $BENCH_VBR -e $BENCH_ERRORS -T 2018/09/01-10:00:00 || exit 1
+fi
+
+STREAM_BYTES=$(wc -c < $STREAM)
+
+# Middle third of the stream
+hms() {
+	printf "2018/09/01-%02d:%02d:%02d" $(( 10 + $1 / 3600 )) $(( $1 / 60 % 60 )) $(( $1 % 60 ))
+}
+SPLIT_START=$(hms $(( BENCH_SECONDS / 3 )))
+SPLIT_END=$(hms $(( BENCH_SECONDS * 2 / 3 )))
+
+# Best wall time of BENCH_RUNS in nanoseconds. Output is discarded
+best_ns() {
+	best=0
+	i=0
+	while [ $i -lt $BENCH_RUNS ]; do
+		begin=$(date +%s%N)
+		"$@" > /dev/null 2>&1 || { echo "Failed : $*" >&2; exit 1; }
+		end=$(date +%s%N)
+		elapsed=$(( end - begin ))
+		if [ $best -eq 0 ] || [ $elapsed -lt $best ]; then
+			best=$elapsed
+		fi
+		i=$(( i + 1 ))
+	done
+	echo $best
+}
+
+# case name, bytes, nanoseconds
+report() {
+	awk -v name="$1" -v bytes="$2" -v ns="$3" 'BEGIN {
+		sec = ns / 1e9
+		printf "%-12s %10.3f %14.0f %10.3f\n", name, sec, bytes / 188 / sec, bytes / sec / 1e9
+	}'
+}
+
+echo "Stream : $STREAM ( $STREAM_BYTES bytes, $BENCH_SECONDS s, $BENCH_BITRATE bps )"
+echo "Split  : $SPLIT_START - $SPLIT_END"
+printf "%-12s %10s %14s %10s\n" "case" "sec" "packets/s" "GB/s"
+
+ns=$(best_ns ./ts_base -i $STREAM) || exit 1
+report dump $STREAM_BYTES $ns
+ns=$(best_ns ./ts_base -i $STREAM -H) || exit 1
+report header $STREAM_BYTES $ns
+ns=$(best_ns ./ts_base -i $STREAM -b) || exit 1
+report bitrate $STREAM_BYTES $ns
+
+# The split reads only around the range, so the rate is of the bytes written.
+# Indexes of an earlier run would skip the TOT search, remove them.
+rm -f $STREAM.totidx $STREAM.rapidx
+ns=$(best_ns sh -c "rm -f $STREAM.totidx $STREAM.rapidx; ./ts_tot_spliter -i $STREAM -o $SPLIT_OUT -s $SPLIT_START -e $SPLIT_END") || exit 1
+report split $(wc -c < $SPLIT_OUT) $ns
+rm -f $SPLIT_OUT
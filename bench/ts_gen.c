@@ -0,0 +1,588 @@
+/**
+* @file ts_gen.c
+* @brief Synthetic TS generator
+* @author sage
+* @date 2019/02/05
+* @details Writes a deterministic constant bitrate TS for benchmarks.\n
+*			Each program has a PMT and one video PID carrying the PCR. PAT / PMT are sent every 100ms,\n
+*			TOT at a fixed cadence and the rest of the multiplex is shared by video and null packets\n
+*			following a VBR profile. The same options and seed always give the same bytes.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+
+#include "ts.h"
+#include "ts_crc32.h"
+#include "ts_tot.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define GEN_PROGRAMS_MAX		( 16 )
+#define GEN_PMT_PID_BASE		( 0x1000 )
+#define GEN_VIDEO_PID_BASE		( 0x0100 )
+#define GEN_PSI_TICKS			( PCR_CLOCK_EXT / 10 )		// PAT / PMT every 100ms
+#define GEN_PCR_TICKS			( PCR_CLOCK_EXT / 25 )		// PCR every 40ms
+#define GEN_FRAME_TICKS			( PCR_CLOCK_EXT / 25 )		// One PES per 25fps frame
+#define GEN_GOP_FRAMES			( 15 )						// random_access_indicator every 15 frames
+#define GEN_PTS_DELAY			( PCR_CLOCK_EXT / 10 )		// PTS leads the PCR by 100ms
+#define GEN_BUFFER_PACKETS		( 4096 )
+
+/*------------------------------------------------------------------------------
+ Enum
+------------------------------------------------------------------------------*/
+typedef enum {
+	GEN_VBR_CBR = 0,			// Constant video share
+	GEN_VBR_SINE,				// Video share swings +-50% over 60s
+	GEN_VBR_BURST,				// Video share alternates 150% / 50% every 10s
+	GEN_VBR_MAX,
+} GEN_VBR;
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	uint16_t		PmtPid;
+	uint16_t		VideoPid;
+	uint8_t			PmtCc;
+	uint8_t			VideoCc;
+	uint64_t		NextPcr;				// 27MHz
+	uint64_t		NextFrame;				// 27MHz
+	uint32_t		Frame;
+} GEN_PROGRAM;
+
+typedef struct {
+	// Options
+	uint64_t		Bitrate;				// bps
+	uint32_t		Seconds;
+	uint32_t		ProgramCount;
+	uint32_t		TotInterval;			// Seconds
+	uint32_t		NullPercent;
+	GEN_VBR			Vbr;
+	uint32_t		SyncErrorInterval;		// Packets. 0 is none
+	uint64_t		Seed;
+	uint16_t		StartMjd;
+	uint32_t		StartSec;
+
+	// State
+	uint64_t		Random;
+	GEN_PROGRAM		Programs[ GEN_PROGRAMS_MAX ];
+	uint32_t		NextVideo;				// Round robin of video packets
+	uint8_t			PatCc;
+	uint8_t			TotCc;
+	uint8_t			NullCc;
+	uint64_t		NextPsi;
+	uint32_t		PsiPending;				// PAT + PMTs left in the current PSI cycle
+	uint64_t		NextTot;
+	uint64_t		NextSyncError;
+
+	// Output
+	int				Fd;
+	uint8_t*		Buffer;
+	uint32_t		BufferPackets;
+	uint64_t		Packets;
+	uint64_t		NullPackets;
+	uint64_t		SyncErrors;
+} GEN;
+
+static	const char*		VbrName[ GEN_VBR_MAX ] = { "cbr", "sine", "burst" };
+
+static inline	uint64_t	gen_random( GEN* gen );
+static	double			gen_video_share( const GEN* gen, uint64_t ticks );
+static	void			gen_header( uint8_t* packet, uint16_t pid, bool pusi, uint8_t* cc );
+static	void			gen_section( uint8_t* packet, uint16_t pid, uint8_t* cc, uint8_t* section, uint32_t size );
+static	void			gen_pat( GEN* gen, uint8_t* packet );
+static	void			gen_pmt( GEN* gen, uint8_t* packet, GEN_PROGRAM* program );
+static	void			gen_tot( GEN* gen, uint8_t* packet, uint64_t ticks );
+static	void			gen_video( GEN* gen, uint8_t* packet, GEN_PROGRAM* program, uint64_t ticks, bool pcr );
+static	void			gen_null( GEN* gen, uint8_t* packet );
+static	bool			gen_flush( GEN* gen, const uint8_t* garbage, uint32_t garbage_size );
+static	bool			gen_run( GEN* gen );
+static	bool			get_datetime( const char* str_datetime, uint16_t* mjd, uint32_t* sec );
+static	void			show_help( void );
+
+/**
+* @brief		xorshift64*
+*/
+static inline	uint64_t	gen_random( GEN* gen )
+{
+	gen->Random ^= gen->Random >> 12;
+	gen->Random ^= gen->Random << 25;
+	gen->Random ^= gen->Random >> 27;
+
+	return gen->Random * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+* @brief		Share of the packets given to video at the time
+* @param[in]	gen			Generator
+* @param[in]	ticks		Time from the head ( 27MHz )
+* @return		double		0.0 - 1.0. The rest is null packets
+*/
+static	double			gen_video_share( const GEN* gen, uint64_t ticks )
+{
+	double		share = ( 100 - gen->NullPercent ) / 100.0;
+	double		sec = ( double )ticks / PCR_CLOCK_EXT;
+
+	switch( gen->Vbr ){
+		case GEN_VBR_SINE:
+			share *= 1.0 + 0.5 * sin( 2.0 * M_PI * sec / 60.0 );
+			break;
+		case GEN_VBR_BURST:
+			share *= ( 0 == ( ( uint64_t )sec / 10 ) % 2 ) ? 1.5 : 0.5;
+			break;
+		default:
+			break;
+	}
+
+	return ( 1.0 < share ) ? 1.0 : share;
+}
+
+/**
+* @brief		Write 4 byte header with payload only
+*/
+static	void			gen_header( uint8_t* packet, uint16_t pid, bool pusi, uint8_t* cc )
+{
+	packet[ 0 ] = TS_SYNC_BYTE;
+	packet[ 1 ] = ( pusi ? 0x40 : 0x00 ) | ( ( pid >> 8 ) & 0x1F );
+	packet[ 2 ] = pid & 0xFF;
+	packet[ 3 ] = 0x10 | ( *cc & 0x0F );
+	*cc = ( *cc + 1 ) & 0x0F;
+}
+
+/**
+* @brief		Put one section into a packet. CRC_32 is appended
+* @param[in,out]	section		Section without CRC_32, size + 4 bytes
+* @param[in]	size			Size of the section without CRC_32
+*/
+static	void			gen_section( uint8_t* packet, uint16_t pid, uint8_t* cc, uint8_t* section, uint32_t size )
+{
+	uint32_t	crc = ts_crc32( section, size, TS_CRC32_INIT );
+
+	section[ size + 0 ] = crc >> 24;
+	section[ size + 1 ] = crc >> 16;
+	section[ size + 2 ] = crc >> 8;
+	section[ size + 3 ] = crc;
+
+	gen_header( packet, pid, true, cc );
+	packet[ 4 ] = 0;													// pointer_field
+	memcpy( &packet[ 5 ], section, size + 4 );
+	memset( &packet[ 5 + size + 4 ], 0xFF, TS_PACKET_SIZE - 5 - size - 4 );
+}
+
+/**
+* @brief		PAT of every program
+*/
+static	void			gen_pat( GEN* gen, uint8_t* packet )
+{
+	uint8_t		section[ 8 + GEN_PROGRAMS_MAX * 4 + 4 ];
+	uint32_t	size = 8;
+	uint32_t	i;
+
+	for( i = 0 ; i < gen->ProgramCount ; i++ ){
+		section[ size++ ] = 0;
+		section[ size++ ] = i + 1;										// program_number
+		section[ size++ ] = 0xE0 | ( gen->Programs[ i ].PmtPid >> 8 );
+		section[ size++ ] = gen->Programs[ i ].PmtPid & 0xFF;
+	}
+	section[ 0 ] = TABLE_ID_PAT;
+	section[ 1 ] = 0xB0 | ( ( size + 4 - 3 ) >> 8 );
+	section[ 2 ] = ( size + 4 - 3 ) & 0xFF;
+	section[ 3 ] = 0x00;												// transport_stream_id
+	section[ 4 ] = 0x01;
+	section[ 5 ] = 0xC1;												// version 0, current
+	section[ 6 ] = 0x00;
+	section[ 7 ] = 0x00;
+
+	gen_section( packet, PID_PAT, &gen->PatCc, section, size );
+}
+
+/**
+* @brief		PMT with one MPEG-2 video stream carrying the PCR
+*/
+static	void			gen_pmt( GEN* gen, uint8_t* packet, GEN_PROGRAM* program )
+{
+	uint8_t		section[ 17 + 4 ];
+	uint16_t	program_number = ( program - gen->Programs ) + 1;
+
+	section[ 0 ] = TABLE_ID_PMT;
+	section[ 1 ] = 0xB0;
+	section[ 2 ] = 17 + 4 - 3;
+	section[ 3 ] = program_number >> 8;
+	section[ 4 ] = program_number & 0xFF;
+	section[ 5 ] = 0xC1;
+	section[ 6 ] = 0x00;
+	section[ 7 ] = 0x00;
+	section[ 8 ] = 0xE0 | ( program->VideoPid >> 8 );					// PCR_PID
+	section[ 9 ] = program->VideoPid & 0xFF;
+	section[ 10 ] = 0xF0;												// program_info_length 0
+	section[ 11 ] = 0x00;
+	section[ 12 ] = 0x02;												// MPEG-2 video
+	section[ 13 ] = 0xE0 | ( program->VideoPid >> 8 );
+	section[ 14 ] = program->VideoPid & 0xFF;
+	section[ 15 ] = 0xF0;												// ES_info_length 0
+	section[ 16 ] = 0x00;
+
+	gen_section( packet, program->PmtPid, &program->PmtCc, section, 17 );
+}
+
+/**
+* @brief		TOT of the time. No descriptors
+*/
+static	void			gen_tot( GEN* gen, uint8_t* packet, uint64_t ticks )
+{
+	uint8_t		section[ 10 + 4 ];
+	uint64_t	sec = gen->StartSec + ticks / PCR_CLOCK_EXT;
+	uint16_t	mjd = gen->StartMjd + sec / 86400;
+	uint32_t	hour, min;
+
+	sec %= 86400;
+	hour = sec / 3600;
+	min = ( sec / 60 ) % 60;
+	sec %= 60;
+
+	section[ 0 ] = TABLE_ID_TOT;
+	section[ 1 ] = 0x70;
+	section[ 2 ] = 10 + 4 - 3;
+	section[ 3 ] = mjd >> 8;
+	section[ 4 ] = mjd & 0xFF;
+	section[ 5 ] = ( ( hour / 10 ) << 4 ) | ( hour % 10 );
+	section[ 6 ] = ( ( min / 10 ) << 4 ) | ( min % 10 );
+	section[ 7 ] = ( ( sec / 10 ) << 4 ) | ( sec % 10 );
+	section[ 8 ] = 0xF0;												// descriptors_loop_length 0
+	section[ 9 ] = 0x00;
+
+	gen_section( packet, PID_TOT, &gen->TotCc, section, 10 );
+}
+
+/**
+* @brief		Video packet. A PES starts at every frame, with random_access_indicator at every GOP
+* @param[in]	pcr			Carry the PCR of the time
+*/
+static	void			gen_video( GEN* gen, uint8_t* packet, GEN_PROGRAM* program, uint64_t ticks, bool pcr )
+{
+	bool		pusi = ( ticks >= program->NextFrame );
+	bool		rai = pusi && ( 0 == program->Frame % GEN_GOP_FRAMES );
+	uint32_t	pos = 4;
+
+	gen_header( packet, program->VideoPid, pusi, &program->VideoCc );
+	if( pcr || rai ){
+		uint32_t	length = pcr ? 7 : 1;
+
+		packet[ 3 ] |= 0x20;
+		packet[ 4 ] = length;
+		packet[ 5 ] = ( pcr ? 0x10 : 0x00 ) | ( rai ? 0x40 : 0x00 );
+		if( pcr ){
+			uint64_t	base = ( ticks / 300 ) & 0x1FFFFFFFFULL;
+			uint32_t	ext = ticks % 300;
+
+			packet[ 6 ] = base >> 25;
+			packet[ 7 ] = base >> 17;
+			packet[ 8 ] = base >> 9;
+			packet[ 9 ] = base >> 1;
+			packet[ 10 ] = ( ( base & 1 ) << 7 ) | 0x7E | ( ext >> 8 );
+			packet[ 11 ] = ext & 0xFF;
+		}
+		pos += 1 + length;
+	}
+
+	if( pusi ){
+		uint64_t	pts = ( ( program->NextFrame + GEN_PTS_DELAY ) / 300 ) & 0x1FFFFFFFFULL;
+
+		packet[ pos + 0 ] = 0x00;
+		packet[ pos + 1 ] = 0x00;
+		packet[ pos + 2 ] = 0x01;
+		packet[ pos + 3 ] = 0xE0;										// video stream_id
+		packet[ pos + 4 ] = 0x00;										// PES_packet_length 0 ( unbounded )
+		packet[ pos + 5 ] = 0x00;
+		packet[ pos + 6 ] = 0x80;
+		packet[ pos + 7 ] = 0x80;										// PTS only
+		packet[ pos + 8 ] = 5;
+		packet[ pos + 9 ] = 0x21 | ( ( pts >> 29 ) & 0x0E );
+		packet[ pos + 10 ] = pts >> 22;
+		packet[ pos + 11 ] = ( ( pts >> 14 ) & 0xFE ) | 0x01;
+		packet[ pos + 12 ] = pts >> 7;
+		packet[ pos + 13 ] = ( ( pts << 1 ) & 0xFE ) | 0x01;
+		pos += 14;
+		program->Frame++;
+		program->NextFrame += GEN_FRAME_TICKS;
+	}
+
+	memset( &packet[ pos ], ( uint8_t )gen->Packets, TS_PACKET_SIZE - pos );
+}
+
+/**
+* @brief		Null packet
+*/
+static	void			gen_null( GEN* gen, uint8_t* packet )
+{
+	gen_header( packet, PID_NULL, false, &gen->NullCc );
+	memset( &packet[ 4 ], 0xFF, TS_PACKET_SIZE - 4 );
+	gen->NullPackets++;
+}
+
+/**
+* @brief		Write buffered packets
+* @param[in]	garbage			Bytes written after the packets. NULL if none
+* @param[in]	garbage_size	Size of garbage
+* @return		bool			Result
+*/
+static	bool			gen_flush( GEN* gen, const uint8_t* garbage, uint32_t garbage_size )
+{
+	const uint8_t*	data = gen->Buffer;
+	size_t			size = ( size_t )gen->BufferPackets * TS_PACKET_SIZE;
+	ssize_t			written;
+	uint32_t		part;
+
+	for( part = 0 ; part < 2 ; part++ ){
+		while( 0 < size ){
+			written = write( gen->Fd, data, size );
+			if( 0 < written ){
+				data += written;
+				size -= written;
+			}else if( ( 0 > written ) && ( EINTR == errno ) ){
+				continue;
+			}else{
+				return false;
+			}
+		}
+		data = garbage;
+		size = ( NULL == garbage ) ? 0 : garbage_size;
+	}
+	gen->BufferPackets = 0;
+
+	return true;
+}
+
+/**
+* @brief		Generate the stream
+* @param[in]	gen			Generator
+* @return		bool		Result
+* @details		One packet per slot of the constant bitrate. Due TOT, PSI and PCR go first,\n
+*				other slots are video or null by the VBR profile.\n
+*				A sync error replaces the sync byte, or inserts up to 187 bytes before a packet.
+*/
+static	bool			gen_run( GEN* gen )
+{
+	uint64_t		total = ( uint64_t )( ( double )gen->Bitrate * gen->Seconds / ( TS_PACKET_SIZE * 8 ) );
+	double			ticks_per_packet = ( double )PCR_CLOCK_EXT * TS_PACKET_SIZE * 8 / gen->Bitrate;
+	uint64_t		ticks;
+	uint32_t		i;
+
+	while( gen->Packets < total ){
+		uint8_t*		packet = &gen->Buffer[ gen->BufferPackets * TS_PACKET_SIZE ];
+		GEN_PROGRAM*	program = NULL;
+		bool			pcr = false;
+
+		ticks = ( uint64_t )( gen->Packets * ticks_per_packet );
+
+		if( ticks >= gen->NextTot ){
+			gen_tot( gen, packet, ticks );
+			gen->NextTot += ( uint64_t )gen->TotInterval * PCR_CLOCK_EXT;
+		}else if( ( 0 < gen->PsiPending ) || ( ticks >= gen->NextPsi ) ){
+			if( 0 == gen->PsiPending ){
+				gen->PsiPending = 1 + gen->ProgramCount;
+				gen->NextPsi += GEN_PSI_TICKS;
+			}
+			if( gen->PsiPending == 1 + gen->ProgramCount ){
+				gen_pat( gen, packet );
+			}else{
+				gen_pmt( gen, packet, &gen->Programs[ gen->ProgramCount - gen->PsiPending ] );
+			}
+			gen->PsiPending--;
+		}else{
+			for( i = 0 ; i < gen->ProgramCount ; i++ ){
+				if( ticks >= gen->Programs[ i ].NextPcr ){
+					program = &gen->Programs[ i ];
+					program->NextPcr += GEN_PCR_TICKS;
+					pcr = true;
+					break;
+				}
+			}
+			if( ( NULL == program ) && ( ( gen_random( gen ) >> 11 ) * ( 1.0 / 9007199254740992.0 ) < gen_video_share( gen, ticks ) ) ){
+				program = &gen->Programs[ gen->NextVideo ];
+				gen->NextVideo = ( gen->NextVideo + 1 ) % gen->ProgramCount;
+			}
+			if( NULL != program ){
+				gen_video( gen, packet, program, ticks, pcr );
+			}else{
+				gen_null( gen, packet );
+			}
+		}
+		gen->Packets++;
+		gen->BufferPackets++;
+
+		if( ( 0 < gen->SyncErrorInterval ) && ( gen->Packets >= gen->NextSyncError ) ){
+			gen->NextSyncError += 1 + gen_random( gen ) % ( 2 * gen->SyncErrorInterval );
+			gen->SyncErrors++;
+			if( gen_random( gen ) & 1 ){
+				packet[ 0 ] = 0x00;
+			}else{
+				uint8_t		garbage[ TS_PACKET_SIZE ];
+				uint32_t	size = 1 + gen_random( gen ) % ( TS_PACKET_SIZE - 1 );
+
+				memset( garbage, 0xA5, size );
+				if( !gen_flush( gen, garbage, size ) ){
+					return false;
+				}
+				continue;
+			}
+		}
+		if( ( GEN_BUFFER_PACKETS == gen->BufferPackets ) && !gen_flush( gen, NULL, 0 ) ){
+			return false;
+		}
+	}
+
+	return gen_flush( gen, NULL, 0 );
+}
+
+/**
+* @brief		Convert "YYYY/MM/DD-hh:mm:ss" to MJD and second of day
+*/
+static	bool			get_datetime( const char* str_datetime, uint16_t* mjd, uint32_t* sec )
+{
+	uint64_t	datetime;
+
+	if( !ts_tot_datetime_parse( str_datetime, &datetime ) ){
+		return false;
+	}
+	*mjd = TS_DATETIME_MJD( datetime );
+	*sec = TS_DATETIME_SEC( datetime );
+
+	return true;
+}
+
+/**
+* @brief		Show help
+*/
+static	void			show_help( void )
+{
+	printf( " -o\tOutput TS file path. \"-\" writes stdout.\n" );
+	printf( " -d\tDuration in seconds (default = 60).\n" );
+	printf( " -r\tBitrate in bps (default = 20000000).\n" );
+	printf( " -p\tNumber of programs, one PCR PID each (default = 1, max = %d).\n", GEN_PROGRAMS_MAX );
+	printf( " -t\tTOT interval in seconds (default = 5).\n" );
+	printf( " -n\tNull packets in percent of the multiplex (default = 20).\n" );
+	printf( " -v\tVBR profile of video : cbr, sine, burst (default = cbr).\n" );
+	printf( " -e\tInject a sync error about every N packets (default = 0, none).\n" );
+	printf( " -s\tRandom seed (default = 1).\n" );
+	printf( " -T\tTime of the first TOT (default = 2018/09/01-10:00:00).\n" );
+	printf( " -h\tShow Help.\n" );
+}
+
+/**
+* @brief		Main
+*/
+int						main( int args, char* argc[] )
+{
+	GEN				gen;
+	char*			out_filename = NULL;
+	char			ch;
+	uint32_t		i;
+	int				result = 0;
+
+	memset( &gen, 0, sizeof( gen ) );
+	gen.Bitrate = 20000000;
+	gen.Seconds = 60;
+	gen.ProgramCount = 1;
+	gen.TotInterval = 5;
+	gen.NullPercent = 20;
+	gen.Seed = 1;
+	get_datetime( "2018/09/01-10:00:00", &gen.StartMjd, &gen.StartSec );
+
+	while( (ch = getopt( args, argc, "o:d:r:p:t:n:v:e:s:T:h") ) != -1 ){
+		if( ch == 255 ){
+			break;
+		}
+		switch( ch ){
+			case 'o':
+				out_filename = optarg;
+				break;
+			case 'd':
+				gen.Seconds = atol( optarg );
+				break;
+			case 'r':
+				gen.Bitrate = strtoull( optarg, NULL, 0 );
+				break;
+			case 'p':
+				gen.ProgramCount = atol( optarg );
+				break;
+			case 't':
+				gen.TotInterval = atol( optarg );
+				break;
+			case 'n':
+				gen.NullPercent = atol( optarg );
+				break;
+			case 'v':
+				for( i = 0 ; ( i < GEN_VBR_MAX ) && ( 0 != strcmp( optarg, VbrName[ i ] ) ) ; i++ );
+				if( GEN_VBR_MAX == i ){
+					printf( "Unknown VBR profile. [%s]\n", optarg );
+					return -1;
+				}
+				gen.Vbr = i;
+				break;
+			case 'e':
+				gen.SyncErrorInterval = atol( optarg );
+				break;
+			case 's':
+				gen.Seed = strtoull( optarg, NULL, 0 );
+				break;
+			case 'T':
+				if( !get_datetime( optarg, &gen.StartMjd, &gen.StartSec ) ){
+					printf( "Datetime format error. [%s]\n", optarg );
+					return -1;
+				}
+				break;
+			case 'h':
+			default:
+				show_help();
+				return 0;
+				break;
+		}
+	}
+
+	if( NULL == out_filename ){
+		printf( "Please input Out File. -o filepath \n" );
+		return -1;
+	}
+	if(    ( 0 == gen.ProgramCount ) || ( GEN_PROGRAMS_MAX < gen.ProgramCount )
+		|| ( 0 == gen.TotInterval ) || ( 100 < gen.NullPercent ) || ( TS_PACKET_SIZE * 8 * 100 > gen.Bitrate ) ){
+		printf( "Option out of range.\n" );
+		return -1;
+	}
+
+	gen.Random = gen.Seed * 0x9E3779B97F4A7C15ULL + 1;
+	gen.NextSyncError = gen.SyncErrorInterval;
+	for( i = 0 ; i < gen.ProgramCount ; i++ ){
+		gen.Programs[ i ].PmtPid = GEN_PMT_PID_BASE + i;
+		gen.Programs[ i ].VideoPid = GEN_VIDEO_PID_BASE + i * 0x10;
+	}
+
+	gen.Fd = ( 0 == strcmp( out_filename, "-" ) ) ? STDOUT_FILENO : open( out_filename, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+	gen.Buffer = malloc( GEN_BUFFER_PACKETS * TS_PACKET_SIZE );
+	if( ( 0 > gen.Fd ) || ( NULL == gen.Buffer ) ){
+		printf( "%s()[%d] OUT File open error. [%s]\n", __func__, __LINE__, out_filename );
+		free( gen.Buffer );
+		return -1;
+	}
+
+	if( !gen_run( &gen ) ){
+		perror( "Write error." );
+		result = -1;
+	}
+	if( STDOUT_FILENO != gen.Fd ){
+		close( gen.Fd );
+		fprintf( stderr, "%s : %lu packets ( null %lu ), %lu sync errors\n", out_filename, gen.Packets, gen.NullPackets, gen.SyncErrors );
+	}
+	free( gen.Buffer );
+
+	return result;
+}
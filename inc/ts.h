@@ -23,8 +23,12 @@
 #define TS_SYNC_BYTE			( 0x47 )
 
 #define PID_NULL				( 0x1FFF )
+#define PID_PAT					( 0x0000 )
 #define PID_TOT					( 0x0014 )
+#define PID_SI_LAST				( 0x001F )			// PIDs up to this one are reserved for PSI / SI
 
+#define TABLE_ID_PAT			( 0x00 )
+#define TABLE_ID_PMT			( 0x02 )
 #define TABLE_ID_TOT			( 0x73 )
 
 #define GET_PCR( pcr_bin, pcr )		{														\
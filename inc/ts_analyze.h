@@ -0,0 +1,82 @@
+/**
+* @file ts_analyze.h
+* @brief Whole file TS analysis
+* @author sage
+* @date 2018/11/13
+*/
+
+#ifndef __TS_ANALYZE_HEADER__
+#define __TS_ANALYZE_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts_packet.h"
+#include "ts_reader.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define TS_PID_MAX						( 8192 )
+
+/**
+* @def		TS_PCR_JUMP_TICKS
+* @brief	A PCR step larger than this ( 100ms ) without discontinuity_indicator is a discontinuity
+*/
+#define TS_PCR_JUMP_TICKS				( PCR_CLOCK_EXT / 10 )
+
+/**
+* @def		TS_ANALYZE_CHUNK_MIN
+* @brief	Minimum chunk size of the parallel analysis
+*/
+#define TS_ANALYZE_CHUNK_MIN			( 16 * 1024 * 1024 )
+
+#define TS_PID_STATS_HAS_CC				( 0x01 )
+#define TS_PID_STATS_HAS_PCR			( 0x02 )
+#define TS_PID_STATS_FIRST_CC_DISCONT	( 0x04 )		// First payload packet has discontinuity_indicator
+#define TS_PID_STATS_FIRST_PCR_DISCONT	( 0x08 )		// First PCR packet has discontinuity_indicator
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+/**
+* @brief	Statistics of one PID
+* @details	First* fields keep the head state of a chunk for the boundary fix-up of ts_analyze_merge().
+*/
+typedef struct {
+	uint64_t		Packets;
+	uint64_t		PayloadBytes;
+	uint64_t		TeiErrors;
+	uint64_t		ScrambledEven;
+	uint64_t		ScrambledOdd;
+	uint64_t		AdaptationFields;
+	uint64_t		CcErrors;
+	uint64_t		PcrCount;
+	uint64_t		PcrDiscontinuities;
+	uint64_t		CrcErrors;				// PSI / SI sections with a wrong CRC_32
+	uint64_t		FirstPcr;
+	uint64_t		FirstPcrOffset;
+	uint64_t		LastPcr;
+	uint64_t		LastPcrOffset;
+	uint8_t			FirstCc;
+	uint8_t			LastCc;
+	uint8_t			Flags;					// TS_PID_STATS_*
+} TS_PID_STATS;
+
+typedef struct {
+	uint64_t		StartOffset;
+	uint64_t		EndOffset;
+	uint64_t		Packets;
+	uint64_t		SkippedBytes;
+	TS_PID_STATS	Pid[ TS_PID_MAX ];
+} TS_ANALYSIS;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_analyze_init( TS_ANALYSIS* analysis );
+void			ts_analyze_batch( TS_ANALYSIS* analysis, const TS_PACKET_BATCH* batch, uint64_t offset );
+void			ts_analyze_merge( TS_ANALYSIS* total, const TS_ANALYSIS* next );
+bool			ts_analyze_file( const char* ts_file, TS_READER_MODE mode, uint32_t threads, TS_ANALYSIS* analysis );
+
+#endif
@@ -0,0 +1,20 @@
+/**
+* @file ts_bitrate.h
+* @brief TS bitrate calculation
+* @author sage
+* @date 2018/10/02
+*/
+
+#ifndef __TS_BITRATE_HEADER__
+#define __TS_BITRATE_HEADER__
+
+#include <stdint.h>
+
+#include "ts_reader.h"
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+double			ts_calc_bitrate( const char* ts_file, TS_READER_MODE mode, const uint32_t use_pcr_count );
+
+#endif
@@ -0,0 +1,27 @@
+/**
+* @file ts_crc32.h
+* @brief MPEG-2 CRC32
+* @author sage
+* @date 2018/12/18
+* @details Polynomial 0x04C11DB7, MSB first, no final XOR ( ISO/IEC 13818-1 Annex A ).\n
+*			The CRC of a whole section including its CRC_32 field is 0.
+*/
+
+#ifndef __TS_CRC32_HEADER__
+#define __TS_CRC32_HEADER__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define TS_CRC32_INIT					( 0xFFFFFFFF )
+#define TS_CRC32_POLY					( 0x04C11DB7 )
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+uint32_t		ts_crc32( const uint8_t* data, size_t size, uint32_t crc );
+
+#endif
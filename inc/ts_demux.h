@@ -0,0 +1,111 @@
+/**
+* @file ts_demux.h
+* @brief Push demux for embedding
+* @author sage
+* @date 2019/02/19
+* @details The caller pushes buffers of any size as they arrive ( socket, file, ring ) and\n
+*			the demux calls the handlers registered per PID and per table_id.\n
+*			Packets inside a pushed buffer are handed over in place. Only a packet split between\n
+*			two pushes, and the few packets read while re-locking, pass through a small carry buffer.\n
+*			One TS_DEMUX per stream, no global state, so a process can run many of them.
+*/
+
+#ifndef __TS_DEMUX_HEADER__
+#define __TS_DEMUX_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_section.h"
+#include "ts_sync.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_DEMUX_HANDLERS_MAX
+* @brief	Distinct ( handler, context ) pairs of one demux. The dispatch table holds 1 byte per PID
+*/
+#define TS_DEMUX_HANDLERS_MAX			( 255 )
+
+/**
+* @def		TS_DEMUX_CARRY_SIZE
+* @brief	Bytes kept between pushes. A partial packet, or the bytes searched for the sync window
+*/
+#define TS_DEMUX_CARRY_SIZE				( 2 * TS_SYNC_WINDOW_PACKETS * TS_PACKET_SIZE )
+
+/**
+* @def		TS_DEMUX_TABLE_ANY
+* @brief	table_id of ts_demux_set_table() receiving the sections without their own handler
+*/
+#define TS_DEMUX_TABLE_ANY				( 0x100 )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+/**
+* @brief	View of one packet. Every pointer is valid only during the handler
+*/
+typedef struct {
+	const uint8_t*	Packet;					// TS_PACKET_SIZE bytes
+	uint64_t		Offset;					// Stream offset of the packet ( bytes pushed before it )
+	uint16_t		Pid;
+	uint16_t		Flags;					// TS_PKT_FLAG_*
+	uint8_t			ContinuityCounter;
+	uint64_t		Pcr;					// 27MHz, valid with TS_PKT_FLAG_PCR
+	const uint8_t*	Payload;				// NULL without payload
+	uint32_t		PayloadSize;
+} TS_DEMUX_PACKET;
+
+/**
+* @brief		Called for every packet of a registered PID
+* @param[in]	context		Context given at registration
+* @param[in]	packet		Packet view
+*/
+typedef void	( *TS_DEMUX_PACKET_HANDLER )( void* context, const TS_DEMUX_PACKET* packet );
+
+typedef struct {
+	TS_DEMUX_PACKET_HANDLER	Handler;
+	void*					Context;
+} TS_DEMUX_HANDLER;
+
+typedef struct {
+	TS_SECTION_HANDLER		Handler;
+	void*					Context;
+} TS_DEMUX_TABLE;
+
+typedef struct {
+	uint8_t				Dispatch[ 8192 ];						// Handlers index + 1 per PID. 0 is none
+	TS_DEMUX_HANDLER	Handlers[ TS_DEMUX_HANDLERS_MAX ];
+	uint32_t			HandlerCount;
+
+	TS_SECTION_FILTER*	Sections;								// NULL until the first table is registered
+	TS_DEMUX_TABLE		Tables[ TS_DEMUX_TABLE_ANY + 1 ];		// Per table_id, and TS_DEMUX_TABLE_ANY
+
+	TS_PACKET_BATCH		Batch;
+	uint8_t				Carry[ TS_DEMUX_CARRY_SIZE ];
+	uint32_t			CarryLength;
+	bool				Locked;									// Packet aligned. Carry holds a partial packet
+	uint64_t			Position;								// Bytes consumed from the pushes
+
+	uint64_t			Packets;
+	uint64_t			Resyncs;
+	uint64_t			SkippedBytes;
+} TS_DEMUX;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+TS_DEMUX*		ts_demux_create( void );
+void			ts_demux_destroy( TS_DEMUX* demux );
+void			ts_demux_init( TS_DEMUX* demux );
+void			ts_demux_free( TS_DEMUX* demux );
+bool			ts_demux_set_pid( TS_DEMUX* demux, uint16_t pid, TS_DEMUX_PACKET_HANDLER handler, void* context );
+bool			ts_demux_set_table( TS_DEMUX* demux, uint16_t pid, uint32_t table_id, TS_SECTION_HANDLER handler, void* context );
+void			ts_demux_push( TS_DEMUX* demux, const uint8_t* data, size_t size );
+void			ts_demux_finish( TS_DEMUX* demux );
+
+#endif
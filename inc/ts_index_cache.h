@@ -0,0 +1,55 @@
+/**
+* @file ts_index_cache.h
+* @brief LRU cache of per-recording indexes
+* @author sage
+* @date 2019/02/26
+* @details Keeps the TOT index and the random access point ( PCR ) index of recently used TS files\n
+*			in memory for a long running process. An entry is keyed by path, size and mtime,\n
+*			so a recording which is still growing is indexed again. Safe from several threads.
+*/
+
+#ifndef __TS_INDEX_CACHE_HEADER__
+#define __TS_INDEX_CACHE_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "ts_tot.h"
+#include "ts_rap.h"
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	char*			Path;					// NULL if the slot is empty
+	uint64_t		FileSize;
+	int64_t			FileMtime;
+	TS_TOT_INDEX	Tot;
+	TS_RAP_INDEX	Rap;
+	bool			HasRap;
+	bool			Building;				// A thread is loading or building the indexes
+	bool			Private;				// Not in the cache ( every slot was in use ), freed by release
+	uint32_t		Users;					// Acquired and not released. Not evicted while non zero
+	uint64_t		LastUsed;
+} TS_INDEX_CACHE_ENTRY;
+
+typedef struct {
+	pthread_mutex_t			Lock;
+	pthread_cond_t			Built;
+	TS_INDEX_CACHE_ENTRY*	Entries;
+	uint32_t				Capacity;
+	uint64_t				Tick;
+	uint64_t				Hits;
+	uint64_t				Misses;
+} TS_INDEX_CACHE;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool					ts_index_cache_init( TS_INDEX_CACHE* cache, uint32_t capacity );
+TS_INDEX_CACHE_ENTRY*	ts_index_cache_acquire( TS_INDEX_CACHE* cache, const char* ts_file, TS_READER_MODE mode, bool rap );
+void					ts_index_cache_release( TS_INDEX_CACHE* cache, TS_INDEX_CACHE_ENTRY* entry );
+void					ts_index_cache_free( TS_INDEX_CACHE* cache );
+
+#endif
@@ -0,0 +1,40 @@
+/**
+* @file ts_index_file.h
+* @brief Index files kept next to a TS file
+* @author sage
+* @date 2019/03/04
+* @details Common part of the TOT index ( .totidx ) and the random access point index ( .rapidx ).\n
+*			An index file is a header followed by fixed size entries. Every header starts with\n
+*			TS_INDEX_FILE_HEADER, so an index is rejected once the TS file is changed.
+*/
+
+#ifndef __TS_INDEX_FILE_HEADER__
+#define __TS_INDEX_FILE_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+/**
+* @brief	First fields of every index file header
+*/
+typedef struct {
+	char			Magic[ 4 ];
+	uint32_t		Version;
+	uint64_t		FileSize;				// Size of the indexed TS file
+	int64_t			FileMtime;				// mtime of the indexed TS file
+} TS_INDEX_FILE_HEADER;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_index_file_stamp( void* header, const char* magic, uint32_t version, const char* ts_file );
+void*			ts_index_file_append( void** entries, uint64_t* count, uint64_t* capacity, size_t entry_size );
+bool			ts_index_file_save( const char* index_file, const void* header, size_t header_size, const void* entries, size_t entry_size, uint64_t count );
+bool			ts_index_file_load( const char* index_file, const char* ts_file, const char* magic, uint32_t version,
+									void* header, size_t header_size, const uint64_t* count, void** entries, size_t entry_size );
+
+#endif
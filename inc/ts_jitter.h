@@ -0,0 +1,101 @@
+/**
+* @file ts_jitter.h
+* @brief PCR accuracy analysis
+* @author sage
+* @date 2018/12/04
+* @details PCR repetition interval, overall jitter, frequency offset and drift per PCR PID\n
+*			( TR 101 290 priority 2 ). The byte position is used as the arrival clock,\n
+*			so the input is expected to be recorded at a constant multiplex rate.
+*/
+
+#ifndef __TS_JITTER_HEADER__
+#define __TS_JITTER_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts_packet.h"
+#include "ts_reader.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_JITTER_WINDOW_TICKS
+* @brief	Jitter and frequency offset are measured against a linear fit of this period ( 10s )
+*/
+#define TS_JITTER_WINDOW_TICKS			( 10 * ( uint64_t )PCR_CLOCK_EXT )
+#define TS_JITTER_WINDOW_SAMPLES		( 4096 )
+
+/**
+* @def		TS_JITTER_INTERVAL_LIMIT_TICKS
+* @brief	PCR repetition limit of TR 101 290 ( 40ms )
+*/
+#define TS_JITTER_INTERVAL_LIMIT_TICKS	( PCR_CLOCK_EXT / 25 )
+
+/**
+* @def		TS_JITTER_JUMP_TICKS
+* @brief	A PCR step larger than this ( 1s ) or backwards is a discontinuity
+*/
+#define TS_JITTER_JUMP_TICKS			( PCR_CLOCK_EXT )
+
+#define TS_JITTER_INTERVAL_BINS			( 200 )			// 1ms per bin, the last bin holds the rest
+#define TS_JITTER_INTERVAL_BIN_US		( 1000 )
+#define TS_JITTER_OJ_BINS				( 1000 )		// 100ns per bin, the last bin holds the rest
+#define TS_JITTER_OJ_BIN_NS				( 100 )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	uint64_t		Offset;					// File offset of the PCR packet
+	uint64_t		Time;					// Unwrapped PCR ( 27MHz )
+} TS_JITTER_SAMPLE;
+
+/**
+* @brief	Analysis of one PCR PID
+*/
+typedef struct {
+	uint64_t			PcrCount;
+	uint64_t			Discontinuities;
+
+	uint64_t			IntervalCount;
+	uint64_t			IntervalSum;				// 27MHz
+	uint64_t			IntervalMax;				// 27MHz
+	uint64_t			IntervalOver;				// Intervals over TS_JITTER_INTERVAL_LIMIT_TICKS
+	uint64_t			IntervalHistogram[ TS_JITTER_INTERVAL_BINS ];
+
+	uint64_t			JitterCount;
+	double				JitterMax;					// ns
+	uint64_t			JitterHistogram[ TS_JITTER_OJ_BINS ];
+
+	uint32_t			Windows;
+	double				ReferenceRate;				// 27MHz ticks per byte of the first window
+	double				FrequencyOffset;			// ppm of the last window
+	double				FrequencyOffsetMin;			// ppm
+	double				FrequencyOffsetMax;			// ppm
+	double				DriftMax;					// ppm/s, absolute
+	uint64_t			LastWindowTime;				// Middle of the last window ( 27MHz )
+
+	bool				Valid;
+	uint64_t			LastPcr;
+	uint64_t			Time;						// Unwrapped PCR
+	uint32_t			SampleCount;
+	TS_JITTER_SAMPLE	Samples[ TS_JITTER_WINDOW_SAMPLES ];
+} TS_PCR_JITTER;
+
+typedef struct {
+	TS_PCR_JITTER*		Pid[ 8192 ];				// NULL until the PID carries a PCR
+} TS_JITTER;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_jitter_init( TS_JITTER* jitter );
+bool			ts_jitter_batch( TS_JITTER* jitter, const TS_PACKET_BATCH* batch, uint64_t offset );
+void			ts_jitter_finish( TS_JITTER* jitter );
+bool			ts_jitter_file( const char* ts_file, TS_READER_MODE mode, TS_JITTER* jitter );
+void			ts_jitter_free( TS_JITTER* jitter );
+double			ts_jitter_percentile( const uint64_t* histogram, uint32_t bins, double bin_width, double percent, double max );
+
+#endif
@@ -0,0 +1,75 @@
+/**
+* @file ts_live.h
+* @brief Live TS input
+* @author sage
+* @date 2018/12/11
+* @details A receive thread reads stdin or a UDP socket into a TS_RING.\n
+*			Open a TS_READER on the ring with ts_reader_open_ring().
+*/
+
+#ifndef __TS_LIVE_HEADER__
+#define __TS_LIVE_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "ts_ring.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define TS_LIVE_UDP_PREFIX				"udp://"
+
+/**
+* @def		TS_LIVE_RING_BLOCKS
+* @brief	Ring of stdin ( 1024 blocks of TS_RING_BLOCK_SIZE, 64MB ). One read() per block
+*/
+#define TS_LIVE_RING_BLOCKS				( 1024 )
+
+/**
+* @def		TS_LIVE_UDP_BLOCK_SIZE
+* @brief	Block of UDP input. Filled with datagrams while one of the largest size ( TS_RING_BLOCK_SIZE ) still fits
+*/
+#define TS_LIVE_UDP_BLOCK_SIZE			( 1024 * 1024 )
+
+/**
+* @def		TS_LIVE_UDP_RING_BLOCKS
+* @brief	Ring of UDP input ( 64MB ). While the output stalls, blocks hold at least 960KB each,\n
+*			so the ring holds several seconds of a full multiplex
+*/
+#define TS_LIVE_UDP_RING_BLOCKS			( 64 )
+
+/**
+* @def		TS_LIVE_UDP_BEHIND_BLOCKS
+* @brief	Blocks in use from which the consumer is behind. Then a UDP block is published only when full
+*/
+#define TS_LIVE_UDP_BEHIND_BLOCKS		( TS_LIVE_UDP_RING_BLOCKS / 4 )
+
+/**
+* @def		TS_LIVE_UDP_RCVBUF
+* @brief	Socket receive buffer, covers the producer waiting on a full ring
+*/
+#define TS_LIVE_UDP_RCVBUF				( 16 * 1024 * 1024 )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	TS_RING			Ring;
+	int				Fd;
+	bool			Udp;
+	pthread_t		Thread;
+	bool			Started;
+	uint64_t		Bytes;					// Received bytes
+	bool			Error;					// Receive error ended the input
+} TS_LIVE;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_live_open( TS_LIVE* live, const char* source );
+void			ts_live_stop( TS_LIVE* live );
+void			ts_live_close( TS_LIVE* live );
+
+#endif
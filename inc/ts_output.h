@@ -0,0 +1,38 @@
+/**
+* @file ts_output.h
+* @brief Byte range output
+* @author sage
+* @date 2018/11/06
+*/
+
+#ifndef __TS_OUTPUT_HEADER__
+#define __TS_OUTPUT_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_OUTPUT_BUFFER_SIZE
+* @brief	Buffer size of the read/write fallback
+*/
+#define TS_OUTPUT_BUFFER_SIZE			( 8 * 1024 * 1024 )
+
+/*------------------------------------------------------------------------------
+ Enum
+------------------------------------------------------------------------------*/
+typedef enum {
+	TS_COPY_NONE = 0,
+	TS_COPY_FILE_RANGE,				// copy_file_range ( reflink on XFS/btrfs )
+	TS_COPY_SENDFILE,				// sendfile
+	TS_COPY_READ_WRITE,				// pread + write
+} TS_COPY_METHOD;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_copy_range( int in_fd, int out_fd, uint64_t offset, uint64_t length, TS_COPY_METHOD* method );
+
+#endif
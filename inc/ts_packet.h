@@ -0,0 +1,75 @@
+/**
+* @file ts_packet.h
+* @brief TS packet batch parser
+* @author sage
+* @date 2018/10/02
+* @details Decodes the header of N contiguous TS packets into a struct-of-arrays.\n
+*			Payloads are never copied, only their offset inside the packet is recorded.
+*/
+
+#ifndef __TS_PACKET_HEADER__
+#define __TS_PACKET_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_BATCH_PACKETS
+* @brief	Maximum number of packets decoded by one ts_parse_batch() call
+*/
+#define TS_BATCH_PACKETS				( 512 )
+
+#define TS_PKT_FLAG_TEI					( 0x0001 )		// transport_error_indicator
+#define TS_PKT_FLAG_PUSI				( 0x0002 )		// payload_unit_start_indicator
+#define TS_PKT_FLAG_PRIORITY			( 0x0004 )		// transport_priority
+#define TS_PKT_FLAG_ADAPTATION			( 0x0008 )		// adaptation_field present
+#define TS_PKT_FLAG_PAYLOAD				( 0x0010 )		// payload present
+#define TS_PKT_FLAG_PCR					( 0x0020 )		// PCR present
+#define TS_PKT_FLAG_DISCONTINUITY		( 0x0040 )		// discontinuity_indicator
+#define TS_PKT_FLAG_RANDOM_ACCESS		( 0x0080 )		// random_access_indicator
+#define TS_PKT_FLAG_SYNC_ERROR			( 0x0100 )		// sync_byte is not 0x47
+#define TS_PKT_FLAG_SCRAMBLE_SHIFT		( 14 )
+
+#define TS_PKT_SCRAMBLE(flags)			( ( TS_SCRAMBLE )( ( (flags) >> TS_PKT_FLAG_SCRAMBLE_SHIFT ) & 0x03 ) )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+/**
+* @brief	Decoded headers of contiguous TS packets (struct-of-arrays)
+* @details	Packet i starts at Packets + i * TS_PACKET_SIZE.\n
+*			Its payload starts at PayloadOffset[ i ] inside that packet ( TS_PACKET_SIZE when there is none ).
+*/
+typedef struct {
+	const uint8_t*	Packets;
+	uint32_t		Count;
+	uint16_t		Pid[ TS_BATCH_PACKETS ];
+	uint16_t		Flags[ TS_BATCH_PACKETS ];
+	uint8_t			ContinuityCounter[ TS_BATCH_PACKETS ];
+	uint8_t			PayloadOffset[ TS_BATCH_PACKETS ];
+	uint64_t		Pcr[ TS_BATCH_PACKETS ];
+} TS_PACKET_BATCH;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+uint32_t		ts_parse_batch( const uint8_t* packets, uint32_t count, TS_PACKET_BATCH* batch );
+void			ts_parse_header( const uint8_t* ts_packet, TS_HEADER* header );
+
+/**
+* @brief		Continuity counter check
+* @param[in]	last_cc		CC of the previous payload packet
+* @param[in]	cc			CC of this payload packet
+* @return		bool		true if discontinuous. One duplicate packet is allowed
+*/
+static inline	bool	ts_cc_error( uint8_t last_cc, uint8_t cc )
+{
+	return ( cc != last_cc ) && ( cc != ( ( last_cc + 1 ) & 0x0F ) );
+}
+
+#endif
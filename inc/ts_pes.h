@@ -0,0 +1,103 @@
+/**
+* @file ts_pes.h
+* @brief PES reassembly
+* @author sage
+* @date 2018/12/25
+* @details Rebuilds the PES packets of the selected PIDs and decodes PTS / DTS.\n
+*			Payload bytes are copied once from the TS packets into pooled blocks,\n
+*			a PES is handed over as the chain of its blocks and the blocks return to the pool after the handler.
+*/
+
+#ifndef __TS_PES_HEADER__
+#define __TS_PES_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_PES_BLOCK_SIZE
+* @brief	Size of a pooled block. An audio PES fits in one, a video frame takes a chain
+*/
+#define TS_PES_BLOCK_SIZE				( 64 * 1024 )
+
+/**
+* @def		TS_PES_SIZE_MAX
+* @brief	A PES of unbounded length longer than this is dropped ( broken stream )
+*/
+#define TS_PES_SIZE_MAX					( 64 * 1024 * 1024 )
+
+#define TS_PES_HEADER_SIZE				( 6 )			// packet_start_code_prefix, stream_id, PES_packet_length
+#define TS_PES_TIMESTAMP_NONE			( UINT64_MAX )
+#define PTS_CLOCK						( 90000 )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct TS_PES_BLOCK {
+	struct TS_PES_BLOCK*	Next;
+	uint32_t				Length;
+	uint8_t					Data[ TS_PES_BLOCK_SIZE ];
+} TS_PES_BLOCK;
+
+/**
+* @brief	One complete PES
+* @details	The PES header is HeaderSize bytes at the head of the first block, the ES data follows it.
+*/
+typedef struct {
+	uint16_t		Pid;
+	uint8_t			StreamId;
+	uint64_t		Offset;					// File offset of the TS packet starting the PES
+	uint32_t		Size;					// Size of the whole PES
+	uint32_t		HeaderSize;				// PES header including the optional fields
+	uint64_t		Pts;					// 90kHz, TS_PES_TIMESTAMP_NONE if absent
+	uint64_t		Dts;					// 90kHz, TS_PES_TIMESTAMP_NONE if absent
+	TS_PES_BLOCK*	Blocks;
+} TS_PES;
+
+/**
+* @brief		Called for every complete PES
+* @param[in]	context		Context given to ts_pes_init()
+* @param[in]	pes			PES. The blocks are valid only during the call
+*/
+typedef void	( *TS_PES_HANDLER )( void* context, const TS_PES* pes );
+
+/**
+* @brief	Reassembly state of one PID
+*/
+typedef struct {
+	TS_PES			Pes;
+	TS_PES_BLOCK*	Last;
+	uint32_t		Expected;				// Size from PES_packet_length. 0 if unbounded or unknown yet
+	bool			Active;					// Collecting a PES
+	uint8_t			LastCc;
+	bool			HasCc;
+	uint64_t		PesCount;				// Delivered PES
+	uint64_t		Bytes;					// ES bytes of the delivered PES
+	uint64_t		Dropped;				// PES lost by a CC error, TEI, scrambling or a broken header
+} TS_PES_STREAM;
+
+typedef struct {
+	TS_PES_STREAM*	Pid[ 8192 ];			// NULL unless the PID is selected
+	TS_PES_BLOCK*	FreeBlocks;
+	uint32_t		BlockCount;				// Allocated blocks
+	TS_PES_HANDLER	Handler;
+	void*			Context;
+} TS_PES_DEMUX;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_pes_init( TS_PES_DEMUX* demux, TS_PES_HANDLER handler, void* context );
+bool			ts_pes_add_pid( TS_PES_DEMUX* demux, uint16_t pid );
+void			ts_pes_packet( TS_PES_DEMUX* demux, const uint8_t* ts_packet, uint16_t pid, uint16_t flags, uint8_t cc, uint8_t payload_offset, uint64_t offset );
+void			ts_pes_batch( TS_PES_DEMUX* demux, const TS_PACKET_BATCH* batch, uint64_t offset );
+void			ts_pes_flush( TS_PES_DEMUX* demux );
+void			ts_pes_free( TS_PES_DEMUX* demux );
+
+#endif
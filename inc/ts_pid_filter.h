@@ -0,0 +1,68 @@
+/**
+* @file ts_pid_filter.h
+* @brief PID selection of output packets
+* @author sage
+* @date 2019/01/22
+* @details One bit per PID. Include lists, exclude lists and a program number resolved through\n
+*			PAT / PMT are folded into one 8192 bit map, so the copy loop tests one bit per packet.
+*/
+
+#ifndef __TS_PID_FILTER_HEADER__
+#define __TS_PID_FILTER_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_section.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define TS_PID_FILTER_WORDS				( 8192 / 64 )
+
+/**
+* @def		TS_PID_FILTER_SCAN_BYTES
+* @brief	Bytes read from the head of a seekable input to find the PMT of the selected program
+*/
+#define TS_PID_FILTER_SCAN_BYTES		( 64 * 1024 * 1024 )
+
+/**
+* @def		TS_PID_FILTER_PASS
+* @brief	true if packets of pid are written
+*/
+#define TS_PID_FILTER_PASS(f,pid)		( 0 != ( ( (f)->Pass[ (pid) >> 6 ] >> ( (pid) & 0x3F ) ) & 1 ) )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	uint64_t			Pass[ TS_PID_FILTER_WORDS ];		// Result. Select & ~Exclude, or ~Exclude without selection
+	uint64_t			Select[ TS_PID_FILTER_WORDS ];		// Include list and PIDs of the program
+	uint64_t			Exclude[ TS_PID_FILTER_WORDS ];
+	bool				Selective;							// Only selected PIDs are written
+	bool				Active;								// Some PID is dropped
+	uint16_t			ProgramNumber;						// 0 without program selection
+	uint16_t			PmtPid;								// PID_NULL until found in PAT
+	bool				Resolved;							// PMT of ProgramNumber was found
+	TS_SECTION_FILTER*	Sections;							// PAT / PMT. NULL without program selection
+	bool				PatReady;							// Pat holds the PAT of ProgramNumber
+	uint8_t				Pat[ TS_PACKET_SIZE ];				// PAT packet listing only ProgramNumber
+} TS_PID_FILTER;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_pid_filter_init( TS_PID_FILTER* filter );
+void			ts_pid_filter_include( TS_PID_FILTER* filter, uint16_t pid );
+void			ts_pid_filter_exclude( TS_PID_FILTER* filter, uint16_t pid );
+bool			ts_pid_filter_add_list( TS_PID_FILTER* filter, const char* list, bool include );
+bool			ts_pid_filter_program( TS_PID_FILTER* filter, uint16_t program_number );
+void			ts_pid_filter_batch( TS_PID_FILTER* filter, const TS_PACKET_BATCH* batch );
+const uint8_t*	ts_pid_filter_pat( TS_PID_FILTER* filter, const uint8_t* packet, uint16_t flags );
+bool			ts_pid_filter_resolve( TS_PID_FILTER* filter, TS_READER* reader );
+void			ts_pid_filter_free( TS_PID_FILTER* filter );
+
+#endif
@@ -0,0 +1,54 @@
+/**
+* @file ts_psi.h
+* @brief PAT / PMT parser
+* @author sage
+* @date 2019/01/08
+* @details Decodes complete sections delivered by TS_SECTION_FILTER.
+*/
+
+#ifndef __TS_PSI_HEADER__
+#define __TS_PSI_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define TS_PAT_PROGRAMS_MAX				( 256 )			// One PAT section holds at most 253
+#define TS_PMT_STREAMS_MAX				( 64 )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	uint16_t		ProgramNumber;			// 0 is the network PID
+	uint16_t		Pid;					// PMT PID
+} TS_PAT_PROGRAM;
+
+typedef struct {
+	uint16_t		TransportStreamId;
+	uint32_t		Count;
+	TS_PAT_PROGRAM	Programs[ TS_PAT_PROGRAMS_MAX ];
+} TS_PAT;
+
+typedef struct {
+	uint8_t			StreamType;
+	uint16_t		Pid;
+} TS_PMT_STREAM;
+
+typedef struct {
+	uint16_t		ProgramNumber;
+	uint16_t		PcrPid;
+	uint32_t		Count;
+	TS_PMT_STREAM	Streams[ TS_PMT_STREAMS_MAX ];
+} TS_PMT;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_psi_parse_pat( const uint8_t* section, uint32_t size, TS_PAT* pat );
+bool			ts_psi_parse_pmt( const uint8_t* section, uint32_t size, TS_PMT* pmt );
+bool			ts_psi_is_video( uint8_t stream_type );
+
+#endif
@@ -0,0 +1,70 @@
+/**
+* @file ts_rap.h
+* @brief Random access point index
+* @author sage
+* @date 2019/01/08
+* @details Packets of the video PID with random_access_indicator and payload_unit_start_indicator,\n
+*			where a decoder can start. Saved next to the TS file like the TOT index.
+*/
+
+#ifndef __TS_RAP_HEADER__
+#define __TS_RAP_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ts_reader.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define TS_RAP_INDEX_SUFFIX				".rapidx"
+#define TS_RAP_INDEX_MAGIC				"TSRA"
+#define TS_RAP_INDEX_VERSION			( 1 )
+
+#define TS_RAP_PCR_NONE					( UINT64_MAX )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+/**
+* @brief	One random access point in the TS file
+*/
+typedef struct {
+	uint64_t		Offset;					// File offset of the packet
+	uint64_t		Pcr;					// Last PCR of the PCR PID at the packet ( 27MHz ). TS_RAP_PCR_NONE if none yet
+} TS_RAP_ENTRY;
+
+/**
+* @brief	Header of the index file. Entries follow it.
+*/
+typedef struct {
+	char			Magic[ 4 ];
+	uint32_t		Version;
+	uint64_t		FileSize;				// Size of the indexed TS file
+	int64_t			FileMtime;				// mtime of the indexed TS file
+	uint16_t		Pid;					// Video PID. PID_NULL if the PMT had none
+	uint16_t		PcrPid;
+	uint32_t		Reserved;
+	uint64_t		Count;					// Number of entries
+} TS_RAP_INDEX_HEADER;
+
+typedef struct {
+	TS_RAP_INDEX_HEADER	Header;
+	TS_RAP_ENTRY*		Entries;
+	uint64_t			Capacity;
+} TS_RAP_INDEX;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_rap_index_path( const char* ts_file, char* index_file, size_t size );
+bool			ts_rap_index_build( const char* ts_file, TS_READER_MODE mode, TS_RAP_INDEX* index );
+bool			ts_rap_index_save( const char* index_file, const TS_RAP_INDEX* index );
+bool			ts_rap_index_load( const char* index_file, const char* ts_file, TS_RAP_INDEX* index );
+void			ts_rap_index_free( TS_RAP_INDEX* index );
+int64_t			ts_rap_index_nearest( const TS_RAP_INDEX* index, uint64_t offset );
+int64_t			ts_rap_index_before( const TS_RAP_INDEX* index, uint64_t offset );
+
+#endif
@@ -0,0 +1,99 @@
+/**
+* @file ts_reader.h
+* @brief TS packet reader
+* @author sage
+* @date 2018/10/09
+* @details Regular files are memory-mapped and packets are handed out in place.\n
+*			Pipes and other non-mappable inputs fall back to large block reads.\n
+*			With TS_READER_MODE_THREAD a read-ahead thread reads blocks while the caller parses.\n
+*			TS_READER_MODE_DIRECT reads the same way without filling the page cache, for full scans\n
+*			next to processes whose cached data must not be evicted.
+*/
+
+#ifndef __TS_READER_HEADER__
+#define __TS_READER_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "ts_ring.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_READER_STREAM_PACKETS
+* @brief	Number of packets read at once in stream mode
+*/
+#define TS_READER_STREAM_PACKETS		( 8192 )
+
+/**
+* @def		TS_READER_THREAD_BLOCK_SIZE
+* @brief	Read size of the read-ahead thread. Multiple of the packet size and of TS_RING_ALIGN
+*/
+#define TS_READER_THREAD_BLOCK_SIZE		( 188 * TS_RING_ALIGN )
+
+/**
+* @def		TS_READER_THREAD_BLOCKS
+* @brief	Blocks read ahead ( 12MB )
+*/
+#define TS_READER_THREAD_BLOCKS			( 16 )
+
+/*------------------------------------------------------------------------------
+ Enum
+------------------------------------------------------------------------------*/
+typedef enum {
+	TS_READER_MODE_MMAP = 0,
+	TS_READER_MODE_STREAM,
+	TS_READER_MODE_RING,
+	TS_READER_MODE_THREAD,
+	TS_READER_MODE_DIRECT,					// Opened as TS_READER_MODE_THREAD, files read with O_DIRECT
+} TS_READER_MODE;
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	TS_READER_MODE	Mode;
+	int				Fd;
+	bool			Seekable;
+	uint64_t		FileSize;				// 0 when unknown
+	uint64_t		Position;				// File offset of the next packet
+	
+	const uint8_t*	Map;					// TS_READER_MODE_MMAP
+	
+	uint8_t*		Buffer;					// TS_READER_MODE_STREAM. With a ring, data straddling two blocks
+	size_t			BufferSize;
+	size_t			BufferLength;
+	size_t			BufferPos;
+	bool			Eof;
+	
+	TS_RING*		Ring;					// TS_READER_MODE_RING, TS_READER_MODE_THREAD
+	TS_RING_BLOCK*	Block;					// Peeked block, handed out in place. NULL before the first peek
+	size_t			RingPos;				// Consumed or copied bytes of the current block
+	
+	TS_RING			ThreadRing;				// TS_READER_MODE_THREAD
+	pthread_t		Thread;
+	bool			ThreadStarted;
+	uint64_t		ThreadOffset;			// File offset of the first block read by the thread
+	int				DirectFd;				// TS_READER_MODE_DIRECT. O_DIRECT descriptor of the file, -1 without
+	bool			DropCache;				// TS_READER_MODE_DIRECT. Pages read through Fd are dropped behind the thread
+	
+	uint64_t		SkippedBytes;			// Bytes dropped to re-lock on sync bytes
+	uint64_t		ResyncCount;
+	bool			Seeked;					// Next re-lock follows a seek, not corruption
+} TS_READER;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_reader_open( TS_READER* reader, const char* ts_file, TS_READER_MODE mode );
+bool			ts_reader_open_ring( TS_READER* reader, TS_RING* ring );
+void			ts_reader_close( TS_READER* reader );
+uint32_t		ts_reader_next( TS_READER* reader, const uint8_t** packets, uint32_t max_packets );
+bool			ts_reader_seek( TS_READER* reader, uint64_t offset );
+uint64_t		ts_reader_tell( const TS_READER* reader );
+
+#endif
@@ -0,0 +1,56 @@
+/**
+* @file ts_restamp.h
+* @brief PCR / PTS / DTS restamping
+* @author sage
+* @date 2019/01/15
+* @details Shifts every time stamp of a packet sequence by one offset so that it starts at\n
+*			TS_RESTAMP_ORIGIN. Packets are rewritten in place, one at a time.
+*/
+
+#ifndef __TS_RESTAMP_HEADER__
+#define __TS_RESTAMP_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_RESTAMP_ORIGIN
+* @brief	First PCR of the output ( 1s ). PTS / DTS lead the PCR and must not go below 0
+*/
+#define TS_RESTAMP_ORIGIN				( ( uint64_t )PCR_CLOCK_EXT )
+
+/**
+* @def		TS_RESTAMP_JUMP_TICKS
+* @brief	A PCR step larger than this ( 1s ) or backwards without discontinuity_indicator is rebased too
+*/
+#define TS_RESTAMP_JUMP_TICKS			( ( uint64_t )PCR_CLOCK_EXT )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	bool			Started;
+	uint16_t		PcrPid;					// PID driving the rebase. PID_NULL until the first PCR
+	bool			HasPcr;					// LastPcr is valid
+	uint64_t		Shift;					// Subtracted from every time stamp ( 27MHz, multiple of 300 )
+	uint64_t		LastPcr;				// Input PCR of PcrPid
+	uint64_t		LastOutPcr;				// Output PCR of PcrPid
+	uint64_t		LastPcrBytes;			// Bytes before the last PCR packet
+	double			TicksPerByte;			// Of the last PCR interval. 0 if unknown
+	uint64_t		Bytes;					// Processed bytes
+	uint64_t		Rebases;				// Discontinuities joined
+} TS_RESTAMP;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_restamp_init( TS_RESTAMP* restamp );
+void			ts_restamp_start( TS_RESTAMP* restamp, uint16_t pcr_pid, uint64_t pcr );
+void			ts_restamp_packet( TS_RESTAMP* restamp, uint8_t* ts_packet, uint16_t pid, uint16_t flags, uint8_t payload_offset );
+
+#endif
@@ -0,0 +1,73 @@
+/**
+* @file ts_ring.h
+* @brief Single producer / single consumer block ring
+* @author sage
+* @date 2018/12/11
+* @details Lock-free hand over of input blocks from a receive thread to the parser.\n
+*			The producer reads or receives straight into a block, so a block is never copied in the ring.
+*/
+
+#ifndef __TS_RING_HEADER__
+#define __TS_RING_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_RING_BLOCK_SIZE
+* @brief	Size of one block of live input. Holds the largest UDP datagram
+*/
+#define TS_RING_BLOCK_SIZE				( 64 * 1024 )
+
+/**
+* @def		TS_RING_ALIGN
+* @brief	Alignment of block data. Blocks can be read with O_DIRECT
+*/
+#define TS_RING_ALIGN					( 4096 )
+
+/**
+* @def		TS_RING_WAIT_US
+* @brief	Sleep of a side waiting for the other one
+*/
+#define TS_RING_WAIT_US					( 100 )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	uint32_t		Length;
+	uint8_t*		Data;					// BlockSize bytes, aligned to TS_RING_ALIGN
+} TS_RING_BLOCK;
+
+typedef struct {
+	TS_RING_BLOCK*	Blocks;
+	uint8_t*		Data;
+	uint32_t		BlockCount;				// Power of 2
+	uint32_t		BlockSize;
+	uint32_t		Window;					// Blocks the producer may run ahead. 0 is BlockCount
+	uint64_t		Head;					// Blocks published by the producer
+	uint64_t		Tail;					// Blocks released by the consumer
+	bool			Closed;					// No more blocks will be published
+	uint64_t		FullWaits;				// Times the producer waited for a free block
+	uint64_t		MaxUsed;				// High water mark ( blocks )
+} TS_RING;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_ring_init( TS_RING* ring, uint32_t block_count, uint32_t block_size );
+void			ts_ring_free( TS_RING* ring );
+
+TS_RING_BLOCK*	ts_ring_acquire( TS_RING* ring );
+void			ts_ring_publish( TS_RING* ring );
+uint32_t		ts_ring_used( const TS_RING* ring );
+void			ts_ring_close( TS_RING* ring );
+
+TS_RING_BLOCK*	ts_ring_peek( TS_RING* ring, bool wait );
+void			ts_ring_release( TS_RING* ring );
+void			ts_ring_reset( TS_RING* ring );
+
+#endif
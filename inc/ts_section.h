@@ -0,0 +1,80 @@
+/**
+* @file ts_section.h
+* @brief PSI / SI section reassembly
+* @author sage
+* @date 2018/12/18
+* @details Rebuilds the sections of the selected PIDs from TS packets ( PAT, PMT, SDT, EIT, TOT ... ).\n
+*			pointer_field, sections spanning packets and several sections in one packet are handled.\n
+*			Sections with a CRC_32 are delivered only when the CRC is correct.
+*/
+
+#ifndef __TS_SECTION_HEADER__
+#define __TS_SECTION_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_SECTION_SIZE_MAX
+* @brief	Largest section ( private section, section_length 4093 )
+*/
+#define TS_SECTION_SIZE_MAX				( 4096 )
+#define TS_SECTION_HEADER_SIZE			( 3 )
+#define TS_SECTION_CRC_SIZE				( 4 )
+#define TS_SECTION_STUFFING				( 0xFF )
+
+#define TS_SECTION_LENGTH(s)			( ( ( ( uint32_t )(s)[ 1 ] & 0x0F ) << 8 ) | (s)[ 2 ] )
+#define TS_SECTION_SYNTAX(s)			( 0 != ( (s)[ 1 ] & 0x80 ) )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+/**
+* @brief		Called for every complete section
+* @param[in]	context		Context given to ts_section_init()
+* @param[in]	pid			PID
+* @param[in]	section		Section from table_id. Valid only during the call
+* @param[in]	size		Size of the section including the header and CRC_32
+*/
+typedef void	( *TS_SECTION_HANDLER )( void* context, uint16_t pid, const uint8_t* section, uint32_t size );
+
+/**
+* @brief	Reassembly state of one PID
+*/
+typedef struct {
+	uint64_t		Sections;				// Delivered sections
+	uint64_t		CrcErrors;
+	uint64_t		Incomplete;				// Sections lost by a CC error, TEI or a broken pointer_field
+	uint32_t		Length;					// Collected bytes. 0 while waiting for a section start
+	uint32_t		Size;					// Section size. 0 until the header is collected
+	uint8_t			LastCc;
+	bool			HasCc;
+	uint8_t			Data[ TS_SECTION_SIZE_MAX ];
+} TS_SECTION_BUFFER;
+
+typedef struct {
+	TS_SECTION_BUFFER*	Pid[ 8192 ];			// NULL unless the PID is selected
+	TS_SECTION_HANDLER	Handler;
+	void*				Context;
+	uint64_t			Sections;
+	uint64_t			CrcErrors;
+	uint64_t			Incomplete;
+} TS_SECTION_FILTER;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_section_init( TS_SECTION_FILTER* filter, TS_SECTION_HANDLER handler, void* context );
+bool			ts_section_add_pid( TS_SECTION_FILTER* filter, uint16_t pid );
+void			ts_section_packet( TS_SECTION_FILTER* filter, const uint8_t* ts_packet, uint16_t pid, uint16_t flags, uint8_t cc, uint8_t payload_offset );
+void			ts_section_batch( TS_SECTION_FILTER* filter, const TS_PACKET_BATCH* batch );
+void			ts_section_free( TS_SECTION_FILTER* filter );
+bool			ts_section_crc_ok( const uint8_t* section, uint32_t size );
+
+#endif
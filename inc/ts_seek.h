@@ -0,0 +1,37 @@
+/**
+* @file ts_seek.h
+* @brief Time based seek without index
+* @author sage
+* @date 2018/10/30
+*/
+
+#ifndef __TS_SEEK_HEADER__
+#define __TS_SEEK_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts_reader.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_SEEK_RANGE_BYTES
+* @brief	Bisection stops when the search range becomes smaller than this
+*/
+#define TS_SEEK_RANGE_BYTES				( 4 * 1024 * 1024 )
+
+/**
+* @def		TS_SEEK_PROBE_BYTES
+* @brief	Maximum bytes read by one probe
+*/
+#define TS_SEEK_PROBE_BYTES				( 16 * 1024 * 1024 )
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_tot_seek( TS_READER* reader, uint64_t datetime, uint32_t* probe_count );
+bool			ts_tot_find( TS_READER* reader, uint64_t datetime, uint64_t* offset, uint64_t* tot_datetime );
+
+#endif
@@ -0,0 +1,80 @@
+/**
+* @file ts_stats.h
+* @brief Run time counters and phase timers
+* @author sage
+* @date 2019/02/12
+* @details One process wide set of counters, updated at read / seek / batch granularity and never per packet.\n
+*			Every update is skipped by one branch until ts_stats_enable() is called,\n
+*			and the clock is read only when the phase changes.
+*/
+
+#ifndef __TS_STATS_HEADER__
+#define __TS_STATS_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_STATS_ADD
+* @brief	Add to a counter. Safe from the read-ahead and writer threads
+*/
+#define TS_STATS_ADD(field,n)	do{ if( __builtin_expect( TsStats.Enabled, 0 ) ){ __atomic_fetch_add( &TsStats.field, (n), __ATOMIC_RELAXED ); } }while( 0 )
+
+/*------------------------------------------------------------------------------
+ Enum
+------------------------------------------------------------------------------*/
+typedef enum {
+	TS_STATS_PHASE_OPEN = 0,			// Options, input open, index load
+	TS_STATS_PHASE_INDEX,				// TOT / RAP index build
+	TS_STATS_PHASE_SEEK,				// TOT search by bisection and forward scan
+	TS_STATS_PHASE_SCAN,				// Packet loop
+	TS_STATS_PHASE_WRITE,				// Kernel copy, flush and close of outputs
+	TS_STATS_PHASE_MAX,
+} TS_STATS_PHASE;
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	bool			Enabled;
+
+	uint64_t		BytesRead;					// Bytes handed out by ts_reader_next(), mapped or read
+	uint64_t		ReadCalls;					// read() / pread() of the input
+	uint64_t		ReadSyscallBytes;			// Bytes returned by those calls
+	uint64_t		SeekCalls;					// ts_reader_seek()
+	uint64_t		LseekCalls;					// lseek() of the input
+	uint64_t		Resyncs;
+	uint64_t		SkippedBytes;
+
+	uint64_t		TotSearches;				// Searches for a TOT time
+	uint64_t		PacketsBeforeTot;			// Packets parsed by the searches before the TOT that answered them
+	uint64_t		SeekProbes;					// Bisection probes
+	uint64_t		SeekOvershootBytes;			// Bisection landed after the TOT and stepped back
+	uint64_t		SeekUndershootBytes;		// Bytes read forward from the landing point to the TOT
+
+	uint64_t		BytesWritten;				// Output bytes, written or kernel copied
+	uint64_t		WriteCalls;
+
+	TS_STATS_PHASE	Phase;
+	uint64_t		PhaseStart;					// ns
+	uint64_t		StartTime;					// ns
+	uint64_t		PhaseNs[ TS_STATS_PHASE_MAX ];
+} TS_STATS;
+
+/*------------------------------------------------------------------------------
+ Variable
+------------------------------------------------------------------------------*/
+extern	TS_STATS		TsStats;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_stats_enable( void );
+TS_STATS_PHASE	ts_stats_phase( TS_STATS_PHASE phase );
+bool			ts_stats_report( const char* path, const char* tool, const char* input );
+
+#endif
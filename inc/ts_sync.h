@@ -0,0 +1,30 @@
+/**
+* @file ts_sync.h
+* @brief TS sync byte scanner
+* @author sage
+* @date 2018/10/16
+*/
+
+#ifndef __TS_SYNC_HEADER__
+#define __TS_SYNC_HEADER__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_SYNC_WINDOW_PACKETS
+* @brief	Number of consecutive sync bytes required to lock
+*/
+#define TS_SYNC_WINDOW_PACKETS			( 5 )
+
+#define TS_SYNC_NOT_FOUND				( ( size_t )-1 )
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+size_t			ts_sync_find( const uint8_t* buffer, size_t length, uint32_t window );
+
+#endif
@@ -0,0 +1,74 @@
+/**
+* @file ts_timeline.h
+* @brief PCR time line
+* @author sage
+* @date 2018/11/27
+* @details Piecewise linear map between file offset and a continuous 27MHz time.
+*/
+
+#ifndef __TS_TIMELINE_HEADER__
+#define __TS_TIMELINE_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts_packet.h"
+#include "ts_reader.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_TIMELINE_INTERVAL_TICKS
+* @brief	Minimum time between two points ( 100ms )
+*/
+#define TS_TIMELINE_INTERVAL_TICKS		( PCR_CLOCK_EXT / 10 )
+
+/**
+* @def		TS_TIMELINE_JUMP_TICKS
+* @brief	A PCR step larger than this ( 1s ) or backwards starts a new segment
+*/
+#define TS_TIMELINE_JUMP_TICKS			( PCR_CLOCK_EXT )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	uint64_t		Offset;					// File offset of the PCR packet
+	uint64_t		Time;					// Time from the first PCR ( 27MHz ). Never decreases
+} TS_TIMELINE_POINT;
+
+/**
+* @brief	Last PCR of one PID
+*/
+typedef struct {
+	uint64_t		Pcr;
+	uint64_t		Time;
+	uint64_t		Offset;
+	bool			Valid;
+} TS_TIMELINE_PID;
+
+typedef struct {
+	TS_TIMELINE_POINT*	Points;
+	uint64_t			Count;
+	uint64_t			Capacity;
+	uint64_t			EndOffset;				// End of the analyzed data
+	uint64_t			Discontinuities;		// Number of segments - 1
+	uint16_t			MasterPid;				// PCR PID the points come from
+	TS_TIMELINE_POINT	Last;					// Last PCR of MasterPid
+	bool				LastPending;			// Last is not in Points yet
+	TS_TIMELINE_PID		Pid[ 8192 ];
+} TS_TIMELINE;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+void			ts_timeline_init( TS_TIMELINE* timeline );
+bool			ts_timeline_batch( TS_TIMELINE* timeline, const TS_PACKET_BATCH* batch, uint64_t offset );
+bool			ts_timeline_finish( TS_TIMELINE* timeline, uint64_t end_offset );
+bool			ts_timeline_build( const char* ts_file, TS_READER_MODE mode, TS_TIMELINE* timeline );
+void			ts_timeline_free( TS_TIMELINE* timeline );
+uint64_t		ts_timeline_time( const TS_TIMELINE* timeline, uint64_t offset );
+uint64_t		ts_timeline_offset( const TS_TIMELINE* timeline, uint64_t time );
+
+#endif
@@ -0,0 +1,71 @@
+/**
+* @file ts_tot.h
+* @brief TOT ( Time Offset Table ) parser and time index
+* @author sage
+* @date 2018/10/23
+*/
+
+#ifndef __TS_TOT_HEADER__
+#define __TS_TOT_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "ts_reader.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define TS_TOT_INDEX_SUFFIX				".totidx"
+#define TS_TOT_INDEX_MAGIC				"TSTI"
+#define TS_TOT_INDEX_VERSION			( 1 )
+
+#define TS_DATETIME(mjd,sec)			( ( ( uint64_t )(mjd) << 32 ) | ( uint64_t )(sec) )
+#define TS_DATETIME_MJD(dt)				( ( uint16_t )( (dt) >> 32 ) )
+#define TS_DATETIME_SEC(dt)				( ( uint32_t )( (dt) & 0xFFFFFFFF ) )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+/**
+* @brief	One TOT in the TS file
+*/
+typedef struct {
+	uint64_t		Offset;					// File offset of the TOT packet
+	uint64_t		DateTime;				// TS_DATETIME( MJD, second of day )
+} TS_TOT_ENTRY;
+
+/**
+* @brief	Header of the index file. Entries follow it.
+*/
+typedef struct {
+	char			Magic[ 4 ];
+	uint32_t		Version;
+	uint64_t		FileSize;				// Size of the indexed TS file
+	int64_t			FileMtime;				// mtime of the indexed TS file
+	uint64_t		Count;					// Number of entries
+} TS_TOT_INDEX_HEADER;
+
+typedef struct {
+	TS_TOT_INDEX_HEADER	Header;
+	TS_TOT_ENTRY*		Entries;
+	uint64_t			Capacity;
+} TS_TOT_INDEX;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_tot_parse( const uint8_t* ts_packet, uint8_t payload_offset, uint64_t* datetime );
+void			ts_tot_datetime_to_tm( uint64_t datetime, struct tm* tm );
+bool			ts_tot_datetime_parse( const char* str_datetime, uint64_t* datetime );
+
+void			ts_tot_index_path( const char* ts_file, char* index_file, size_t size );
+bool			ts_tot_index_build( const char* ts_file, TS_READER_MODE mode, TS_TOT_INDEX* index );
+bool			ts_tot_index_save( const char* index_file, const TS_TOT_INDEX* index );
+bool			ts_tot_index_load( const char* index_file, const char* ts_file, TS_TOT_INDEX* index );
+void			ts_tot_index_free( TS_TOT_INDEX* index );
+int64_t			ts_tot_index_search( const TS_TOT_INDEX* index, uint64_t datetime );
+
+#endif
@@ -0,0 +1,106 @@
+/**
+* @file ts_trace.h
+* @brief Binary header trace
+* @author sage
+* @date 2018/11/20
+* @details A header trace is a set of files sharing one prefix.\n
+*			prefix.tstrace holds TS_TRACE_HEADER, every other file is one fixed width column\n
+*			which can be memory-mapped and indexed by packet number.
+*/
+
+#ifndef __TS_TRACE_HEADER__
+#define __TS_TRACE_HEADER__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts_packet.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+#define TS_TRACE_MAGIC					"TSTR"
+#define TS_TRACE_VERSION				( 1 )
+#define TS_TRACE_SUFFIX					".tstrace"
+
+/**
+* @def		TS_TRACE_FLAG_CC_ERROR
+* @brief	Added to TS_PKT_FLAG_* in the flags column when the continuity counter is discontinuous
+*/
+#define TS_TRACE_FLAG_CC_ERROR			( 0x0200 )
+
+/*------------------------------------------------------------------------------
+ Enum
+------------------------------------------------------------------------------*/
+typedef enum {
+	TS_TRACE_COLUMN_PID = 0,		// uint16_t per packet
+	TS_TRACE_COLUMN_FLAGS,			// uint16_t per packet. TS_PKT_FLAG_* | TS_TRACE_FLAG_*
+	TS_TRACE_COLUMN_CC,				// uint8_t per packet
+	TS_TRACE_COLUMN_OFFSET,			// uint64_t per packet. File offset
+	TS_TRACE_COLUMN_PCR,			// TS_TRACE_PCR per PCR packet
+	TS_TRACE_COLUMN_TOT,			// TS_TRACE_TOT per TOT packet
+	TS_TRACE_COLUMN_MAX,
+} TS_TRACE_COLUMN;
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	uint64_t		Packet;					// Packet number
+	uint64_t		Pcr;					// PCR ( 27MHz )
+} TS_TRACE_PCR;
+
+typedef struct {
+	uint64_t		Packet;					// Packet number
+	uint64_t		DateTime;				// TS_DATETIME( MJD, second of day )
+} TS_TRACE_TOT;
+
+typedef struct {
+	char			Magic[ 4 ];
+	uint32_t		Version;
+	uint64_t		FileSize;				// Size of the traced TS file. 0 for stdin
+	int64_t			FileMtime;				// mtime of the traced TS file
+	uint64_t		Packets;				// Number of packets
+	uint64_t		PcrCount;				// Number of TS_TRACE_PCR
+	uint64_t		TotCount;				// Number of TS_TRACE_TOT
+} TS_TRACE_HEADER;
+
+/**
+* @brief	Trace writer
+*/
+typedef struct {
+	TS_TRACE_HEADER	Header;
+	char*			Prefix;
+	FILE*			Fp[ TS_TRACE_COLUMN_MAX ];
+	uint8_t			LastCc[ 8192 ];			// 0x80 is set once the PID had a payload packet
+} TS_TRACE_WRITER;
+
+/**
+* @brief	Memory-mapped trace
+*/
+typedef struct {
+	TS_TRACE_HEADER		Header;
+	const uint16_t*		Pid;
+	const uint16_t*		Flags;
+	const uint8_t*		Cc;
+	const uint64_t*		Offset;
+	const TS_TRACE_PCR*	Pcr;
+	const TS_TRACE_TOT*	Tot;
+	void*				Map[ TS_TRACE_COLUMN_MAX ];
+	size_t				MapSize[ TS_TRACE_COLUMN_MAX ];
+} TS_TRACE;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_trace_create( TS_TRACE_WRITER* writer, const char* prefix, const char* ts_file );
+bool			ts_trace_write( TS_TRACE_WRITER* writer, const TS_PACKET_BATCH* batch, uint64_t offset );
+bool			ts_trace_finish( TS_TRACE_WRITER* writer );
+
+bool			ts_trace_open( TS_TRACE* trace, const char* prefix );
+void			ts_trace_close( TS_TRACE* trace );
+uint64_t		ts_trace_tot_search( const TS_TRACE* trace, uint64_t datetime );
+uint64_t		ts_trace_pcr_search( const TS_TRACE* trace, uint64_t packet );
+
+#endif
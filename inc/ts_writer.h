@@ -0,0 +1,57 @@
+/**
+* @file ts_writer.h
+* @brief Block writer of output files
+* @author sage
+* @date 2019/01/29
+* @details Packets are gathered into large aligned blocks. A threaded writer hands full blocks\n
+*			to a writer thread through a TS_RING, so the caller keeps parsing while the block is written.
+*/
+
+#ifndef __TS_WRITER_HEADER__
+#define __TS_WRITER_HEADER__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "ts_ring.h"
+
+/*------------------------------------------------------------------------------
+ Macro
+------------------------------------------------------------------------------*/
+/**
+* @def		TS_WRITER_BLOCK_SIZE
+* @brief	Size of one write. Multiple of the packet size and of TS_RING_ALIGN
+*/
+#define TS_WRITER_BLOCK_SIZE			( 188 * TS_RING_ALIGN )
+
+/**
+* @def		TS_WRITER_BLOCKS
+* @brief	Blocks queued to the writer thread ( 6MB )
+*/
+#define TS_WRITER_BLOCKS				( 8 )
+
+/*------------------------------------------------------------------------------
+ Struct
+------------------------------------------------------------------------------*/
+typedef struct {
+	int				Fd;
+	bool			Threaded;
+	TS_RING			Ring;					// Allocated by the first write
+	TS_RING_BLOCK*	Block;					// Block being filled. NULL if none
+	pthread_t		Thread;
+	bool			Started;
+	bool			Error;					// A write failed
+	uint64_t		Bytes;					// Bytes given to ts_writer_write()
+} TS_WRITER;
+
+/*------------------------------------------------------------------------------
+ Function
+------------------------------------------------------------------------------*/
+bool			ts_writer_open( TS_WRITER* writer, const char* path, bool threaded );
+bool			ts_writer_write( TS_WRITER* writer, const void* data, size_t size );
+bool			ts_writer_flush( TS_WRITER* writer );
+bool			ts_writer_close( TS_WRITER* writer );
+
+#endif
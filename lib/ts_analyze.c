@@ -0,0 +1,401 @@
+/**
+* @file ts_analyze.c
+* @brief Whole file TS analysis
+* @author sage
+* @date 2018/11/13
+* @details The file is divided into packet aligned chunks which are analyzed\n
+*			by a pool of worker threads. Partial results are merged in file order,\n
+*			continuity counter and PCR checks are fixed up at the chunk boundaries.\n
+*			Sections are checked on the SI PIDs and the PMT PIDs found in the PAT.\n
+*			A section cut by a chunk boundary is skipped, not counted as an error.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_section.h"
+#include "ts_psi.h"
+#include "ts_analyze.h"
+
+#define PCR_CYCLE					( ( ( uint64_t )1 << 33 ) * 300 )
+
+typedef struct {
+	const char*			TsFile;
+	TS_READER_MODE		Mode;
+	TS_ANALYSIS**		Chunks;
+	uint32_t			ChunkCount;
+	uint32_t			NextChunk;
+	bool				Error;
+} TS_ANALYZE_POOL;
+
+static inline	bool	ts_pcr_jump( uint64_t last_pcr, uint64_t pcr );
+static	void			ts_analyze_section( void* context, uint16_t pid, const uint8_t* section, uint32_t size );
+static	bool			ts_analyze_range( const char* ts_file, TS_READER_MODE mode, TS_ANALYSIS* analysis );
+static	void*			ts_analyze_worker( void* arg );
+
+/**
+* @brief		PCR step check
+* @param[in]	last_pcr	Previous PCR
+* @param[in]	pcr			This PCR
+* @return		bool		true if PCR went backwards or jumped more than TS_PCR_JUMP_TICKS
+*/
+static inline	bool	ts_pcr_jump( uint64_t last_pcr, uint64_t pcr )
+{
+	return TS_PCR_JUMP_TICKS < ( ( pcr + PCR_CYCLE - last_pcr ) % PCR_CYCLE );
+}
+
+/**
+* @brief		Section handler. Adds the PMT PIDs of the PAT to the filter
+* @param[in]	context		TS_SECTION_FILTER
+* @param[in]	pid			PID
+* @param[in]	section		Section
+* @param[in]	size		Size of the section
+*/
+static	void			ts_analyze_section( void* context, uint16_t pid, const uint8_t* section, uint32_t size )
+{
+	TS_PAT		pat;
+	uint32_t	i;
+
+	if( ( PID_PAT != pid ) || !ts_psi_parse_pat( section, size, &pat ) ){
+		return;
+	}
+	for( i = 0 ; i < pat.Count ; i++ ){
+		ts_section_add_pid( context, pat.Programs[ i ].Pid );
+	}
+}
+
+/**
+* @brief		Initialize analysis
+* @param[out]	analysis	Analysis
+*/
+void			ts_analyze_init( TS_ANALYSIS* analysis )
+{
+	memset( analysis, 0, sizeof( TS_ANALYSIS ) );
+}
+
+/**
+* @brief		Analyze decoded packets
+* @param[in,out]	analysis	Analysis
+* @param[in]	batch		Decoded packets
+* @param[in]	offset		File offset of the first packet in batch
+*/
+void			ts_analyze_batch( TS_ANALYSIS* analysis, const TS_PACKET_BATCH* batch, uint64_t offset )
+{
+	uint32_t		i;
+
+	for( i = 0 ; i < batch->Count ; i++ ){
+		uint16_t		flags = batch->Flags[ i ];
+		TS_PID_STATS*	stats = &analysis->Pid[ batch->Pid[ i ] ];
+
+		stats->Packets++;
+		stats->PayloadBytes += TS_PACKET_SIZE - batch->PayloadOffset[ i ];
+		if( flags & TS_PKT_FLAG_TEI ){
+			stats->TeiErrors++;
+		}
+		if( flags & TS_PKT_FLAG_ADAPTATION ){
+			stats->AdaptationFields++;
+		}
+		switch( TS_PKT_SCRAMBLE( flags ) ){
+			case TS_SCRAMBLE_EVEN:
+				stats->ScrambledEven++;
+				break;
+			case TS_SCRAMBLE_ODD:
+				stats->ScrambledOdd++;
+				break;
+			default:
+				break;
+		}
+		if( PID_NULL == batch->Pid[ i ] ){
+			continue;
+		}
+
+		if( flags & TS_PKT_FLAG_PAYLOAD ){
+			uint8_t		cc = batch->ContinuityCounter[ i ];
+
+			if( stats->Flags & TS_PID_STATS_HAS_CC ){
+				if( !( flags & TS_PKT_FLAG_DISCONTINUITY ) && ts_cc_error( stats->LastCc, cc ) ){
+					stats->CcErrors++;
+				}
+			}else{
+				stats->Flags |= TS_PID_STATS_HAS_CC;
+				stats->FirstCc = cc;
+				if( flags & TS_PKT_FLAG_DISCONTINUITY ){
+					stats->Flags |= TS_PID_STATS_FIRST_CC_DISCONT;
+				}
+			}
+			stats->LastCc = cc;
+		}
+
+		if( flags & TS_PKT_FLAG_PCR ){
+			uint64_t	pcr = batch->Pcr[ i ];
+
+			if( stats->Flags & TS_PID_STATS_HAS_PCR ){
+				if( !( flags & TS_PKT_FLAG_DISCONTINUITY ) && ts_pcr_jump( stats->LastPcr, pcr ) ){
+					stats->PcrDiscontinuities++;
+				}
+			}else{
+				stats->Flags |= TS_PID_STATS_HAS_PCR;
+				stats->FirstPcr = pcr;
+				stats->FirstPcrOffset = offset + ( uint64_t )i * TS_PACKET_SIZE;
+				if( flags & TS_PKT_FLAG_DISCONTINUITY ){
+					stats->Flags |= TS_PID_STATS_FIRST_PCR_DISCONT;
+				}
+			}
+			stats->LastPcr = pcr;
+			stats->LastPcrOffset = offset + ( uint64_t )i * TS_PACKET_SIZE;
+			stats->PcrCount++;
+		}
+	}
+
+	analysis->Packets += batch->Count;
+}
+
+/**
+* @brief		Merge the analysis of the following chunk
+* @param[in,out]	total	Analysis of the preceding data
+* @param[in]	next	Analysis of the chunk just after total
+*/
+void			ts_analyze_merge( TS_ANALYSIS* total, const TS_ANALYSIS* next )
+{
+	uint32_t		pid;
+
+	for( pid = 0 ; pid < TS_PID_MAX ; pid++ ){
+		TS_PID_STATS*		t = &total->Pid[ pid ];
+		const TS_PID_STATS*	n = &next->Pid[ pid ];
+
+		if( 0 == n->Packets ){
+			continue;
+		}
+
+		t->Packets += n->Packets;
+		t->PayloadBytes += n->PayloadBytes;
+		t->TeiErrors += n->TeiErrors;
+		t->ScrambledEven += n->ScrambledEven;
+		t->ScrambledOdd += n->ScrambledOdd;
+		t->AdaptationFields += n->AdaptationFields;
+		t->CcErrors += n->CcErrors;
+		t->PcrCount += n->PcrCount;
+		t->PcrDiscontinuities += n->PcrDiscontinuities;
+		t->CrcErrors += n->CrcErrors;
+
+		if( n->Flags & TS_PID_STATS_HAS_CC ){
+			if( t->Flags & TS_PID_STATS_HAS_CC ){
+				if( !( n->Flags & TS_PID_STATS_FIRST_CC_DISCONT ) && ts_cc_error( t->LastCc, n->FirstCc ) ){
+					t->CcErrors++;
+				}
+			}else{
+				t->FirstCc = n->FirstCc;
+				t->Flags |= n->Flags & ( TS_PID_STATS_HAS_CC | TS_PID_STATS_FIRST_CC_DISCONT );
+			}
+			t->LastCc = n->LastCc;
+		}
+
+		if( n->Flags & TS_PID_STATS_HAS_PCR ){
+			if( t->Flags & TS_PID_STATS_HAS_PCR ){
+				if( !( n->Flags & TS_PID_STATS_FIRST_PCR_DISCONT ) && ts_pcr_jump( t->LastPcr, n->FirstPcr ) ){
+					t->PcrDiscontinuities++;
+				}
+			}else{
+				t->FirstPcr = n->FirstPcr;
+				t->FirstPcrOffset = n->FirstPcrOffset;
+				t->Flags |= n->Flags & ( TS_PID_STATS_HAS_PCR | TS_PID_STATS_FIRST_PCR_DISCONT );
+			}
+			t->LastPcr = n->LastPcr;
+			t->LastPcrOffset = n->LastPcrOffset;
+		}
+	}
+
+	total->Packets += next->Packets;
+	total->SkippedBytes += next->SkippedBytes;
+	total->EndOffset = next->EndOffset;
+}
+
+/**
+* @brief		Analyze packets starting in [ StartOffset, EndOffset )
+* @param[in]	ts_file		TS file path
+* @param[in]	mode		How the file is read. TS_READER_MODE_*
+* @param[in,out]	analysis	StartOffset and EndOffset are set by the caller. EndOffset 0 is the end of file
+* @return		bool		Result
+*/
+static	bool			ts_analyze_range( const char* ts_file, TS_READER_MODE mode, TS_ANALYSIS* analysis )
+{
+	TS_READER			reader;
+	TS_PACKET_BATCH*	batch;
+	TS_SECTION_FILTER*	sections;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	uint32_t			pid;
+	uint64_t			offset;
+	uint64_t			end = analysis->EndOffset;
+
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	sections = malloc( sizeof( TS_SECTION_FILTER ) );
+	if( ( NULL == batch ) || ( NULL == sections ) ){
+		free( batch );
+		free( sections );
+		return false;
+	}
+	if( !ts_reader_open( &reader, ts_file, mode ) ){
+		free( batch );
+		free( sections );
+		return false;
+	}
+	if( 0 == end ){
+		end = UINT64_MAX;
+	}
+	ts_section_init( sections, ts_analyze_section, sections );
+	for( pid = PID_PAT ; pid <= PID_SI_LAST ; pid++ ){
+		ts_section_add_pid( sections, pid );
+	}
+
+	ts_reader_seek( &reader, analysis->StartOffset );
+	while( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ){
+		offset = ts_reader_tell( &reader ) - ( uint64_t )read_count * TS_PACKET_SIZE;
+		if( offset >= end ){
+			break;
+		}
+		if( ( end - offset - 1 ) / TS_PACKET_SIZE + 1 < read_count ){
+			read_count = ( end - offset - 1 ) / TS_PACKET_SIZE + 1;
+		}
+		ts_parse_batch( ts_buffer, read_count, batch );
+		ts_analyze_batch( analysis, batch, offset );
+		ts_section_batch( sections, batch );
+	}
+	analysis->SkippedBytes = reader.SkippedBytes;
+	for( pid = 0 ; pid < TS_PID_MAX ; pid++ ){
+		if( NULL != sections->Pid[ pid ] ){
+			analysis->Pid[ pid ].CrcErrors = sections->Pid[ pid ]->CrcErrors;
+		}
+	}
+
+	ts_section_free( sections );
+	free( sections );
+	ts_reader_close( &reader );
+	free( batch );
+
+	return true;
+}
+
+/**
+* @brief		Worker thread of the analysis pool
+* @param[in]	arg			TS_ANALYZE_POOL
+*/
+static	void*			ts_analyze_worker( void* arg )
+{
+	TS_ANALYZE_POOL*	pool = arg;
+	uint32_t			chunk;
+
+	while( ( chunk = __atomic_fetch_add( &pool->NextChunk, 1, __ATOMIC_RELAXED ) ) < pool->ChunkCount ){
+		if( !ts_analyze_range( pool->TsFile, pool->Mode, pool->Chunks[ chunk ] ) ){
+			__atomic_store_n( &pool->Error, true, __ATOMIC_RELAXED );
+		}
+	}
+
+	return NULL;
+}
+
+/**
+* @brief		Analyze TS file
+* @param[in]	ts_file		TS file path. "-" is stdin
+* @param[in]	mode		How the file is read. TS_READER_MODE_*
+* @param[in]	threads		Number of worker threads. Non-seekable input is always analyzed by the caller thread
+* @param[out]	analysis	Analysis
+* @return		bool		Result
+*/
+bool			ts_analyze_file( const char* ts_file, TS_READER_MODE mode, uint32_t threads, TS_ANALYSIS* analysis )
+{
+	TS_READER			reader;
+	TS_ANALYZE_POOL		pool;
+	pthread_t*			workers = NULL;
+	uint32_t			worker_count = 0;
+	uint32_t			chunk_count;
+	uint32_t			i;
+	const uint8_t*		ts_buffer;
+	bool				result = true;
+
+	ts_analyze_init( analysis );
+
+	if( !ts_reader_open( &reader, ts_file, mode ) ){
+		return false;
+	}
+
+	chunk_count = threads * 4;
+	if( reader.FileSize / TS_ANALYZE_CHUNK_MIN < chunk_count ){
+		chunk_count = reader.FileSize / TS_ANALYZE_CHUNK_MIN;
+	}
+	if( ( 1 >= threads ) || !reader.Seekable || ( 1 >= chunk_count ) ){
+		ts_reader_close( &reader );
+		return ts_analyze_range( ts_file, mode, analysis );
+	}
+
+	memset( &pool, 0, sizeof( pool ) );
+	pool.TsFile = ts_file;
+	pool.Mode = mode;
+	pool.ChunkCount = chunk_count;
+	pool.Chunks = calloc( chunk_count, sizeof( TS_ANALYSIS* ) );
+	workers = calloc( threads, sizeof( pthread_t ) );
+	if( ( NULL == pool.Chunks ) || ( NULL == workers ) ){
+		result = false;
+		goto end;
+	}
+
+	// Chunk boundaries are moved forward to the next packet the reader locks on.
+	for( i = 0 ; i < chunk_count ; i++ ){
+		pool.Chunks[ i ] = malloc( sizeof( TS_ANALYSIS ) );
+		if( NULL == pool.Chunks[ i ] ){
+			result = false;
+			goto end;
+		}
+		ts_analyze_init( pool.Chunks[ i ] );
+		if( 0 == i ){
+			continue;
+		}
+		ts_reader_seek( &reader, reader.FileSize / chunk_count * i );
+		if( 0 < ts_reader_next( &reader, &ts_buffer, 1 ) ){
+			pool.Chunks[ i ]->StartOffset = ts_reader_tell( &reader ) - TS_PACKET_SIZE;
+		}else{
+			pool.Chunks[ i ]->StartOffset = reader.FileSize;
+		}
+		pool.Chunks[ i - 1 ]->EndOffset = pool.Chunks[ i ]->StartOffset;
+	}
+	pool.Chunks[ chunk_count - 1 ]->EndOffset = reader.FileSize;
+
+	for( worker_count = 0 ; worker_count < threads ; worker_count++ ){
+		if( 0 != pthread_create( &workers[ worker_count ], NULL, ts_analyze_worker, &pool ) ){
+			break;
+		}
+	}
+	if( 0 == worker_count ){
+		ts_analyze_worker( &pool );
+	}
+	for( i = 0 ; i < worker_count ; i++ ){
+		pthread_join( workers[ i ], NULL );
+	}
+	result = !pool.Error;
+
+	if( result ){
+		memcpy( analysis, pool.Chunks[ 0 ], sizeof( TS_ANALYSIS ) );
+		for( i = 1 ; i < chunk_count ; i++ ){
+			ts_analyze_merge( analysis, pool.Chunks[ i ] );
+		}
+	}
+
+end:
+	if( NULL != pool.Chunks ){
+		for( i = 0 ; i < chunk_count ; i++ ){
+			free( pool.Chunks[ i ] );
+		}
+	}
+	free( pool.Chunks );
+	free( workers );
+	ts_reader_close( &reader );
+
+	return result;
+}
@@ -0,0 +1,107 @@
+/**
+* @file ts_bitrate.c
+* @brief TS bitrate calculation
+* @author sage
+* @date 2018/10/02
+* @details Shared by ts_base and ts_tot_spliter.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_bitrate.h"
+#include "ts_reader.h"
+
+/**
+* @brief		Calculate bit rate of TS file
+* @param[in]	ts_file			TS file path
+* @param[in]	mode			How the file is read. TS_READER_MODE_*
+* @param[in]	use_pcr_count	Sampling PCR count
+* @return		double			bitrate. if error return 0.0
+* @details		The first PID carrying a PCR is used.\n
+*				When the PCR goes backwards the measurement restarts from that PCR.
+*/
+double			ts_calc_bitrate( const char* ts_file, TS_READER_MODE mode, const uint32_t use_pcr_count )
+{
+	TS_READER			reader;
+	
+	const uint8_t*		ts_buffer = NULL;
+	TS_PACKET_BATCH*	batch = NULL;
+	
+	uint64_t	total_packet = 0;
+	
+	uint64_t	start_pcr = PCR_NONE;
+	uint64_t	end_pcr = PCR_NONE;
+	uint32_t	pcr_count = 0;
+	double		bitrate = 0.0;
+	uint16_t	pcr_pid = PID_NULL;
+	
+	bool		done = false;
+	uint32_t	read_count;
+	uint32_t	i;
+	
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( NULL == batch ){
+		return 0.0;
+	}
+	
+	if( ts_reader_open( &reader, ts_file, mode ) ){
+		while( !done && ( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+			ts_parse_batch( ts_buffer, read_count, batch );
+			
+			for( i = 0 ; i < batch->Count ; i++ ){
+				if( 0 < pcr_count ){
+					total_packet++;
+				}
+				
+				if( !( batch->Flags[ i ] & TS_PKT_FLAG_PCR ) ){
+					continue;
+				}
+				if( PID_NULL == pcr_pid ){
+					pcr_pid = batch->Pid[ i ];
+				}
+				if( pcr_pid != batch->Pid[ i ] ){
+					continue;
+				}
+				
+				if( 0 == pcr_count ){
+					start_pcr = batch->Pcr[ i ];
+					total_packet = 0;
+					pcr_count++;
+				}else{
+					if( start_pcr > batch->Pcr[ i ] ){
+						// PCR reset, measure again from here.
+						start_pcr = batch->Pcr[ i ];
+						end_pcr = PCR_NONE;
+						total_packet = 0;
+						pcr_count = 1;
+						continue;
+					}
+					end_pcr = batch->Pcr[ i ];
+					pcr_count++;
+					
+					if( use_pcr_count < pcr_count ){
+						done = true;
+						break;
+					}
+				}
+			}
+		}
+		ts_reader_close( &reader );
+		
+		if(    ( PCR_NONE != start_pcr )
+			&& ( PCR_NONE != end_pcr )
+			&& ( start_pcr < end_pcr ) ){
+			bitrate = ( total_packet * TS_PACKET_SIZE * 8 ) / ( ( end_pcr - start_pcr ) / ( double )PCR_CLOCK_EXT );
+		}
+	}
+	
+	free( batch );
+	
+	return bitrate;
+}
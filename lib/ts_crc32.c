@@ -0,0 +1,73 @@
+/**
+* @file ts_crc32.c
+* @brief MPEG-2 CRC32
+* @author sage
+* @date 2018/12/18
+* @details Slice-by-8. Table k holds the CRC of one byte followed by k zero bytes,\n
+*			so 8 input bytes are folded by 8 independent table lookups.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "ts_crc32.h"
+
+static	uint32_t		CrcTable[ 8 ][ 256 ];
+static	pthread_once_t	CrcTableOnce = PTHREAD_ONCE_INIT;
+
+static	void			ts_crc32_table_init( void );
+
+/**
+* @brief		Make slice-by-8 tables
+*/
+static	void			ts_crc32_table_init( void )
+{
+	uint32_t	i, k;
+	uint32_t	crc;
+
+	for( i = 0 ; i < 256 ; i++ ){
+		crc = i << 24;
+		for( k = 0 ; k < 8 ; k++ ){
+			crc = ( crc & 0x80000000 ) ? ( ( crc << 1 ) ^ TS_CRC32_POLY ) : ( crc << 1 );
+		}
+		CrcTable[ 0 ][ i ] = crc;
+	}
+	for( i = 0 ; i < 256 ; i++ ){
+		for( k = 1 ; k < 8 ; k++ ){
+			crc = CrcTable[ k - 1 ][ i ];
+			CrcTable[ k ][ i ] = ( crc << 8 ) ^ CrcTable[ 0 ][ crc >> 24 ];
+		}
+	}
+}
+
+/**
+* @brief		Calculate CRC32
+* @param[in]	data		Data
+* @param[in]	size		Size of data
+* @param[in]	crc			TS_CRC32_INIT, or the result of the preceding data
+* @return		uint32_t	CRC
+*/
+uint32_t		ts_crc32( const uint8_t* data, size_t size, uint32_t crc )
+{
+	uint32_t	word;
+
+	pthread_once( &CrcTableOnce, ts_crc32_table_init );
+
+	for( ; size >= 8 ; size -= 8, data += 8 ){
+		word  = crc ^ (   ( ( uint32_t )data[ 0 ] << 24 ) | ( ( uint32_t )data[ 1 ] << 16 )
+						| ( ( uint32_t )data[ 2 ] <<  8 ) |   ( uint32_t )data[ 3 ] );
+		crc   = CrcTable[ 7 ][ word >> 24 ] ^ CrcTable[ 6 ][ ( word >> 16 ) & 0xFF ];
+		crc  ^= CrcTable[ 5 ][ ( word >> 8 ) & 0xFF ] ^ CrcTable[ 4 ][ word & 0xFF ];
+		crc  ^= CrcTable[ 3 ][ data[ 4 ] ] ^ CrcTable[ 2 ][ data[ 5 ] ];
+		crc  ^= CrcTable[ 1 ][ data[ 6 ] ] ^ CrcTable[ 0 ][ data[ 7 ] ];
+	}
+	for( ; size > 0 ; size--, data++ ){
+		crc = ( crc << 8 ) ^ CrcTable[ 0 ][ ( crc >> 24 ) ^ *data ];
+	}
+
+	return crc;
+}
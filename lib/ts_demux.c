@@ -0,0 +1,356 @@
+/**
+* @file ts_demux.c
+* @brief Push demux for embedding
+* @author sage
+* @date 2019/02/19
+* @details Pushed bytes are walked in place while the demux is locked on the packet alignment.\n
+*			Runs of sync aligned packets are decoded by ts_parse_batch() and each packet goes to\n
+*			the handler found by one table lookup on its PID. Sections are reassembled by\n
+*			TS_SECTION_FILTER and routed by table_id.\n
+*			Re-locking follows TS_READER: TS_SYNC_WINDOW_PACKETS aligned sync bytes are required.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_section.h"
+#include "ts_sync.h"
+#include "ts_demux.h"
+
+static	uint32_t		ts_demux_count( const uint8_t* data, size_t size );
+static	void			ts_demux_dispatch( TS_DEMUX* demux, const uint8_t* packets, uint32_t count, uint64_t offset );
+static	void			ts_demux_section( void* context, uint16_t pid, const uint8_t* section, uint32_t size );
+static	void			ts_demux_relock( TS_DEMUX* demux, uint32_t window );
+static	size_t			ts_demux_carry( TS_DEMUX* demux, const uint8_t* data, size_t size );
+
+/**
+* @brief		Allocate and initialize demux
+* @return		TS_DEMUX*	Demux. NULL if out of memory. Free with ts_demux_destroy()
+*/
+TS_DEMUX*		ts_demux_create( void )
+{
+	TS_DEMUX*	demux = malloc( sizeof( TS_DEMUX ) );
+
+	if( NULL != demux ){
+		ts_demux_init( demux );
+	}
+
+	return demux;
+}
+
+/**
+* @brief		Free demux made by ts_demux_create()
+* @param[in]	demux		Demux. May be NULL
+*/
+void			ts_demux_destroy( TS_DEMUX* demux )
+{
+	if( NULL != demux ){
+		ts_demux_free( demux );
+		free( demux );
+	}
+}
+
+/**
+* @brief		Initialize demux. No PID is registered
+* @param[out]	demux		Demux
+*/
+void			ts_demux_init( TS_DEMUX* demux )
+{
+	memset( demux, 0, sizeof( TS_DEMUX ) );
+}
+
+/**
+* @brief		Free the section filter of demux
+* @param[in]	demux		Demux
+*/
+void			ts_demux_free( TS_DEMUX* demux )
+{
+	if( NULL != demux->Sections ){
+		ts_section_free( demux->Sections );
+		free( demux->Sections );
+		demux->Sections = NULL;
+	}
+}
+
+/**
+* @brief		Register packet handler of PID
+* @param[in]	demux		Demux
+* @param[in]	pid			PID
+* @param[in]	handler		Called for every packet of pid. NULL unregisters
+* @param[in]	context		Passed to handler
+* @return		bool		false if TS_DEMUX_HANDLERS_MAX distinct pairs are already registered
+* @details		May be called from a handler, for example to follow a PMT.
+*/
+bool			ts_demux_set_pid( TS_DEMUX* demux, uint16_t pid, TS_DEMUX_PACKET_HANDLER handler, void* context )
+{
+	uint32_t	i;
+
+	pid &= PID_NULL;
+	if( NULL == handler ){
+		demux->Dispatch[ pid ] = 0;
+		return true;
+	}
+
+	for( i = 0 ; i < demux->HandlerCount ; i++ ){
+		if( ( handler == demux->Handlers[ i ].Handler ) && ( context == demux->Handlers[ i ].Context ) ){
+			break;
+		}
+	}
+	if( i == demux->HandlerCount ){
+		if( TS_DEMUX_HANDLERS_MAX == demux->HandlerCount ){
+			return false;
+		}
+		demux->Handlers[ i ].Handler = handler;
+		demux->Handlers[ i ].Context = context;
+		demux->HandlerCount++;
+	}
+	demux->Dispatch[ pid ] = i + 1;
+
+	return true;
+}
+
+/**
+* @brief		Register section handler of table_id and reassemble the sections of PID
+* @param[in]	demux		Demux
+* @param[in]	pid			PID carrying the table
+* @param[in]	table_id	table_id, or TS_DEMUX_TABLE_ANY for the sections without their own handler
+* @param[in]	handler		Called for every section with a correct CRC_32. NULL unregisters the table_id
+* @param[in]	context		Passed to handler
+* @return		bool		Result
+* @details		The handler of a table_id is shared by every PID. A PID keeps being reassembled once added.
+*/
+bool			ts_demux_set_table( TS_DEMUX* demux, uint16_t pid, uint32_t table_id, TS_SECTION_HANDLER handler, void* context )
+{
+	if( TS_DEMUX_TABLE_ANY < table_id ){
+		return false;
+	}
+	if( NULL == demux->Sections ){
+		demux->Sections = malloc( sizeof( TS_SECTION_FILTER ) );
+		if( NULL == demux->Sections ){
+			return false;
+		}
+		ts_section_init( demux->Sections, ts_demux_section, demux );
+	}
+	if( ( NULL != handler ) && !ts_section_add_pid( demux->Sections, pid ) ){
+		return false;
+	}
+	demux->Tables[ table_id ].Handler = handler;
+	demux->Tables[ table_id ].Context = context;
+
+	return true;
+}
+
+/**
+* @brief		Route a complete section by table_id
+* @param[in]	context		TS_DEMUX
+*/
+static	void			ts_demux_section( void* context, uint16_t pid, const uint8_t* section, uint32_t size )
+{
+	TS_DEMUX*		demux = context;
+	TS_DEMUX_TABLE*	table = &demux->Tables[ section[ 0 ] ];
+
+	if( NULL == table->Handler ){
+		table = &demux->Tables[ TS_DEMUX_TABLE_ANY ];
+	}
+	if( NULL != table->Handler ){
+		table->Handler( table->Context, pid, section, size );
+	}
+}
+
+/**
+* @brief		Count leading packets starting with the sync byte
+* @return		uint32_t	Packets. At most TS_BATCH_PACKETS
+*/
+static	uint32_t		ts_demux_count( const uint8_t* data, size_t size )
+{
+	size_t		avail = size / TS_PACKET_SIZE;
+	uint32_t	count;
+
+	if( avail > TS_BATCH_PACKETS ){
+		avail = TS_BATCH_PACKETS;
+	}
+	for( count = 0 ; count < avail ; count++ ){
+		if( TS_SYNC_BYTE != data[ count * TS_PACKET_SIZE ] ){
+			break;
+		}
+	}
+
+	return count;
+}
+
+/**
+* @brief		Decode packets and call the handlers
+* @param[in]	demux		Demux
+* @param[in]	packets		Sync aligned packets
+* @param[in]	count		Number of packets. At most TS_BATCH_PACKETS
+* @param[in]	offset		Stream offset of the first packet
+* @details		Sections and packet handlers are called packet by packet,\n
+*				so a PID registered by a handler receives the rest of the batch.
+*/
+static	void			ts_demux_dispatch( TS_DEMUX* demux, const uint8_t* packets, uint32_t count, uint64_t offset )
+{
+	TS_PACKET_BATCH*	batch = &demux->Batch;
+	TS_DEMUX_PACKET		view;
+	TS_DEMUX_HANDLER*	handler;
+	uint32_t			i;
+	uint16_t			pid;
+
+	ts_parse_batch( packets, count, batch );
+	for( i = 0 ; i < count ; i++ ){
+		pid = batch->Pid[ i ];
+		if( ( NULL != demux->Sections ) && ( NULL != demux->Sections->Pid[ pid ] ) ){
+			ts_section_packet( demux->Sections, &packets[ i * TS_PACKET_SIZE ], pid, batch->Flags[ i ], batch->ContinuityCounter[ i ], batch->PayloadOffset[ i ] );
+		}
+		if( 0 == demux->Dispatch[ pid ] ){
+			continue;
+		}
+
+		view.Packet = &packets[ i * TS_PACKET_SIZE ];
+		view.Offset = offset + ( uint64_t )i * TS_PACKET_SIZE;
+		view.Pid = pid;
+		view.Flags = batch->Flags[ i ];
+		view.ContinuityCounter = batch->ContinuityCounter[ i ];
+		view.Pcr = batch->Pcr[ i ];
+		if( TS_PACKET_SIZE > batch->PayloadOffset[ i ] ){
+			view.Payload = &view.Packet[ batch->PayloadOffset[ i ] ];
+			view.PayloadSize = TS_PACKET_SIZE - batch->PayloadOffset[ i ];
+		}else{
+			view.Payload = NULL;
+			view.PayloadSize = 0;
+		}
+		handler = &demux->Handlers[ demux->Dispatch[ pid ] - 1 ];
+		handler->Handler( handler->Context, &view );
+	}
+	demux->Packets += count;
+}
+
+/**
+* @brief		Lock on the carried bytes and hand over their whole packets
+* @param[in]	demux		Demux
+* @param[in]	window		Aligned sync bytes required to lock
+* @details		Bytes which can not start a window any more are dropped and counted in SkippedBytes.\n
+*				On return the carry is either a partial packet while locked, or less than a window while not.
+*/
+static	void			ts_demux_relock( TS_DEMUX* demux, uint32_t window )
+{
+	size_t		offset;
+	uint32_t	count;
+
+	for( ;; ){
+		if( !demux->Locked ){
+			if( demux->CarryLength < window * TS_PACKET_SIZE ){
+				return;
+			}
+			offset = ts_sync_find( demux->Carry, demux->CarryLength, window );
+			if( TS_SYNC_NOT_FOUND == offset ){
+				offset = demux->CarryLength - ( window - 1 ) * TS_PACKET_SIZE;
+			}else{
+				demux->Locked = true;
+			}
+			demux->SkippedBytes += offset;
+			demux->CarryLength -= offset;
+			memmove( demux->Carry, &demux->Carry[ offset ], demux->CarryLength );
+			if( !demux->Locked ){
+				return;
+			}
+		}
+
+		count = ts_demux_count( demux->Carry, demux->CarryLength );
+		if( 0 < count ){
+			ts_demux_dispatch( demux, demux->Carry, count, demux->Position - demux->CarryLength );
+			demux->CarryLength -= count * TS_PACKET_SIZE;
+			memmove( demux->Carry, &demux->Carry[ count * TS_PACKET_SIZE ], demux->CarryLength );
+		}
+		if( TS_PACKET_SIZE > demux->CarryLength ){
+			return;
+		}
+		// A whole packet without the sync byte.
+		demux->Locked = false;
+		demux->Resyncs++;
+	}
+}
+
+/**
+* @brief		Take bytes into the carry
+* @param[in]	demux		Demux
+* @param[in]	data		Pushed bytes
+* @param[in]	size		Number of bytes
+* @return		size_t		Bytes taken
+* @details		While locked only the rest of the partial packet is taken.
+*/
+static	size_t			ts_demux_carry( TS_DEMUX* demux, const uint8_t* data, size_t size )
+{
+	size_t		copy;
+
+	if( demux->Locked ){
+		copy = TS_PACKET_SIZE - demux->CarryLength;
+	}else{
+		copy = TS_DEMUX_CARRY_SIZE - demux->CarryLength;
+	}
+	if( copy > size ){
+		copy = size;
+	}
+	memcpy( &demux->Carry[ demux->CarryLength ], data, copy );
+	demux->CarryLength += copy;
+	demux->Position += copy;
+
+	if( !demux->Locked || ( TS_PACKET_SIZE == demux->CarryLength ) ){
+		ts_demux_relock( demux, TS_SYNC_WINDOW_PACKETS );
+	}
+
+	return copy;
+}
+
+/**
+* @brief		Push stream bytes
+* @param[in]	demux		Demux
+* @param[in]	data		Bytes following the previous push. Any size
+* @param[in]	size		Number of bytes
+* @details		Handlers are called before this returns. They must not push to the same demux.
+*/
+void			ts_demux_push( TS_DEMUX* demux, const uint8_t* data, size_t size )
+{
+	size_t		used;
+	uint32_t	count;
+
+	while( 0 < size ){
+		if( !demux->Locked || ( 0 < demux->CarryLength ) ){
+			used = ts_demux_carry( demux, data, size );
+		}else if( 0 < ( count = ts_demux_count( data, size ) ) ){
+			ts_demux_dispatch( demux, data, count, demux->Position );
+			used = ( size_t )count * TS_PACKET_SIZE;
+			demux->Position += used;
+		}else if( TS_PACKET_SIZE <= size ){
+			demux->Locked = false;
+			demux->Resyncs++;
+			used = 0;
+		}else{
+			used = ts_demux_carry( demux, data, size );
+		}
+		data += used;
+		size -= used;
+	}
+}
+
+/**
+* @brief		End of stream
+* @param[in]	demux		Demux
+* @details		Packets waiting for a full sync window are handed over with the window shrunk\n
+*				to the carried packets, like the end of file in TS_READER. A trailing partial packet is dropped.
+*/
+void			ts_demux_finish( TS_DEMUX* demux )
+{
+	uint32_t	window = demux->CarryLength / TS_PACKET_SIZE;
+
+	if( !demux->Locked && ( 0 < window ) ){
+		ts_demux_relock( demux, ( TS_SYNC_WINDOW_PACKETS < window ) ? TS_SYNC_WINDOW_PACKETS : window );
+	}
+	demux->SkippedBytes += demux->CarryLength;
+	demux->CarryLength = 0;
+	demux->Locked = false;
+}
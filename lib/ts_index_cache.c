@@ -0,0 +1,262 @@
+/**
+* @file ts_index_cache.c
+* @brief LRU cache of per-recording indexes
+* @author sage
+* @date 2019/02/26
+* @details Indexes are loaded from the index files next to the recording, or built and saved\n
+*			like ts_tot_spliter -I / -g. Loading runs outside the lock; other threads asking\n
+*			for the same recording wait for it instead of scanning the file again.\n
+*			The indexes of an entry are read only while it is acquired.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include "ts_tot.h"
+#include "ts_rap.h"
+#include "ts_index_cache.h"
+
+static	void					ts_index_cache_clear( TS_INDEX_CACHE_ENTRY* entry );
+static	TS_INDEX_CACHE_ENTRY*	ts_index_cache_find( TS_INDEX_CACHE* cache, const char* ts_file, const struct stat* st );
+static	TS_INDEX_CACHE_ENTRY*	ts_index_cache_slot( TS_INDEX_CACHE* cache );
+static	bool					ts_index_cache_load( TS_INDEX_CACHE_ENTRY* entry, TS_READER_MODE mode, bool tot, bool rap );
+
+/**
+* @brief		Initialize cache
+* @param[out]	cache		Cache
+* @param[in]	capacity	Number of recordings kept
+* @return		bool		Result
+*/
+bool			ts_index_cache_init( TS_INDEX_CACHE* cache, uint32_t capacity )
+{
+	memset( cache, 0, sizeof( TS_INDEX_CACHE ) );
+	cache->Entries = calloc( capacity, sizeof( TS_INDEX_CACHE_ENTRY ) );
+	if( NULL == cache->Entries ){
+		return false;
+	}
+	cache->Capacity = capacity;
+	pthread_mutex_init( &cache->Lock, NULL );
+	pthread_cond_init( &cache->Built, NULL );
+
+	return true;
+}
+
+/**
+* @brief		Free indexes of entry and empty it
+*/
+static	void			ts_index_cache_clear( TS_INDEX_CACHE_ENTRY* entry )
+{
+	if( NULL != entry->Path ){
+		ts_tot_index_free( &entry->Tot );
+		if( entry->HasRap ){
+			ts_rap_index_free( &entry->Rap );
+		}
+		free( entry->Path );
+	}
+	memset( entry, 0, sizeof( TS_INDEX_CACHE_ENTRY ) );
+}
+
+/**
+* @brief		Find entry of the recording. Called with the lock held
+*/
+static	TS_INDEX_CACHE_ENTRY*	ts_index_cache_find( TS_INDEX_CACHE* cache, const char* ts_file, const struct stat* st )
+{
+	TS_INDEX_CACHE_ENTRY*	entry;
+	uint32_t				i;
+
+	for( i = 0 ; i < cache->Capacity ; i++ ){
+		entry = &cache->Entries[ i ];
+		if(    ( NULL != entry->Path )
+			&& ( ( uint64_t )st->st_size == entry->FileSize )
+			&& ( st->st_mtime == entry->FileMtime )
+			&& ( 0 == strcmp( ts_file, entry->Path ) ) ){
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+* @brief		Empty slot, or the least recently used one not in use. Called with the lock held
+* @return		TS_INDEX_CACHE_ENTRY*	Emptied slot. NULL if every slot is in use
+*/
+static	TS_INDEX_CACHE_ENTRY*	ts_index_cache_slot( TS_INDEX_CACHE* cache )
+{
+	TS_INDEX_CACHE_ENTRY*	entry;
+	TS_INDEX_CACHE_ENTRY*	victim = NULL;
+	uint32_t				i;
+
+	for( i = 0 ; i < cache->Capacity ; i++ ){
+		entry = &cache->Entries[ i ];
+		if( entry->Building || ( 0 < entry->Users ) ){
+			continue;
+		}
+		if( NULL == entry->Path ){
+			return entry;
+		}
+		if( ( NULL == victim ) || ( entry->LastUsed < victim->LastUsed ) ){
+			victim = entry;
+		}
+	}
+	if( NULL != victim ){
+		ts_index_cache_clear( victim );
+	}
+
+	return victim;
+}
+
+/**
+* @brief		Load the index files of the recording, or build and save them
+* @param[in]	entry		Entry. Path is set
+* @param[in]	mode		How the recording is read to build a missing index
+* @param[in]	tot			Load the TOT index
+* @param[in]	rap			Load the random access point index
+* @return		bool		Result
+* @details		An index which can not be saved is still used.
+*/
+static	bool			ts_index_cache_load( TS_INDEX_CACHE_ENTRY* entry, TS_READER_MODE mode, bool tot, bool rap )
+{
+	char		index_file[ 4096 ];
+
+	if( tot ){
+		ts_tot_index_path( entry->Path, index_file, sizeof( index_file ) );
+		if( !ts_tot_index_load( index_file, entry->Path, &entry->Tot ) ){
+			if( !ts_tot_index_build( entry->Path, mode, &entry->Tot ) ){
+				return false;
+			}
+			ts_tot_index_save( index_file, &entry->Tot );
+		}
+	}
+	if( rap ){
+		ts_rap_index_path( entry->Path, index_file, sizeof( index_file ) );
+		if( !ts_rap_index_load( index_file, entry->Path, &entry->Rap ) ){
+			if( !ts_rap_index_build( entry->Path, mode, &entry->Rap ) ){
+				return false;
+			}
+			ts_rap_index_save( index_file, &entry->Rap );
+		}
+		entry->HasRap = true;
+	}
+
+	return true;
+}
+
+/**
+* @brief		Get the indexes of a recording
+* @param[in]	cache		Cache
+* @param[in]	ts_file		TS file path
+* @param[in]	mode		How the recording is read to build a missing index
+* @param[in]	rap			The random access point index is needed too
+* @return		TS_INDEX_CACHE_ENTRY*	Entry. NULL if the file or its index can not be read. Release with ts_index_cache_release()
+* @details		When every slot is in use the indexes are loaded into a private entry.
+*/
+TS_INDEX_CACHE_ENTRY*	ts_index_cache_acquire( TS_INDEX_CACHE* cache, const char* ts_file, TS_READER_MODE mode, bool rap )
+{
+	TS_INDEX_CACHE_ENTRY*	entry;
+	struct stat				st;
+	bool					load_tot = false;
+	bool					result;
+
+	if( 0 != stat( ts_file, &st ) ){
+		return NULL;
+	}
+
+	pthread_mutex_lock( &cache->Lock );
+	while( ( NULL != ( entry = ts_index_cache_find( cache, ts_file, &st ) ) ) && entry->Building ){
+		pthread_cond_wait( &cache->Built, &cache->Lock );
+	}
+	if( NULL != entry ){
+		entry->Users++;
+		entry->LastUsed = ++cache->Tick;
+		if( !rap || entry->HasRap ){
+			cache->Hits++;
+			pthread_mutex_unlock( &cache->Lock );
+			return entry;
+		}
+	}else{
+		cache->Misses++;
+		entry = ts_index_cache_slot( cache );
+		if( NULL == entry ){
+			entry = calloc( 1, sizeof( TS_INDEX_CACHE_ENTRY ) );
+			if( NULL != entry ){
+				entry->Private = true;
+			}
+		}
+		if( ( NULL == entry ) || ( NULL == ( entry->Path = strdup( ts_file ) ) ) ){
+			if( ( NULL != entry ) && entry->Private ){
+				free( entry );
+			}
+			pthread_mutex_unlock( &cache->Lock );
+			return NULL;
+		}
+		entry->FileSize = st.st_size;
+		entry->FileMtime = st.st_mtime;
+		entry->Users = 1;
+		entry->LastUsed = ++cache->Tick;
+		load_tot = true;
+	}
+	entry->Building = true;
+	pthread_mutex_unlock( &cache->Lock );
+
+	result = ts_index_cache_load( entry, mode, load_tot, rap );
+
+	pthread_mutex_lock( &cache->Lock );
+	entry->Building = false;
+	if( !result ){
+		entry->Users--;
+		if( load_tot && ( 0 == entry->Users ) ){
+			// Waiting threads find no entry and try by themselves.
+			bool	private_entry = entry->Private;
+
+			ts_index_cache_clear( entry );
+			if( private_entry ){
+				free( entry );
+			}
+		}
+		entry = NULL;
+	}
+	pthread_cond_broadcast( &cache->Built );
+	pthread_mutex_unlock( &cache->Lock );
+
+	return entry;
+}
+
+/**
+* @brief		Release entry given by ts_index_cache_acquire()
+* @param[in]	cache		Cache
+* @param[in]	entry		Entry
+*/
+void			ts_index_cache_release( TS_INDEX_CACHE* cache, TS_INDEX_CACHE_ENTRY* entry )
+{
+	pthread_mutex_lock( &cache->Lock );
+	entry->Users--;
+	if( entry->Private && ( 0 == entry->Users ) ){
+		ts_index_cache_clear( entry );
+		free( entry );
+	}
+	pthread_mutex_unlock( &cache->Lock );
+}
+
+/**
+* @brief		Free cache. No entry may be in use
+* @param[in]	cache		Cache
+*/
+void			ts_index_cache_free( TS_INDEX_CACHE* cache )
+{
+	uint32_t	i;
+
+	for( i = 0 ; i < cache->Capacity ; i++ ){
+		ts_index_cache_clear( &cache->Entries[ i ] );
+	}
+	free( cache->Entries );
+	cache->Entries = NULL;
+	pthread_mutex_destroy( &cache->Lock );
+	pthread_cond_destroy( &cache->Built );
+}
@@ -0,0 +1,152 @@
+/**
+* @file ts_index_file.c
+* @brief Index files kept next to a TS file
+* @author sage
+* @date 2019/03/04
+* @details Used by the TOT index and the random access point index, which only differ\n
+*			in the header after TS_INDEX_FILE_HEADER and in the entry type.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "ts_index_file.h"
+
+/**
+* @brief		Fill the common header of a new index
+* @param[out]	header		Index header. Starts with TS_INDEX_FILE_HEADER
+* @param[in]	magic		4 byte magic
+* @param[in]	version		Format version
+* @param[in]	ts_file		Indexed TS file path
+* @return		bool		false if the TS file can not be stat()ed
+*/
+bool			ts_index_file_stamp( void* header, const char* magic, uint32_t version, const char* ts_file )
+{
+	TS_INDEX_FILE_HEADER*	head = header;
+	struct stat				st;
+
+	memcpy( head->Magic, magic, sizeof( head->Magic ) );
+	head->Version = version;
+	if( 0 != stat( ts_file, &st ) ){
+		return false;
+	}
+	head->FileSize = st.st_size;
+	head->FileMtime = st.st_mtime;
+
+	return true;
+}
+
+/**
+* @brief		Append one entry
+* @param[in,out]	entries		Entries. Grown by realloc()
+* @param[in,out]	count		Number of entries
+* @param[in,out]	capacity	Allocated entries
+* @param[in]	entry_size	Size of one entry
+* @return		void*		The new entry, counted. NULL if memory is short
+*/
+void*			ts_index_file_append( void** entries, uint64_t* count, uint64_t* capacity, size_t entry_size )
+{
+	if( *count == *capacity ){
+		uint64_t	grown = ( 0 == *capacity ) ? 1024 : *capacity * 2;
+		void*		data = realloc( *entries, grown * entry_size );
+
+		if( NULL == data ){
+			return NULL;
+		}
+		*entries = data;
+		*capacity = grown;
+	}
+
+	return ( uint8_t* )*entries + ( *count )++ * entry_size;
+}
+
+/**
+* @brief		Save index file
+* @param[in]	index_file	Index file path
+* @param[in]	header		Index header
+* @param[in]	header_size	Size of the header
+* @param[in]	entries		Entries
+* @param[in]	entry_size	Size of one entry
+* @param[in]	count		Number of entries
+* @return		bool		Result
+*/
+bool			ts_index_file_save( const char* index_file, const void* header, size_t header_size, const void* entries, size_t entry_size, uint64_t count )
+{
+	FILE*		fp;
+	bool		result = true;
+
+	fp = fopen( index_file, "wb" );
+	if( NULL == fp ){
+		return false;
+	}
+
+	if( 1 != fwrite( header, header_size, 1, fp ) ){
+		result = false;
+	}
+	if( result && ( 0 < count ) ){
+		if( count != fwrite( entries, entry_size, count, fp ) ){
+			result = false;
+		}
+	}
+	if( 0 != fclose( fp ) ){
+		result = false;
+	}
+
+	return result;
+}
+
+/**
+* @brief		Load index file
+* @param[in]	index_file	Index file path
+* @param[in]	ts_file		TS file path. The index is rejected if the TS file was changed after indexing
+* @param[in]	magic		4 byte magic
+* @param[in]	version		Format version
+* @param[out]	header		Index header. Starts with TS_INDEX_FILE_HEADER
+* @param[in]	header_size	Size of the header
+* @param[in]	count		Number of entries, inside header
+* @param[out]	entries		Entries, count of them. NULL if there is none. Freed by the caller, also on failure
+* @param[in]	entry_size	Size of one entry
+* @return		bool		false if there is no valid index
+*/
+bool			ts_index_file_load( const char* index_file, const char* ts_file, const char* magic, uint32_t version,
+									void* header, size_t header_size, const uint64_t* count, void** entries, size_t entry_size )
+{
+	const TS_INDEX_FILE_HEADER*	head = header;
+	FILE*						fp;
+	struct stat					st;
+	bool						result = false;
+
+	*entries = NULL;
+	if( 0 != stat( ts_file, &st ) ){
+		return false;
+	}
+
+	fp = fopen( index_file, "rb" );
+	if( NULL == fp ){
+		return false;
+	}
+
+	if(    ( 1 == fread( header, header_size, 1, fp ) )
+		&& ( 0 == memcmp( head->Magic, magic, sizeof( head->Magic ) ) )
+		&& ( version == head->Version )
+		&& ( ( uint64_t )st.st_size == head->FileSize )
+		&& ( st.st_mtime == head->FileMtime ) ){
+		if( 0 == *count ){
+			result = true;
+		}else{
+			*entries = malloc( *count * entry_size );
+			if(    ( NULL != *entries )
+				&& ( *count == fread( *entries, entry_size, *count, fp ) ) ){
+				result = true;
+			}
+		}
+	}
+	fclose( fp );
+
+	return result;
+}
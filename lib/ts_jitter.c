@@ -0,0 +1,298 @@
+/**
+* @file ts_jitter.c
+* @brief PCR accuracy analysis
+* @author sage
+* @date 2018/12/04
+* @details PCRs of each PID are collected into windows of TS_JITTER_WINDOW_TICKS.\n
+*			At the end of a window a line is fitted to PCR against byte position.\n
+*			The residuals are the overall jitter, the slope compared with the first window\n
+*			is the frequency offset, and its change between windows is the drift.\n
+*			Only PCR packets are touched, so the analysis keeps up with the reader.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_jitter.h"
+
+#define PCR_CYCLE					( ( ( uint64_t )1 << 33 ) * 300 )
+#define TICKS_TO_NS(t)				( ( t ) * 1000.0 / ( PCR_CLOCK_EXT / 1000000 ) )
+
+static	void			ts_jitter_window( TS_PCR_JITTER* pcr_jitter );
+static	void			ts_jitter_pcr( TS_PCR_JITTER* pcr_jitter, uint64_t pcr, uint64_t offset, bool discontinuity );
+
+/**
+* @brief		Analyze the collected window
+* @param[in,out]	pcr_jitter	Analysis of one PID
+*/
+static	void			ts_jitter_window( TS_PCR_JITTER* pcr_jitter )
+{
+	const TS_JITTER_SAMPLE*	s = pcr_jitter->Samples;
+	uint32_t				n = pcr_jitter->SampleCount;
+	uint32_t				i;
+	double					sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+	double					x, y, slope, intercept, residual;
+	double					frequency_offset;
+	uint64_t				middle;
+	uint32_t				bin;
+
+	pcr_jitter->SampleCount = 0;
+	if( 3 > n ){
+		return;
+	}
+
+	// Relative to the first sample to keep the precision of double.
+	for( i = 0 ; i < n ; i++ ){
+		x = ( double )( s[ i ].Offset - s[ 0 ].Offset );
+		y = ( double )( s[ i ].Time - s[ 0 ].Time );
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+	if( 0.0 == ( n * sxx - sx * sx ) ){
+		return;
+	}
+	slope = ( n * sxy - sx * sy ) / ( n * sxx - sx * sx );
+	intercept = ( sy - slope * sx ) / n;
+
+	for( i = 0 ; i < n ; i++ ){
+		x = ( double )( s[ i ].Offset - s[ 0 ].Offset );
+		y = ( double )( s[ i ].Time - s[ 0 ].Time );
+		residual = fabs( TICKS_TO_NS( y - ( intercept + slope * x ) ) );
+		bin = ( uint32_t )( residual / TS_JITTER_OJ_BIN_NS );
+		if( TS_JITTER_OJ_BINS <= bin ){
+			bin = TS_JITTER_OJ_BINS - 1;
+		}
+		pcr_jitter->JitterHistogram[ bin ]++;
+		pcr_jitter->JitterCount++;
+		if( residual > pcr_jitter->JitterMax ){
+			pcr_jitter->JitterMax = residual;
+		}
+	}
+
+	middle = ( s[ 0 ].Time + s[ n - 1 ].Time ) / 2;
+	if( 0 == pcr_jitter->Windows ){
+		pcr_jitter->ReferenceRate = slope;
+		frequency_offset = 0.0;
+	}else{
+		frequency_offset = ( slope / pcr_jitter->ReferenceRate - 1.0 ) * 1000000.0;
+		if( frequency_offset < pcr_jitter->FrequencyOffsetMin ){
+			pcr_jitter->FrequencyOffsetMin = frequency_offset;
+		}
+		if( frequency_offset > pcr_jitter->FrequencyOffsetMax ){
+			pcr_jitter->FrequencyOffsetMax = frequency_offset;
+		}
+		if( middle > pcr_jitter->LastWindowTime ){
+			double	drift = fabs( frequency_offset - pcr_jitter->FrequencyOffset ) * PCR_CLOCK_EXT / ( middle - pcr_jitter->LastWindowTime );
+
+			if( drift > pcr_jitter->DriftMax ){
+				pcr_jitter->DriftMax = drift;
+			}
+		}
+	}
+	pcr_jitter->FrequencyOffset = frequency_offset;
+	pcr_jitter->LastWindowTime = middle;
+	pcr_jitter->Windows++;
+}
+
+/**
+* @brief		Add one PCR
+* @param[in,out]	pcr_jitter	Analysis of one PID
+* @param[in]	pcr			PCR ( 27MHz )
+* @param[in]	offset		File offset of the PCR packet
+* @param[in]	discontinuity	discontinuity_indicator
+*/
+static	void			ts_jitter_pcr( TS_PCR_JITTER* pcr_jitter, uint64_t pcr, uint64_t offset, bool discontinuity )
+{
+	uint64_t		step;
+	uint32_t		bin;
+
+	pcr_jitter->PcrCount++;
+
+	if( pcr_jitter->Valid ){
+		step = ( pcr + PCR_CYCLE - pcr_jitter->LastPcr ) % PCR_CYCLE;
+		if( discontinuity || ( TS_JITTER_JUMP_TICKS < step ) ){
+			// The window ends here and the frequency offset restarts from the new time base.
+			ts_jitter_window( pcr_jitter );
+			pcr_jitter->Discontinuities++;
+			pcr_jitter->Windows = 0;
+			pcr_jitter->Time = 0;
+		}else{
+			pcr_jitter->Time += step;
+			pcr_jitter->IntervalCount++;
+			pcr_jitter->IntervalSum += step;
+			if( step > pcr_jitter->IntervalMax ){
+				pcr_jitter->IntervalMax = step;
+			}
+			if( TS_JITTER_INTERVAL_LIMIT_TICKS < step ){
+				pcr_jitter->IntervalOver++;
+			}
+			bin = step / ( PCR_CLOCK_EXT / 1000000 * TS_JITTER_INTERVAL_BIN_US );
+			if( TS_JITTER_INTERVAL_BINS <= bin ){
+				bin = TS_JITTER_INTERVAL_BINS - 1;
+			}
+			pcr_jitter->IntervalHistogram[ bin ]++;
+		}
+	}
+	pcr_jitter->LastPcr = pcr;
+	pcr_jitter->Valid = true;
+
+	if(    ( 0 < pcr_jitter->SampleCount )
+		&& (    ( TS_JITTER_WINDOW_SAMPLES <= pcr_jitter->SampleCount )
+			 || ( TS_JITTER_WINDOW_TICKS <= pcr_jitter->Time - pcr_jitter->Samples[ 0 ].Time ) ) ){
+		ts_jitter_window( pcr_jitter );
+	}
+	pcr_jitter->Samples[ pcr_jitter->SampleCount ].Offset = offset;
+	pcr_jitter->Samples[ pcr_jitter->SampleCount ].Time = pcr_jitter->Time;
+	pcr_jitter->SampleCount++;
+}
+
+/**
+* @brief		Initialize analysis
+* @param[out]	jitter		Analysis
+*/
+void			ts_jitter_init( TS_JITTER* jitter )
+{
+	memset( jitter, 0, sizeof( TS_JITTER ) );
+}
+
+/**
+* @brief		Analyze decoded packets
+* @param[in,out]	jitter	Analysis
+* @param[in]	batch		Decoded packets
+* @param[in]	offset		File offset of the first packet in batch
+* @return		bool		false if out of memory
+*/
+bool			ts_jitter_batch( TS_JITTER* jitter, const TS_PACKET_BATCH* batch, uint64_t offset )
+{
+	uint32_t		i;
+	uint16_t		pid;
+
+	for( i = 0 ; i < batch->Count ; i++ ){
+		if( !( batch->Flags[ i ] & TS_PKT_FLAG_PCR ) ){
+			continue;
+		}
+		pid = batch->Pid[ i ];
+		if( NULL == jitter->Pid[ pid ] ){
+			jitter->Pid[ pid ] = calloc( 1, sizeof( TS_PCR_JITTER ) );
+			if( NULL == jitter->Pid[ pid ] ){
+				return false;
+			}
+		}
+		ts_jitter_pcr( jitter->Pid[ pid ], batch->Pcr[ i ], offset + ( uint64_t )i * TS_PACKET_SIZE,
+					   ( batch->Flags[ i ] & TS_PKT_FLAG_DISCONTINUITY ) ? true : false );
+	}
+
+	return true;
+}
+
+/**
+* @brief		Analyze the last windows
+* @param[in,out]	jitter	Analysis
+*/
+void			ts_jitter_finish( TS_JITTER* jitter )
+{
+	uint32_t		pid;
+
+	for( pid = 0 ; pid < 8192 ; pid++ ){
+		if( NULL != jitter->Pid[ pid ] ){
+			ts_jitter_window( jitter->Pid[ pid ] );
+		}
+	}
+}
+
+/**
+* @brief		Analyze TS file
+* @param[in]	ts_file		TS file path. "-" is stdin
+* @param[in]	mode		How the file is read. TS_READER_MODE_*
+* @param[out]	jitter		Analysis. Free with ts_jitter_free()
+* @return		bool		Result
+*/
+bool			ts_jitter_file( const char* ts_file, TS_READER_MODE mode, TS_JITTER* jitter )
+{
+	TS_READER			reader;
+	TS_PACKET_BATCH*	batch;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	bool				result = true;
+
+	ts_jitter_init( jitter );
+
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( NULL == batch ){
+		return false;
+	}
+	if( !ts_reader_open( &reader, ts_file, mode ) ){
+		free( batch );
+		return false;
+	}
+
+	while( result && ( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+		ts_parse_batch( ts_buffer, read_count, batch );
+		result = ts_jitter_batch( jitter, batch, ts_reader_tell( &reader ) - ( uint64_t )read_count * TS_PACKET_SIZE );
+	}
+	ts_jitter_finish( jitter );
+
+	ts_reader_close( &reader );
+	free( batch );
+
+	if( !result ){
+		ts_jitter_free( jitter );
+	}
+
+	return result;
+}
+
+/**
+* @brief		Free analysis
+* @param[in]	jitter		Analysis
+*/
+void			ts_jitter_free( TS_JITTER* jitter )
+{
+	uint32_t		pid;
+
+	for( pid = 0 ; pid < 8192 ; pid++ ){
+		free( jitter->Pid[ pid ] );
+		jitter->Pid[ pid ] = NULL;
+	}
+}
+
+/**
+* @brief		Percentile of a histogram
+* @param[in]	histogram	Histogram
+* @param[in]	bins		Number of bins
+* @param[in]	bin_width	Width of one bin
+* @param[in]	percent		Percentile ( 0 - 100 )
+* @param[in]	max			Largest measured value, in the unit of bin_width
+* @return		double		Upper edge of the bin holding the percentile, not above max. 0 if the histogram is empty
+*/
+double			ts_jitter_percentile( const uint64_t* histogram, uint32_t bins, double bin_width, double percent, double max )
+{
+	uint64_t		total = 0;
+	uint64_t		sum = 0;
+	uint32_t		i;
+
+	for( i = 0 ; i < bins ; i++ ){
+		total += histogram[ i ];
+	}
+	if( 0 == total ){
+		return 0.0;
+	}
+	for( i = 0 ; i < bins ; i++ ){
+		sum += histogram[ i ];
+		if( sum * 100.0 >= total * percent ){
+			break;
+		}
+	}
+
+	// A bin edge above every measured value is not a measurement.
+	return ( ( i + 1 ) * bin_width < max ) ? ( i + 1 ) * bin_width : max;
+}
@@ -0,0 +1,203 @@
+/**
+* @file ts_live.c
+* @brief Live TS input
+* @author sage
+* @date 2018/12/11
+* @details The receive thread only reads into ring blocks, so a slow output never\n
+*			blocks the socket until the whole ring is used.\n
+*			UDP source is "udp://address:port". A multicast address is joined.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ts_ring.h"
+#include "ts_live.h"
+
+static	int				ts_live_udp_open( const char* address );
+static	void*			ts_live_receiver( void* arg );
+
+/**
+* @brief		Open UDP socket
+* @param[in]	address		"address:port". Address may be empty for any
+* @return		int			Socket. -1 on error
+*/
+static	int				ts_live_udp_open( const char* address )
+{
+	struct sockaddr_in	addr;
+	struct ip_mreq		mreq;
+	char				host[ 64 ];
+	const char*			colon = strrchr( address, ':' );
+	int					fd;
+	int					size = TS_LIVE_UDP_RCVBUF;
+	int					reuse = 1;
+
+	if( ( NULL == colon ) || ( sizeof( host ) <= ( size_t )( colon - address ) ) ){
+		return -1;
+	}
+	memcpy( host, address, colon - address );
+	host[ colon - address ] = '\0';
+
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons( atoi( colon + 1 ) );
+	if( '\0' == host[ 0 ] ){
+		addr.sin_addr.s_addr = htonl( INADDR_ANY );
+	}else if( 1 != inet_pton( AF_INET, host, &addr.sin_addr ) ){
+		return -1;
+	}
+
+	fd = socket( AF_INET, SOCK_DGRAM, 0 );
+	if( 0 > fd ){
+		return -1;
+	}
+	setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof( reuse ) );
+	setsockopt( fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof( size ) );
+	if( 0 != bind( fd, ( struct sockaddr* )&addr, sizeof( addr ) ) ){
+		close( fd );
+		return -1;
+	}
+	if( IN_MULTICAST( ntohl( addr.sin_addr.s_addr ) ) ){
+		mreq.imr_multiaddr = addr.sin_addr;
+		mreq.imr_interface.s_addr = htonl( INADDR_ANY );
+		if( 0 != setsockopt( fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof( mreq ) ) ){
+			close( fd );
+			return -1;
+		}
+	}
+
+	return fd;
+}
+
+/**
+* @brief		Receive thread
+* @param[in]	arg			TS_LIVE
+* @details		One read() of stdin per block. A UDP block takes the datagrams already queued in the socket\n
+*				and is published when none is left, so the consumer sees data as soon as it arrives.\n
+*				While the consumer is behind, a UDP block is published only when full, so a stalled output\n
+*				fills the ring with full blocks instead of one datagram per block.\n
+*				The ring is closed at the end of input.\n
+*				After ts_live_stop() nothing more is published, even if the input keeps sending.
+*/
+static	void*			ts_live_receiver( void* arg )
+{
+	TS_LIVE*		live = arg;
+	TS_RING_BLOCK*	block;
+	ssize_t			size;
+	ssize_t			more;
+	int				flags;
+
+	for( ;; ){
+		block = ts_ring_acquire( &live->Ring );
+		if( live->Udp ){
+			size = recv( live->Fd, block->Data, TS_RING_BLOCK_SIZE, 0 );
+			while( ( 0 < size ) && ( live->Ring.BlockSize - ( size_t )size >= TS_RING_BLOCK_SIZE ) ){
+				flags = ( TS_LIVE_UDP_BEHIND_BLOCKS > ts_ring_used( &live->Ring ) ) ? MSG_DONTWAIT : 0;
+				more = recv( live->Fd, &block->Data[ size ], TS_RING_BLOCK_SIZE, flags );
+				if( 0 >= more ){
+					// EAGAIN : nothing queued. 0 : stopped, the next recv() ends the input.
+					break;
+				}
+				size += more;
+			}
+		}else{
+			size = read( live->Fd, block->Data, TS_RING_BLOCK_SIZE );
+		}
+		if( __atomic_load_n( &live->Ring.Closed, __ATOMIC_ACQUIRE ) ){
+			// Stopped by ts_live_stop(). Data read after the stop is dropped, so the consumer reaches the end.
+			break;
+		}
+		if( 0 < size ){
+			block->Length = size;
+			live->Bytes += size;
+			ts_ring_publish( &live->Ring );
+		}else if( ( 0 > size ) && ( EINTR == errno ) ){
+			continue;
+		}else{
+			live->Error = ( 0 > size );
+			break;
+		}
+	}
+	ts_ring_close( &live->Ring );
+
+	return NULL;
+}
+
+/**
+* @brief		Open live input and start receiving
+* @param[out]	live		Live input
+* @param[in]	source		"-" for stdin or "udp://address:port"
+* @return		bool		Result
+*/
+bool			ts_live_open( TS_LIVE* live, const char* source )
+{
+	memset( live, 0, sizeof( TS_LIVE ) );
+	live->Fd = -1;
+
+	if( 0 == strcmp( source, "-" ) ){
+		live->Fd = STDIN_FILENO;
+	}else if( 0 == strncmp( source, TS_LIVE_UDP_PREFIX, strlen( TS_LIVE_UDP_PREFIX ) ) ){
+		live->Fd = ts_live_udp_open( source + strlen( TS_LIVE_UDP_PREFIX ) );
+		live->Udp = true;
+	}
+	if( 0 > live->Fd ){
+		return false;
+	}
+
+	if(    ( !live->Udp && !ts_ring_init( &live->Ring, TS_LIVE_RING_BLOCKS, TS_RING_BLOCK_SIZE ) )
+		|| ( live->Udp && !ts_ring_init( &live->Ring, TS_LIVE_UDP_RING_BLOCKS, TS_LIVE_UDP_BLOCK_SIZE ) ) ){
+		ts_live_close( live );
+		return false;
+	}
+	if( 0 != pthread_create( &live->Thread, NULL, ts_live_receiver, live ) ){
+		ts_live_close( live );
+		return false;
+	}
+	live->Started = true;
+
+	return true;
+}
+
+/**
+* @brief		Stop receiving
+* @param[in]	live		Live input
+* @details		Safe to call from a signal handler. The consumer sees the end of input\n
+*				after the blocks already received. A read() of stdin returns by the signal\n
+*				( handler without SA_RESTART ) or is canceled by ts_live_close().
+*/
+void			ts_live_stop( TS_LIVE* live )
+{
+	if( live->Udp && ( 0 <= live->Fd ) ){
+		shutdown( live->Fd, SHUT_RD );
+	}
+	ts_ring_close( &live->Ring );
+}
+
+/**
+* @brief		Stop the receive thread and close the input
+* @param[in]	live		Live input
+*/
+void			ts_live_close( TS_LIVE* live )
+{
+	if( live->Started ){
+		// The thread may be blocked in read() of stdin or waiting for a free block.
+		pthread_cancel( live->Thread );
+		pthread_join( live->Thread, NULL );
+		live->Started = false;
+	}
+	if( live->Udp && ( 0 <= live->Fd ) ){
+		close( live->Fd );
+	}
+	live->Fd = -1;
+	ts_ring_free( &live->Ring );
+}
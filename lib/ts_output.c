@@ -0,0 +1,172 @@
+/**
+* @file ts_output.c
+* @brief Byte range output
+* @author sage
+* @date 2018/11/06
+* @details Copies a byte range of the input to the output inside the kernel.\n
+*			copy_file_range is tried first ( XFS/btrfs can share the extents ),\n
+*			then sendfile, then large buffered writes.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/sendfile.h>
+
+#include "ts.h"
+#include "ts_output.h"
+#include "ts_stats.h"
+
+static	bool			ts_copy_fallback( int error );
+static	bool			ts_copy_read_write( int in_fd, int out_fd, uint64_t offset, uint64_t length );
+
+/**
+* @brief		Is the error a reason to try the next method ?
+* @param[in]	error		errno
+* @return		bool		true if the next method should be tried
+*/
+static	bool			ts_copy_fallback( int error )
+{
+	return    ( ENOSYS == error )
+		   || ( EXDEV == error )
+		   || ( EINVAL == error )
+		   || ( EOPNOTSUPP == error )
+		   || ( EBADF == error );
+}
+
+/**
+* @brief		Copy with pread and write
+*/
+static	bool			ts_copy_read_write( int in_fd, int out_fd, uint64_t offset, uint64_t length )
+{
+	uint8_t*	buffer;
+	ssize_t		read_size;
+	ssize_t		write_size;
+	size_t		done;
+	bool		result = true;
+	
+	buffer = malloc( TS_OUTPUT_BUFFER_SIZE );
+	if( NULL == buffer ){
+		return false;
+	}
+	
+	while( result && ( 0 < length ) ){
+		read_size = pread( in_fd, buffer, ( length < TS_OUTPUT_BUFFER_SIZE ) ? length : TS_OUTPUT_BUFFER_SIZE, offset );
+		TS_STATS_ADD( ReadCalls, 1 );
+		if( 0 > read_size ){
+			if( EINTR == errno ){
+				continue;
+			}
+			result = false;
+			break;
+		}
+		if( 0 == read_size ){
+			// The input ends before the range.
+			result = false;
+			break;
+		}
+		TS_STATS_ADD( ReadSyscallBytes, read_size );
+		for( done = 0 ; done < ( size_t )read_size ; done += write_size ){
+			write_size = write( out_fd, &buffer[ done ], read_size - done );
+			TS_STATS_ADD( WriteCalls, 1 );
+			if( ( 0 > write_size ) && ( EINTR == errno ) ){
+				write_size = 0;
+				continue;
+			}
+			if( 0 >= write_size ){
+				result = false;
+				break;
+			}
+			TS_STATS_ADD( BytesWritten, write_size );
+		}
+		offset += read_size;
+		length -= read_size;
+	}
+	
+	free( buffer );
+	
+	return result;
+}
+
+/**
+* @brief		Copy byte range of in_fd to the current position of out_fd
+* @param[in]	in_fd		Input file
+* @param[in]	out_fd		Output file
+* @param[in]	offset		Offset in the input file
+* @param[in]	length		Length
+* @param[out]	method		Method used for the last bytes. NULL if not needed
+* @return		bool		Result. false if the input ends before offset + length
+*/
+bool			ts_copy_range( int in_fd, int out_fd, uint64_t offset, uint64_t length, TS_COPY_METHOD* method )
+{
+	loff_t		in_offset = offset;
+	off_t		sf_offset;
+	ssize_t		copy_size;
+	
+	if( NULL != method ){
+		*method = TS_COPY_FILE_RANGE;
+	}
+	while( 0 < length ){
+		copy_size = copy_file_range( in_fd, &in_offset, out_fd, NULL, length, 0 );
+		TS_STATS_ADD( WriteCalls, 1 );
+		if( 0 < copy_size ){
+			TS_STATS_ADD( BytesWritten, copy_size );
+			length -= copy_size;
+			continue;
+		}
+		if( 0 == copy_size ){
+			// The input ends before the range.
+			return false;
+		}
+		if( EINTR == errno ){
+			continue;
+		}
+		if( !ts_copy_fallback( errno ) ){
+			return false;
+		}
+		break;
+	}
+	if( 0 == length ){
+		return true;
+	}
+	
+	if( NULL != method ){
+		*method = TS_COPY_SENDFILE;
+	}
+	sf_offset = in_offset;
+	while( 0 < length ){
+		copy_size = sendfile( out_fd, in_fd, &sf_offset, length );
+		TS_STATS_ADD( WriteCalls, 1 );
+		if( 0 < copy_size ){
+			TS_STATS_ADD( BytesWritten, copy_size );
+			length -= copy_size;
+			continue;
+		}
+		if( 0 == copy_size ){
+			// The input ends before the range.
+			return false;
+		}
+		if( EINTR == errno ){
+			continue;
+		}
+		if( !ts_copy_fallback( errno ) ){
+			return false;
+		}
+		break;
+	}
+	if( 0 == length ){
+		return true;
+	}
+	
+	if( NULL != method ){
+		*method = TS_COPY_READ_WRITE;
+	}
+	
+	return ts_copy_read_write( in_fd, out_fd, sf_offset, length );
+}
@@ -0,0 +1,112 @@
+/**
+* @file ts_packet.c
+* @brief TS packet batch parser
+* @author sage
+* @date 2018/10/02
+* @details Shared header decoder used by every tool.\n
+*			All header fields are extracted in one pass without copying the payload.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+
+/**
+* @brief		Decode one TS packet header
+* @param[in]	p					TS packet
+* @param[out]	payload_offset		Offset of payload in the packet ( TS_PACKET_SIZE when there is none )
+* @param[out]	pcr					PCR ( 27MHz ). PCR_NONE when there is none
+* @return		uint16_t			TS_PKT_FLAG_*
+*/
+static inline	uint16_t	ts_decode_packet( const uint8_t* p, uint8_t* payload_offset, uint64_t* pcr )
+{
+	uint16_t		flags;
+	uint32_t		offset = 4;
+
+	flags  = ( p[ 1 ] >> 7 ) & TS_PKT_FLAG_TEI;
+	flags |= ( p[ 1 ] >> 5 ) & TS_PKT_FLAG_PUSI;
+	flags |= ( p[ 1 ] >> 3 ) & TS_PKT_FLAG_PRIORITY;
+	flags |= ( p[ 3 ] >> 2 ) & TS_PKT_FLAG_ADAPTATION;
+	flags |= ( p[ 3 ]      ) & TS_PKT_FLAG_PAYLOAD;
+	flags |= ( uint16_t )( p[ 3 ] & 0xC0 ) << ( TS_PKT_FLAG_SCRAMBLE_SHIFT - 6 );
+	if( TS_SYNC_BYTE != p[ 0 ] ){
+		flags |= TS_PKT_FLAG_SYNC_ERROR;
+	}
+
+	*pcr = PCR_NONE;
+	if( flags & TS_PKT_FLAG_ADAPTATION ){
+		offset = 4 + 1 + p[ 4 ];
+		if( 0 < p[ 4 ] ){
+			flags |= ( p[ 5 ] >> 1 ) & TS_PKT_FLAG_DISCONTINUITY;
+			flags |= ( p[ 5 ] << 1 ) & TS_PKT_FLAG_RANDOM_ACCESS;
+			if( ( p[ 5 ] & ADAPTATION_FIELD_PCR ) && ( 7 <= p[ 4 ] ) ){
+				flags |= TS_PKT_FLAG_PCR;
+				GET_PCR_EXT( &p[ 6 ], *pcr );
+			}
+		}
+	}
+
+	if( !( flags & TS_PKT_FLAG_PAYLOAD ) || ( TS_PACKET_SIZE <= offset ) ){
+		flags &= ~TS_PKT_FLAG_PAYLOAD;
+		offset = TS_PACKET_SIZE;
+	}
+	*payload_offset = ( uint8_t )offset;
+
+	return flags;
+}
+
+/**
+* @brief		Decode headers of contiguous TS packets
+* @param[in]	packets		First TS packet. Packets must be contiguous and 188 byte aligned
+* @param[in]	count		Number of packets
+* @param[out]	batch		Decoded headers
+* @return		uint32_t	Number of decoded packets ( at most TS_BATCH_PACKETS )
+* @details		Pcr[ i ] is valid only when TS_PKT_FLAG_PCR is set in Flags[ i ].
+*/
+uint32_t		ts_parse_batch( const uint8_t* packets, uint32_t count, TS_PACKET_BATCH* batch )
+{
+	uint32_t		i;
+	const uint8_t*	p = packets;
+
+	if( TS_BATCH_PACKETS < count ){
+		count = TS_BATCH_PACKETS;
+	}
+
+	batch->Packets = packets;
+	batch->Count = count;
+
+	for( i = 0 ; i < count ; i++, p += TS_PACKET_SIZE ){
+		batch->Pid[ i ] = GET_PID( p[ 1 ], p[ 2 ] );
+		batch->ContinuityCounter[ i ] = p[ 3 ] & 0x0F;
+		batch->Flags[ i ] = ts_decode_packet( p, &batch->PayloadOffset[ i ], &batch->Pcr[ i ] );
+	}
+
+	return count;
+}
+
+/**
+* @brief		Decode one TS packet header
+* @param[in]	ts_packet	TS packet
+* @param[out]	header		Decoded header
+*/
+void			ts_parse_header( const uint8_t* ts_packet, TS_HEADER* header )
+{
+	uint8_t			payload_offset;
+	uint16_t		flags;
+
+	flags = ts_decode_packet( ts_packet, &payload_offset, &header->Pcr );
+
+	header->SyncByte					= ts_packet[ 0 ];
+	header->TransportErrorIndicator		= ( flags & TS_PKT_FLAG_TEI ) ? true : false;
+	header->PayloadUnitStartIndicator	= ( flags & TS_PKT_FLAG_PUSI ) ? true : false;
+	header->TransportPriority			= ( flags & TS_PKT_FLAG_PRIORITY ) ? true : false;
+	header->Pid							= GET_PID( ts_packet[ 1 ], ts_packet[ 2 ] );
+	header->TransportScramblingControl	= TS_PKT_SCRAMBLE( flags );
+	header->AdaptationFieldControl		= ( ts_packet[ 3 ] & 0x30 ) >> 4;
+	header->ContinuityCounter			= ts_packet[ 3 ] & 0x0F;
+}
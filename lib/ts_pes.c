@@ -0,0 +1,386 @@
+/**
+* @file ts_pes.c
+* @brief PES reassembly
+* @author sage
+* @date 2018/12/25
+* @details A PES starts at a packet with payload_unit_start_indicator and ends when\n
+*			PES_packet_length is reached, or at the next start when the length is 0 ( video ).\n
+*			Blocks are recycled through a free list, so the memory stays at the blocks\n
+*			of the PES being collected.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_pes.h"
+
+static inline	uint64_t	ts_pes_timestamp( const uint8_t* data );
+static inline	bool		ts_pes_has_optional_header( uint8_t stream_id );
+static	void			ts_pes_release( TS_PES_DEMUX* demux, TS_PES_STREAM* stream );
+static	void			ts_pes_drop( TS_PES_DEMUX* demux, TS_PES_STREAM* stream );
+static	void			ts_pes_complete( TS_PES_DEMUX* demux, TS_PES_STREAM* stream );
+static	bool			ts_pes_append( TS_PES_DEMUX* demux, TS_PES_STREAM* stream, const uint8_t* data, uint32_t size );
+
+/**
+* @brief		Decode PTS / DTS
+* @param[in]	data		5 bytes of the time stamp
+* @return		uint64_t	33bit time stamp ( 90kHz )
+*/
+static inline	uint64_t	ts_pes_timestamp( const uint8_t* data )
+{
+	uint64_t	timestamp;
+
+	timestamp  = ( ( uint64_t )( data[ 0 ] >> 1 ) & 0x07 ) << 30;
+	timestamp |= ( uint64_t )data[ 1 ] << 22;
+	timestamp |= ( uint64_t )( data[ 2 ] >> 1 ) << 15;
+	timestamp |= ( uint64_t )data[ 3 ] << 7;
+	timestamp |= ( uint64_t )data[ 4 ] >> 1;
+
+	return timestamp;
+}
+
+/**
+* @brief		Optional PES header check
+* @param[in]	stream_id	stream_id
+* @return		bool		true if the PES has the flags and PES_header_data_length ( ISO/IEC 13818-1 2.4.3.7 )
+*/
+static inline	bool		ts_pes_has_optional_header( uint8_t stream_id )
+{
+	switch( stream_id ){
+		case 0xBC:							// program_stream_map
+		case 0xBE:							// padding_stream
+		case 0xBF:							// private_stream_2
+		case 0xF0:							// ECM
+		case 0xF1:							// EMM
+		case 0xF2:							// DSMCC_stream
+		case 0xF8:							// ITU-T Rec. H.222.1 type E
+		case 0xFF:							// program_stream_directory
+			return false;
+		default:
+			return true;
+	}
+}
+
+/**
+* @brief		Return the blocks of the pending PES to the pool
+* @param[in]	demux		Demux
+* @param[in]	stream		PID state
+*/
+static	void			ts_pes_release( TS_PES_DEMUX* demux, TS_PES_STREAM* stream )
+{
+	if( NULL != stream->Pes.Blocks ){
+		stream->Last->Next = demux->FreeBlocks;
+		demux->FreeBlocks = stream->Pes.Blocks;
+	}
+	stream->Pes.Blocks = NULL;
+	stream->Pes.Size = 0;
+	stream->Last = NULL;
+	stream->Expected = 0;
+	stream->Active = false;
+}
+
+/**
+* @brief		Discard the pending PES
+* @param[in]	demux		Demux
+* @param[in]	stream		PID state
+*/
+static	void			ts_pes_drop( TS_PES_DEMUX* demux, TS_PES_STREAM* stream )
+{
+	if( stream->Active ){
+		stream->Dropped++;
+	}
+	ts_pes_release( demux, stream );
+}
+
+/**
+* @brief		Decode the PES header and deliver the pending PES
+* @param[in]	demux		Demux
+* @param[in]	stream		PID state
+*/
+static	void			ts_pes_complete( TS_PES_DEMUX* demux, TS_PES_STREAM* stream )
+{
+	TS_PES*			pes = &stream->Pes;
+	const uint8_t*	header;
+	uint8_t			pts_dts_flags;
+
+	// The first block is larger than any PES header, the header is always contiguous.
+	if( TS_PES_HEADER_SIZE > pes->Size ){
+		ts_pes_drop( demux, stream );
+		return;
+	}
+	header = pes->Blocks->Data;
+	if( ( 0x00 != header[ 0 ] ) || ( 0x00 != header[ 1 ] ) || ( 0x01 != header[ 2 ] ) ){
+		ts_pes_drop( demux, stream );
+		return;
+	}
+
+	pes->StreamId = header[ 3 ];
+	pes->HeaderSize = TS_PES_HEADER_SIZE;
+	pes->Pts = TS_PES_TIMESTAMP_NONE;
+	pes->Dts = TS_PES_TIMESTAMP_NONE;
+	if( ts_pes_has_optional_header( pes->StreamId ) ){
+		if( TS_PES_HEADER_SIZE + 3 > pes->Size ){
+			ts_pes_drop( demux, stream );
+			return;
+		}
+		pes->HeaderSize = TS_PES_HEADER_SIZE + 3 + header[ 8 ];
+		if( pes->HeaderSize > pes->Size ){
+			ts_pes_drop( demux, stream );
+			return;
+		}
+		pts_dts_flags = header[ 7 ] >> 6;
+		if( ( pts_dts_flags & 0x02 ) && ( 14 <= pes->HeaderSize ) ){
+			pes->Pts = ts_pes_timestamp( &header[ 9 ] );
+		}
+		if( ( 0x03 == pts_dts_flags ) && ( 19 <= pes->HeaderSize ) ){
+			pes->Dts = ts_pes_timestamp( &header[ 14 ] );
+		}
+	}
+
+	stream->PesCount++;
+	stream->Bytes += pes->Size - pes->HeaderSize;
+	if( NULL != demux->Handler ){
+		demux->Handler( demux->Context, pes );
+	}
+	ts_pes_release( demux, stream );
+}
+
+/**
+* @brief		Copy payload bytes into the blocks of the pending PES
+* @param[in]	demux		Demux
+* @param[in]	stream		PID state
+* @param[in]	data		Payload bytes
+* @param[in]	size		Number of bytes
+* @return		bool		false if no block could be allocated
+*/
+static	bool			ts_pes_append( TS_PES_DEMUX* demux, TS_PES_STREAM* stream, const uint8_t* data, uint32_t size )
+{
+	TS_PES_BLOCK*	block;
+	uint32_t		copy;
+
+	while( 0 < size ){
+		block = stream->Last;
+		if( ( NULL == block ) || ( TS_PES_BLOCK_SIZE == block->Length ) ){
+			block = demux->FreeBlocks;
+			if( NULL != block ){
+				demux->FreeBlocks = block->Next;
+			}else{
+				block = malloc( sizeof( TS_PES_BLOCK ) );
+				if( NULL == block ){
+					return false;
+				}
+				demux->BlockCount++;
+			}
+			block->Next = NULL;
+			block->Length = 0;
+			if( NULL == stream->Last ){
+				stream->Pes.Blocks = block;
+			}else{
+				stream->Last->Next = block;
+			}
+			stream->Last = block;
+		}
+
+		copy = TS_PES_BLOCK_SIZE - block->Length;
+		if( size < copy ){
+			copy = size;
+		}
+		memcpy( &block->Data[ block->Length ], data, copy );
+		block->Length += copy;
+		stream->Pes.Size += copy;
+		data += copy;
+		size -= copy;
+	}
+
+	return true;
+}
+
+/**
+* @brief		Initialize demux
+* @param[out]	demux		Demux
+* @param[in]	handler		Called for every PES. May be NULL to only count
+* @param[in]	context		Passed to handler
+*/
+void			ts_pes_init( TS_PES_DEMUX* demux, TS_PES_HANDLER handler, void* context )
+{
+	memset( demux, 0, sizeof( TS_PES_DEMUX ) );
+	demux->Handler = handler;
+	demux->Context = context;
+}
+
+/**
+* @brief		Select PID
+* @param[in]	demux		Demux
+* @param[in]	pid			PID carrying PES
+* @return		bool		Result
+*/
+bool			ts_pes_add_pid( TS_PES_DEMUX* demux, uint16_t pid )
+{
+	pid &= 0x1FFF;
+	if( NULL == demux->Pid[ pid ] ){
+		demux->Pid[ pid ] = calloc( 1, sizeof( TS_PES_STREAM ) );
+		if( NULL != demux->Pid[ pid ] ){
+			demux->Pid[ pid ]->Pes.Pid = pid;
+		}
+	}
+
+	return NULL != demux->Pid[ pid ];
+}
+
+/**
+* @brief		Process one TS packet
+* @param[in]	demux			Demux
+* @param[in]	ts_packet		TS packet
+* @param[in]	pid				PID
+* @param[in]	flags			TS_PKT_FLAG_*
+* @param[in]	cc				continuity_counter
+* @param[in]	payload_offset	Offset of payload in ts_packet
+* @param[in]	offset			File offset of ts_packet
+*/
+void			ts_pes_packet( TS_PES_DEMUX* demux, const uint8_t* ts_packet, uint16_t pid, uint16_t flags, uint8_t cc, uint8_t payload_offset, uint64_t offset )
+{
+	TS_PES_STREAM*	stream = demux->Pid[ pid ];
+	const uint8_t*	data;
+	uint32_t		size;
+	uint32_t		copy;
+
+	if(    ( NULL == stream )
+		|| !( flags & TS_PKT_FLAG_PAYLOAD )
+		|| ( TS_PACKET_SIZE <= payload_offset ) ){
+		return;
+	}
+	if( ( flags & TS_PKT_FLAG_TEI ) || ( TS_SCRAMBLE_NONE != TS_PKT_SCRAMBLE( flags ) ) ){
+		ts_pes_drop( demux, stream );
+		return;
+	}
+	if( stream->HasCc ){
+		if( cc == stream->LastCc ){
+			return;							// Duplicate packet
+		}
+		if( !( flags & TS_PKT_FLAG_DISCONTINUITY ) && ts_cc_error( stream->LastCc, cc ) ){
+			ts_pes_drop( demux, stream );
+		}
+	}
+	stream->HasCc = true;
+	stream->LastCc = cc;
+
+	if( flags & TS_PKT_FLAG_PUSI ){
+		if( stream->Active ){
+			if( 0 == stream->Expected ){
+				ts_pes_complete( demux, stream );
+			}else{
+				ts_pes_drop( demux, stream );		// Shorter than PES_packet_length
+			}
+		}
+		stream->Active = true;
+		stream->Pes.Offset = offset;
+	}else if( !stream->Active ){
+		return;
+	}
+
+	data = &ts_packet[ payload_offset ];
+	size = TS_PACKET_SIZE - payload_offset;
+
+	// PES_packet_length is read as soon as the first 6 bytes are collected.
+	if( TS_PES_HEADER_SIZE > stream->Pes.Size ){
+		copy = TS_PES_HEADER_SIZE - stream->Pes.Size;
+		if( size < copy ){
+			copy = size;
+		}
+		if( !ts_pes_append( demux, stream, data, copy ) ){
+			ts_pes_drop( demux, stream );
+			return;
+		}
+		data += copy;
+		size -= copy;
+		if( TS_PES_HEADER_SIZE == stream->Pes.Size ){
+			const uint8_t*	header = stream->Pes.Blocks->Data;
+			uint32_t		length = ( ( uint32_t )header[ 4 ] << 8 ) | header[ 5 ];
+
+			if( 0 < length ){
+				stream->Expected = TS_PES_HEADER_SIZE + length;
+			}
+		}
+	}
+	if( ( 0 != stream->Expected ) && ( stream->Expected - stream->Pes.Size < size ) ){
+		size = stream->Expected - stream->Pes.Size;		// Stuffing after the PES
+	}
+	if( !ts_pes_append( demux, stream, data, size ) ){
+		ts_pes_drop( demux, stream );
+		return;
+	}
+
+	if( ( 0 != stream->Expected ) && ( stream->Expected == stream->Pes.Size ) ){
+		ts_pes_complete( demux, stream );
+	}else if( TS_PES_SIZE_MAX < stream->Pes.Size ){
+		ts_pes_drop( demux, stream );
+	}
+}
+
+/**
+* @brief		Process decoded packets
+* @param[in]	demux		Demux
+* @param[in]	batch		Decoded packets
+* @param[in]	offset		File offset of the first packet in batch
+*/
+void			ts_pes_batch( TS_PES_DEMUX* demux, const TS_PACKET_BATCH* batch, uint64_t offset )
+{
+	uint32_t	i;
+
+	for( i = 0 ; i < batch->Count ; i++ ){
+		if( NULL != demux->Pid[ batch->Pid[ i ] ] ){
+			ts_pes_packet( demux, &batch->Packets[ i * TS_PACKET_SIZE ], batch->Pid[ i ], batch->Flags[ i ],
+							batch->ContinuityCounter[ i ], batch->PayloadOffset[ i ], offset + ( uint64_t )i * TS_PACKET_SIZE );
+		}
+	}
+}
+
+/**
+* @brief		End of input. Delivers the pending PES of unbounded length
+* @param[in]	demux		Demux
+*/
+void			ts_pes_flush( TS_PES_DEMUX* demux )
+{
+	uint32_t	pid;
+
+	for( pid = 0 ; pid < 8192 ; pid++ ){
+		TS_PES_STREAM*	stream = demux->Pid[ pid ];
+
+		if( ( NULL == stream ) || !stream->Active ){
+			continue;
+		}
+		if( 0 == stream->Expected ){
+			ts_pes_complete( demux, stream );
+		}else{
+			ts_pes_drop( demux, stream );
+		}
+	}
+}
+
+/**
+* @brief		Free demux
+* @param[in]	demux		Demux
+*/
+void			ts_pes_free( TS_PES_DEMUX* demux )
+{
+	TS_PES_BLOCK*	block;
+	uint32_t		pid;
+
+	for( pid = 0 ; pid < 8192 ; pid++ ){
+		if( NULL != demux->Pid[ pid ] ){
+			ts_pes_release( demux, demux->Pid[ pid ] );
+			free( demux->Pid[ pid ] );
+			demux->Pid[ pid ] = NULL;
+		}
+	}
+	while( NULL != ( block = demux->FreeBlocks ) ){
+		demux->FreeBlocks = block->Next;
+		free( block );
+	}
+	demux->BlockCount = 0;
+}
@@ -0,0 +1,311 @@
+/**
+* @file ts_pid_filter.c
+* @brief PID selection of output packets
+* @author sage
+* @date 2019/01/22
+* @details A selected program keeps PAT, its PMT, PCR PID, elementary streams and TOT,\n
+*			so the output can be split again. PAT is rewritten to list only the selected program.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_section.h"
+#include "ts_psi.h"
+#include "ts_crc32.h"
+#include "ts_pid_filter.h"
+
+static	void			ts_pid_filter_update( TS_PID_FILTER* filter );
+static	void			ts_pid_filter_select( TS_PID_FILTER* filter, uint16_t pid );
+static	void			ts_pid_filter_section( void* context, uint16_t pid, const uint8_t* section, uint32_t size );
+static	void			ts_pid_filter_build_pat( TS_PID_FILTER* filter, const uint8_t* section, uint16_t pmt_pid );
+
+/**
+* @brief		Initialize filter. Every PID passes
+* @param[out]	filter		Filter
+*/
+void			ts_pid_filter_init( TS_PID_FILTER* filter )
+{
+	memset( filter, 0, sizeof( TS_PID_FILTER ) );
+	filter->PmtPid = PID_NULL;
+	ts_pid_filter_update( filter );
+}
+
+/**
+* @brief		Rebuild the pass map
+* @param[in]	filter		Filter
+*/
+static	void			ts_pid_filter_update( TS_PID_FILTER* filter )
+{
+	uint32_t	i;
+
+	filter->Active = filter->Selective;
+	for( i = 0 ; i < TS_PID_FILTER_WORDS ; i++ ){
+		filter->Pass[ i ] = ( filter->Selective ? filter->Select[ i ] : ~( uint64_t )0 ) & ~filter->Exclude[ i ];
+		if( 0 != filter->Exclude[ i ] ){
+			filter->Active = true;
+		}
+	}
+}
+
+/**
+* @brief		Add PID to the selection
+*/
+static	void			ts_pid_filter_select( TS_PID_FILTER* filter, uint16_t pid )
+{
+	filter->Select[ pid >> 6 ] |= ( uint64_t )1 << ( pid & 0x3F );
+}
+
+/**
+* @brief		Write only the included PIDs ( and the selected program )
+* @param[in]	filter		Filter
+* @param[in]	pid			PID
+*/
+void			ts_pid_filter_include( TS_PID_FILTER* filter, uint16_t pid )
+{
+	filter->Selective = true;
+	ts_pid_filter_select( filter, pid & PID_NULL );
+	ts_pid_filter_update( filter );
+}
+
+/**
+* @brief		Drop PID. Exclusion wins over inclusion and program selection
+* @param[in]	filter		Filter
+* @param[in]	pid			PID
+*/
+void			ts_pid_filter_exclude( TS_PID_FILTER* filter, uint16_t pid )
+{
+	pid &= PID_NULL;
+	filter->Exclude[ pid >> 6 ] |= ( uint64_t )1 << ( pid & 0x3F );
+	ts_pid_filter_update( filter );
+}
+
+/**
+* @brief		Add comma separated PIDs
+* @param[in]	filter		Filter
+* @param[in]	list		PIDs in decimal or 0x hex. ( exp 0x100,0x110,257 )
+* @param[in]	include		true includes, false excludes
+* @return		bool		false if the list has a broken PID
+*/
+bool			ts_pid_filter_add_list( TS_PID_FILTER* filter, const char* list, bool include )
+{
+	const char*		pos = list;
+	char*			end;
+	unsigned long	pid;
+
+	while( '\0' != *pos ){
+		pid = strtoul( pos, &end, 0 );
+		if( ( end == pos ) || ( PID_NULL < pid ) || ( ( ',' != *end ) && ( '\0' != *end ) ) ){
+			return false;
+		}
+		if( include ){
+			ts_pid_filter_include( filter, ( uint16_t )pid );
+		}else{
+			ts_pid_filter_exclude( filter, ( uint16_t )pid );
+		}
+		pos = ( ',' == *end ) ? end + 1 : end;
+	}
+
+	return true;
+}
+
+/**
+* @brief		Build the PAT packet written instead of the input PAT
+* @param[in]	filter		Filter
+* @param[in]	section		Input PAT section listing ProgramNumber
+* @param[in]	pmt_pid		PMT PID of ProgramNumber
+* @details		transport_stream_id and version_number are taken over, so a new input PAT version\n
+*				makes a new output PAT version.
+*/
+static	void			ts_pid_filter_build_pat( TS_PID_FILTER* filter, const uint8_t* section, uint16_t pmt_pid )
+{
+	uint8_t*	packet = filter->Pat;
+	uint8_t*	pat = &packet[ 5 ];
+	uint32_t	crc;
+
+	memset( packet, 0xFF, TS_PACKET_SIZE );
+	packet[ 0 ] = TS_SYNC_BYTE;
+	packet[ 1 ] = 0x40 | ( PID_PAT >> 8 );				// payload_unit_start_indicator
+	packet[ 2 ] = PID_PAT & 0xFF;
+	packet[ 3 ] = 0x10;									// payload only. continuity_counter of the input packet
+	packet[ 4 ] = 0x00;									// pointer_field
+
+	pat[ 0 ] = TABLE_ID_PAT;
+	pat[ 1 ] = 0xB0;
+	pat[ 2 ] = 5 + 4 + TS_SECTION_CRC_SIZE;				// section_length
+	pat[ 3 ] = section[ 3 ];							// transport_stream_id
+	pat[ 4 ] = section[ 4 ];
+	pat[ 5 ] = section[ 5 ];							// version_number, current_next_indicator
+	pat[ 6 ] = 0x00;									// section_number
+	pat[ 7 ] = 0x00;									// last_section_number
+	pat[ 8 ] = filter->ProgramNumber >> 8;
+	pat[ 9 ] = filter->ProgramNumber & 0xFF;
+	pat[ 10 ] = 0xE0 | ( pmt_pid >> 8 );
+	pat[ 11 ] = pmt_pid & 0xFF;
+	crc = ts_crc32( pat, 12, TS_CRC32_INIT );
+	pat[ 12 ] = crc >> 24;
+	pat[ 13 ] = crc >> 16;
+	pat[ 14 ] = crc >> 8;
+	pat[ 15 ] = crc;
+
+	filter->PatReady = true;
+}
+
+/**
+* @brief		Section handler. Follows PAT to the PMT of the program and selects its PIDs
+* @param[in]	context		TS_PID_FILTER
+* @param[in]	pid			PID
+* @param[in]	section		Section
+* @param[in]	size		Size of the section
+*/
+static	void			ts_pid_filter_section( void* context, uint16_t pid, const uint8_t* section, uint32_t size )
+{
+	TS_PID_FILTER*	filter = context;
+	TS_PAT			pat;
+	TS_PMT			pmt;
+	uint32_t		i;
+
+	if( PID_PAT == pid ){
+		if( !ts_psi_parse_pat( section, size, &pat ) ){
+			return;
+		}
+		for( i = 0 ; i < pat.Count ; i++ ){
+			if( filter->ProgramNumber != pat.Programs[ i ].ProgramNumber ){
+				continue;
+			}
+			ts_pid_filter_build_pat( filter, section, pat.Programs[ i ].Pid );
+			if( filter->PmtPid != pat.Programs[ i ].Pid ){
+				filter->PmtPid = pat.Programs[ i ].Pid;
+				ts_pid_filter_select( filter, filter->PmtPid );
+				ts_section_add_pid( filter->Sections, filter->PmtPid );
+				ts_pid_filter_update( filter );
+			}
+			break;
+		}
+	}else if(    ( pid == filter->PmtPid )
+			  && ts_psi_parse_pmt( section, size, &pmt )
+			  && ( filter->ProgramNumber == pmt.ProgramNumber ) ){
+		// A new PMT version adds its PIDs, PIDs already selected stay.
+		if( PID_NULL != pmt.PcrPid ){
+			ts_pid_filter_select( filter, pmt.PcrPid );
+		}
+		for( i = 0 ; i < pmt.Count ; i++ ){
+			ts_pid_filter_select( filter, pmt.Streams[ i ].Pid );
+		}
+		filter->Resolved = true;
+		ts_pid_filter_update( filter );
+	}
+}
+
+/**
+* @brief		Write only the PIDs of the program
+* @param[in]	filter			Filter
+* @param[in]	program_number	program_number in PAT
+* @return		bool			Result
+* @details		Until the PMT is found only PAT and TOT pass. Feed every batch to ts_pid_filter_batch().
+*/
+bool			ts_pid_filter_program( TS_PID_FILTER* filter, uint16_t program_number )
+{
+	filter->Sections = malloc( sizeof( TS_SECTION_FILTER ) );
+	if( NULL == filter->Sections ){
+		return false;
+	}
+	ts_section_init( filter->Sections, ts_pid_filter_section, filter );
+	if( !ts_section_add_pid( filter->Sections, PID_PAT ) ){
+		ts_pid_filter_free( filter );
+		return false;
+	}
+
+	filter->ProgramNumber = program_number;
+	filter->Selective = true;
+	ts_pid_filter_select( filter, PID_PAT );
+	ts_pid_filter_select( filter, PID_TOT );
+	ts_pid_filter_update( filter );
+
+	return true;
+}
+
+/**
+* @brief		Follow PAT / PMT in the batch. Call before testing the packets of the batch
+* @param[in]	filter		Filter
+* @param[in]	batch		Parsed packets
+*/
+void			ts_pid_filter_batch( TS_PID_FILTER* filter, const TS_PACKET_BATCH* batch )
+{
+	if( NULL != filter->Sections ){
+		ts_section_batch( filter->Sections, batch );
+	}
+}
+
+/**
+* @brief		PAT packet to write for a passing PAT packet
+* @param[in]	filter		Filter. ts_pid_filter_batch() was called for the batch of packet
+* @param[in]	packet		Input packet of PID_PAT
+* @param[in]	flags		TS_PKT_FLAG_* of packet
+* @return		const uint8_t*	packet as it is, the PAT listing only the selected program,\n
+*								or NULL to drop the rest of a PAT longer than one packet
+* @details		Until the program is found in a PAT, the input PAT is written as it is.
+*/
+const uint8_t*	ts_pid_filter_pat( TS_PID_FILTER* filter, const uint8_t* packet, uint16_t flags )
+{
+	if( !filter->PatReady ){
+		return packet;
+	}
+	if( !( flags & TS_PKT_FLAG_PUSI ) ){
+		return NULL;
+	}
+	filter->Pat[ 3 ] = 0x10 | ( packet[ 3 ] & 0x0F );
+
+	return filter->Pat;
+}
+
+/**
+* @brief		Find the PMT of the selected program from the head of a seekable input
+* @param[in]	filter		Filter
+* @param[in]	reader		Seekable reader. The position is changed
+* @return		bool		false if the PMT is not found in TS_PID_FILTER_SCAN_BYTES
+*/
+bool			ts_pid_filter_resolve( TS_PID_FILTER* filter, TS_READER* reader )
+{
+	TS_PACKET_BATCH*	batch;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+
+	if( ( NULL == filter->Sections ) || filter->Resolved ){
+		return true;
+	}
+
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( NULL == batch ){
+		return false;
+	}
+	ts_reader_seek( reader, 0 );
+	while(    !filter->Resolved
+		   && ( TS_PID_FILTER_SCAN_BYTES > ts_reader_tell( reader ) )
+		   && ( 0 < ( read_count = ts_reader_next( reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+		ts_parse_batch( ts_buffer, read_count, batch );
+		ts_pid_filter_batch( filter, batch );
+	}
+	free( batch );
+
+	return filter->Resolved;
+}
+
+/**
+* @brief		Free filter
+* @param[in]	filter		Filter
+*/
+void			ts_pid_filter_free( TS_PID_FILTER* filter )
+{
+	if( NULL != filter->Sections ){
+		ts_section_free( filter->Sections );
+		free( filter->Sections );
+		filter->Sections = NULL;
+	}
+}
@@ -0,0 +1,94 @@
+/**
+* @file ts_psi.c
+* @brief PAT / PMT parser
+* @author sage
+* @date 2019/01/08
+* @details Sections are expected to be complete and CRC checked.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_section.h"
+#include "ts_psi.h"
+
+/**
+* @brief		Parse PAT section
+* @param[in]	section		Section
+* @param[in]	size		Size of the section
+* @param[out]	pat			PAT
+* @return		bool		false if the section is not a PAT
+*/
+bool			ts_psi_parse_pat( const uint8_t* section, uint32_t size, TS_PAT* pat )
+{
+	uint32_t	pos;
+
+	if( ( 8 + TS_SECTION_CRC_SIZE > size ) || ( TABLE_ID_PAT != section[ 0 ] ) ){
+		return false;
+	}
+	pat->TransportStreamId = ( ( uint16_t )section[ 3 ] << 8 ) | section[ 4 ];
+	pat->Count = 0;
+
+	// program_number( 16 ), reserved( 3 ), PID( 13 ) up to CRC_32
+	for( pos = 8 ; ( pos + 4 + TS_SECTION_CRC_SIZE <= size ) && ( TS_PAT_PROGRAMS_MAX > pat->Count ) ; pos += 4 ){
+		pat->Programs[ pat->Count ].ProgramNumber = ( ( uint16_t )section[ pos ] << 8 ) | section[ pos + 1 ];
+		pat->Programs[ pat->Count ].Pid = GET_PID( section[ pos + 2 ], section[ pos + 3 ] );
+		pat->Count++;
+	}
+
+	return true;
+}
+
+/**
+* @brief		Parse PMT section
+* @param[in]	section		Section
+* @param[in]	size		Size of the section
+* @param[out]	pmt			PMT
+* @return		bool		false if the section is not a PMT or is broken
+*/
+bool			ts_psi_parse_pmt( const uint8_t* section, uint32_t size, TS_PMT* pmt )
+{
+	uint32_t	pos;
+	uint32_t	end;
+
+	if( ( 12 + TS_SECTION_CRC_SIZE > size ) || ( TABLE_ID_PMT != section[ 0 ] ) ){
+		return false;
+	}
+	pmt->ProgramNumber = ( ( uint16_t )section[ 3 ] << 8 ) | section[ 4 ];
+	pmt->PcrPid = GET_PID( section[ 8 ], section[ 9 ] );
+	pmt->Count = 0;
+
+	end = size - TS_SECTION_CRC_SIZE;
+	pos = 12 + ( ( ( uint32_t )section[ 10 ] & 0x0F ) << 8 ) + section[ 11 ];		// skip program_info
+	while( ( pos + 5 <= end ) && ( TS_PMT_STREAMS_MAX > pmt->Count ) ){
+		pmt->Streams[ pmt->Count ].StreamType = section[ pos ];
+		pmt->Streams[ pmt->Count ].Pid = GET_PID( section[ pos + 1 ], section[ pos + 2 ] );
+		pmt->Count++;
+		pos += 5 + ( ( ( uint32_t )section[ pos + 3 ] & 0x0F ) << 8 ) + section[ pos + 4 ];
+	}
+
+	return pos <= end;
+}
+
+/**
+* @brief		Video stream type check
+* @param[in]	stream_type	stream_type of PMT
+* @return		bool		true for MPEG-1 / 2, MPEG-4 part 2, H.264, H.265 video
+*/
+bool			ts_psi_is_video( uint8_t stream_type )
+{
+	switch( stream_type ){
+		case 0x01:							// MPEG-1 video
+		case 0x02:							// MPEG-2 video
+		case 0x10:							// MPEG-4 part 2
+		case 0x1B:							// H.264
+		case 0x24:							// H.265
+			return true;
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,273 @@
+/**
+* @file ts_rap.c
+* @brief Random access point index
+* @author sage
+* @date 2019/01/08
+* @details The video PID and the PCR PID are taken from the first PMT with a video stream.\n
+*			Until a PMT is found, packets carrying a PCR are taken as the video PID.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_section.h"
+#include "ts_psi.h"
+#include "ts_index_file.h"
+#include "ts_rap.h"
+
+typedef struct {
+	TS_SECTION_FILTER	Sections;
+	uint16_t			Pid;
+	uint16_t			PcrPid;
+} TS_RAP_SCAN;
+
+static	bool			ts_rap_index_add( TS_RAP_INDEX* index, uint64_t offset, uint64_t pcr );
+static	void			ts_rap_section( void* context, uint16_t pid, const uint8_t* section, uint32_t size );
+
+/**
+* @brief		Make index file path
+* @param[in]	ts_file		TS file path
+* @param[out]	index_file	Index file path
+* @param[in]	size		Size of index_file
+*/
+void			ts_rap_index_path( const char* ts_file, char* index_file, size_t size )
+{
+	snprintf( index_file, size, "%s%s", ts_file, TS_RAP_INDEX_SUFFIX );
+}
+
+/**
+* @brief		Append entry
+*/
+static	bool			ts_rap_index_add( TS_RAP_INDEX* index, uint64_t offset, uint64_t pcr )
+{
+	TS_RAP_ENTRY*	entry = ts_index_file_append( ( void** )&index->Entries, &index->Header.Count, &index->Capacity, sizeof( TS_RAP_ENTRY ) );
+	
+	if( NULL == entry ){
+		return false;
+	}
+	entry->Offset = offset;
+	entry->Pcr = pcr;
+	
+	return true;
+}
+
+/**
+* @brief		Section handler of the scan. Finds the video PID in the PMTs
+* @param[in]	context		TS_RAP_SCAN
+* @param[in]	pid			PID
+* @param[in]	section		Section
+* @param[in]	size		Size of the section
+*/
+static	void			ts_rap_section( void* context, uint16_t pid, const uint8_t* section, uint32_t size )
+{
+	TS_RAP_SCAN*	scan = context;
+	TS_PAT			pat;
+	TS_PMT			pmt;
+	uint32_t		i;
+
+	if( PID_PAT == pid ){
+		if( ts_psi_parse_pat( section, size, &pat ) ){
+			for( i = 0 ; i < pat.Count ; i++ ){
+				if( 0 != pat.Programs[ i ].ProgramNumber ){
+					ts_section_add_pid( &scan->Sections, pat.Programs[ i ].Pid );
+				}
+			}
+		}
+	}else if( ( PID_NULL == scan->Pid ) && ts_psi_parse_pmt( section, size, &pmt ) ){
+		for( i = 0 ; i < pmt.Count ; i++ ){
+			if( ts_psi_is_video( pmt.Streams[ i ].StreamType ) ){
+				scan->Pid = pmt.Streams[ i ].Pid;
+				scan->PcrPid = pmt.PcrPid;
+				break;
+			}
+		}
+	}
+}
+
+/**
+* @brief		Build random access point index by scanning the whole TS file
+* @param[in]	ts_file		TS file path
+* @param[in]	mode		How the file is read. TS_READER_MODE_*
+* @param[out]	index		Index. Free with ts_rap_index_free()
+* @return		bool		Result
+*/
+bool			ts_rap_index_build( const char* ts_file, TS_READER_MODE mode, TS_RAP_INDEX* index )
+{
+	TS_READER			reader;
+	TS_PACKET_BATCH*	batch;
+	TS_RAP_SCAN*		scan;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	uint64_t			offset;
+	uint64_t			pcr = TS_RAP_PCR_NONE;
+	uint32_t			n;
+	bool				result = true;
+
+	memset( index, 0, sizeof( TS_RAP_INDEX ) );
+	if( !ts_index_file_stamp( &index->Header, TS_RAP_INDEX_MAGIC, TS_RAP_INDEX_VERSION, ts_file ) ){
+		return false;
+	}
+
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	scan = malloc( sizeof( TS_RAP_SCAN ) );
+	if( ( NULL == batch ) || ( NULL == scan ) ){
+		free( batch );
+		free( scan );
+		return false;
+	}
+	ts_section_init( &scan->Sections, ts_rap_section, scan );
+	scan->Pid = PID_NULL;
+	scan->PcrPid = PID_NULL;
+	if( !ts_section_add_pid( &scan->Sections, PID_PAT ) || !ts_reader_open( &reader, ts_file, mode ) ){
+		ts_section_free( &scan->Sections );
+		free( batch );
+		free( scan );
+		return false;
+	}
+
+	while( result && ( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+		offset = ts_reader_tell( &reader ) - ( uint64_t )read_count * TS_PACKET_SIZE;
+
+		ts_parse_batch( ts_buffer, read_count, batch );
+		for( n = 0 ; n < batch->Count ; n++ ){
+			uint16_t	flags = batch->Flags[ n ];
+			uint16_t	pid = batch->Pid[ n ];
+
+			if( NULL != scan->Sections.Pid[ pid ] ){
+				ts_section_packet( &scan->Sections, &ts_buffer[ n * TS_PACKET_SIZE ], pid, flags,
+									batch->ContinuityCounter[ n ], batch->PayloadOffset[ n ] );
+				continue;
+			}
+			if( ( flags & TS_PKT_FLAG_PCR ) && ( ( PID_NULL == scan->PcrPid ) || ( pid == scan->PcrPid ) ) ){
+				pcr = batch->Pcr[ n ];
+			}
+			if(    ( ( TS_PKT_FLAG_RANDOM_ACCESS | TS_PKT_FLAG_PUSI ) == ( flags & ( TS_PKT_FLAG_RANDOM_ACCESS | TS_PKT_FLAG_PUSI ) ) )
+				&& ( ( pid == scan->Pid ) || ( ( PID_NULL == scan->Pid ) && ( flags & TS_PKT_FLAG_PCR ) ) ) ){
+				if( !ts_rap_index_add( index, offset + ( uint64_t )n * TS_PACKET_SIZE, pcr ) ){
+					result = false;
+					break;
+				}
+			}
+		}
+	}
+	index->Header.Pid = scan->Pid;
+	index->Header.PcrPid = scan->PcrPid;
+
+	ts_reader_close( &reader );
+	ts_section_free( &scan->Sections );
+	free( scan );
+	free( batch );
+
+	if( !result ){
+		ts_rap_index_free( index );
+	}
+
+	return result;
+}
+
+/**
+* @brief		Save random access point index
+* @param[in]	index_file	Index file path
+* @param[in]	index		Index
+* @return		bool		Result
+*/
+bool			ts_rap_index_save( const char* index_file, const TS_RAP_INDEX* index )
+{
+	return ts_index_file_save( index_file, &index->Header, sizeof( index->Header ), index->Entries, sizeof( TS_RAP_ENTRY ), index->Header.Count );
+}
+
+/**
+* @brief		Load random access point index
+* @param[in]	index_file	Index file path
+* @param[in]	ts_file		TS file path. The index is rejected if the TS file was changed after indexing
+* @param[out]	index		Index. Free with ts_rap_index_free()
+* @return		bool		false if there is no valid index
+*/
+bool			ts_rap_index_load( const char* index_file, const char* ts_file, TS_RAP_INDEX* index )
+{
+	memset( index, 0, sizeof( TS_RAP_INDEX ) );
+	if( !ts_index_file_load( index_file, ts_file, TS_RAP_INDEX_MAGIC, TS_RAP_INDEX_VERSION, &index->Header, sizeof( index->Header ),
+							 &index->Header.Count, ( void** )&index->Entries, sizeof( TS_RAP_ENTRY ) ) ){
+		ts_rap_index_free( index );
+		return false;
+	}
+	index->Capacity = index->Header.Count;
+	
+	return true;
+}
+
+/**
+* @brief		Free random access point index
+* @param[in]	index		Index
+*/
+void			ts_rap_index_free( TS_RAP_INDEX* index )
+{
+	free( index->Entries );
+	memset( index, 0, sizeof( TS_RAP_INDEX ) );
+}
+
+/**
+* @brief		Search the random access point nearest to offset
+* @param[in]	index		Index
+* @param[in]	offset		File offset
+* @return		int64_t		Entry number. -1 if the index is empty
+*/
+int64_t			ts_rap_index_nearest( const TS_RAP_INDEX* index, uint64_t offset )
+{
+	uint64_t	low = 0;
+	uint64_t	high = index->Header.Count;
+	uint64_t	mid;
+
+	if( 0 == index->Header.Count ){
+		return -1;
+	}
+	while( low < high ){
+		mid = low + ( high - low ) / 2;
+		if( index->Entries[ mid ].Offset < offset ){
+			low = mid + 1;
+		}else{
+			high = mid;
+		}
+	}
+
+	// low is the first entry at or after offset, compare it with the one before.
+	if( low == index->Header.Count ){
+		return ( int64_t )low - 1;
+	}
+	if( ( 0 < low ) && ( offset - index->Entries[ low - 1 ].Offset < index->Entries[ low ].Offset - offset ) ){
+		return ( int64_t )low - 1;
+	}
+
+	return ( int64_t )low;
+}
+
+/**
+* @brief		Search the last random access point at or before offset
+* @param[in]	index		Index
+* @param[in]	offset		File offset
+* @return		int64_t		Entry number. -1 if there is none
+*/
+int64_t			ts_rap_index_before( const TS_RAP_INDEX* index, uint64_t offset )
+{
+	uint64_t	low = 0;
+	uint64_t	high = index->Header.Count;
+	uint64_t	mid;
+
+	while( low < high ){
+		mid = low + ( high - low ) / 2;
+		if( index->Entries[ mid ].Offset <= offset ){
+			low = mid + 1;
+		}else{
+			high = mid;
+		}
+	}
+
+	// low is the first entry after offset.
+	return ( int64_t )low - 1;
+}
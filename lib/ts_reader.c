@@ -0,0 +1,569 @@
+/**
+* @file ts_reader.c
+* @brief TS packet reader
+* @author sage
+* @date 2018/10/09
+* @details Regular files are memory-mapped with sequential and hugepage hints,\n
+*			so callers walk the packets in place without any copy.\n
+*			When mmap is not possible ( pipe, stdin, ... ) the reader falls back\n
+*			to read() with a large buffer. Live input is taken from a TS_RING\n
+*			filled by a receive thread.\n
+*			In TS_READER_MODE_THREAD a file or pipe is read the same way by a read-ahead thread,\n
+*			so a slow read ( network storage, page faults of the map ) does not stall the parser.\n
+*			Packets of a ring are handed out in place from the peeked block like the map,\n
+*			only a packet straddling two blocks is copied.\n
+*			TS_READER_MODE_DIRECT is the same thread reading the file with O_DIRECT into the aligned ring\n
+*			blocks. The ring is then the only read-ahead. Where the file system refuses O_DIRECT the file\n
+*			is read through the cache with a sequential hint and the pages are dropped as soon as a block is read.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "ts_reader.h"
+#include "ts_sync.h"
+#include "ts_stats.h"
+
+static	bool			ts_reader_fill( TS_READER* reader );
+static	const uint8_t*	ts_reader_ring_peek( TS_READER* reader, size_t want, uint64_t* length );
+static	const uint8_t*	ts_reader_peek( TS_READER* reader, size_t want, uint64_t* length );
+static	void			ts_reader_skip( TS_READER* reader, uint64_t length );
+static	bool			ts_reader_resync( TS_READER* reader );
+static	void*			ts_reader_thread( void* arg );
+static	bool			ts_reader_thread_start( TS_READER* reader );
+static	void			ts_reader_thread_stop( TS_READER* reader );
+
+/**
+* @brief		Open TS file
+* @param[out]	reader		Reader
+* @param[in]	ts_file		TS file path. "-" is stdin
+* @param[in]	mode		TS_READER_MODE_MMAP ( falls back to stream ), TS_READER_MODE_STREAM,\n
+*							TS_READER_MODE_THREAD or TS_READER_MODE_DIRECT ( no page cache )
+* @return		bool		Result
+*/
+bool			ts_reader_open( TS_READER* reader, const char* ts_file, TS_READER_MODE mode )
+{
+	struct stat		st;
+	void*			map;
+
+	memset( reader, 0, sizeof( TS_READER ) );
+	reader->Fd = -1;
+	reader->DirectFd = -1;
+
+	if( 0 == strcmp( ts_file, "-" ) ){
+		reader->Fd = STDIN_FILENO;
+	}else{
+		reader->Fd = open( ts_file, O_RDONLY );
+		if( 0 > reader->Fd ){
+			return false;
+		}
+	}
+
+	if(    ( 0 == fstat( reader->Fd, &st ) )
+		&& S_ISREG( st.st_mode ) ){
+		reader->Seekable = true;
+		reader->FileSize = st.st_size;
+
+		if( ( TS_READER_MODE_MMAP == mode ) && ( 0 < st.st_size ) ){
+			map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, reader->Fd, 0 );
+			if( MAP_FAILED != map ){
+				madvise( map, st.st_size, MADV_SEQUENTIAL );
+#ifdef MADV_HUGEPAGE
+				madvise( map, st.st_size, MADV_HUGEPAGE );
+#endif
+				reader->Mode = TS_READER_MODE_MMAP;
+				reader->Map = map;
+				return true;
+			}
+		}
+	}
+
+	reader->Mode = TS_READER_MODE_STREAM;
+	reader->BufferSize = TS_READER_STREAM_PACKETS * TS_PACKET_SIZE;
+	reader->Buffer = malloc( reader->BufferSize );
+	if( NULL == reader->Buffer ){
+		ts_reader_close( reader );
+		return false;
+	}
+
+	if( ( TS_READER_MODE_DIRECT == mode ) && reader->Seekable ){
+		if( STDIN_FILENO != reader->Fd ){
+			reader->DirectFd = open( ts_file, O_RDONLY | O_DIRECT );
+		}
+		reader->DropCache = ( 0 > reader->DirectFd );
+	}
+	if( ( TS_READER_MODE_THREAD == mode ) || ( TS_READER_MODE_DIRECT == mode ) ){
+		// The thread is started by the first read, so opening a pipe does not consume it.
+		if( !ts_ring_init( &reader->ThreadRing, TS_READER_THREAD_BLOCKS, TS_READER_THREAD_BLOCK_SIZE ) ){
+			ts_reader_close( reader );
+			return false;
+		}
+		reader->Mode = TS_READER_MODE_THREAD;
+		reader->Ring = &reader->ThreadRing;
+	}
+
+	return true;
+}
+
+/**
+* @brief		Open live input
+* @param[out]	reader		Reader
+* @param[in]	ring		Ring filled by the receive thread. Not freed by ts_reader_close()
+* @return		bool		Result
+*/
+bool			ts_reader_open_ring( TS_READER* reader, TS_RING* ring )
+{
+	memset( reader, 0, sizeof( TS_READER ) );
+	reader->Fd = -1;
+	reader->DirectFd = -1;
+	reader->Mode = TS_READER_MODE_RING;
+	reader->Ring = ring;
+	reader->BufferSize = TS_READER_STREAM_PACKETS * TS_PACKET_SIZE;
+	reader->Buffer = malloc( reader->BufferSize );
+	
+	return ( NULL != reader->Buffer );
+}
+
+/**
+* @brief		Close TS file
+* @param[in]	reader		Reader
+*/
+void			ts_reader_close( TS_READER* reader )
+{
+	ts_reader_thread_stop( reader );
+	reader->Block = NULL;
+	if( NULL != reader->ThreadRing.Blocks ){
+		ts_ring_free( &reader->ThreadRing );
+	}
+	reader->Ring = NULL;
+	if( NULL != reader->Map ){
+		munmap( ( void* )reader->Map, reader->FileSize );
+		reader->Map = NULL;
+	}
+	free( reader->Buffer );
+	reader->Buffer = NULL;
+
+	if( ( 0 <= reader->Fd ) && ( STDIN_FILENO != reader->Fd ) ){
+		close( reader->Fd );
+	}
+	reader->Fd = -1;
+	if( ( 0 <= reader->DirectFd ) && ( STDIN_FILENO != reader->DirectFd ) ){
+		close( reader->DirectFd );
+	}
+	reader->DirectFd = -1;
+}
+
+/**
+* @brief		Read-ahead thread
+* @param[in]	arg			TS_READER
+* @details		Reads blocks from ThreadOffset until the end of file. Canceled by a seek or close.\n
+*				A block is filled up before it is published, a pipe returns at most its capacity per read().\n
+*				O_DIRECT reads start at ThreadOffset, aligned by ts_reader_thread_start(), and fill whole blocks,\n
+*				so offset, length and buffer stay aligned until the short read at the end of file.
+*/
+static	void*			ts_reader_thread( void* arg )
+{
+	TS_READER*		reader = arg;
+	TS_RING*		ring = &reader->ThreadRing;
+	TS_RING_BLOCK*	block;
+	uint64_t		offset = reader->ThreadOffset;
+	ssize_t			size = 1;
+	int				fd = ( 0 <= reader->DirectFd ) ? reader->DirectFd : reader->Fd;
+	bool			drop = reader->DropCache;
+
+	if( drop ){
+		posix_fadvise( fd, offset, 0, POSIX_FADV_SEQUENTIAL );
+	}
+	while( 0 < size ){
+		block = ts_ring_acquire( ring );
+		block->Length = 0;
+		while( block->Length < ring->BlockSize ){
+			if( reader->Seekable ){
+				size = pread( fd, &block->Data[ block->Length ], ring->BlockSize - block->Length, offset );
+				if(    ( 0 > size ) && ( EINVAL == errno ) && ( fd != reader->Fd )
+					&& ( 0 == ( offset % TS_RING_ALIGN ) ) ){
+					// O_DIRECT is accepted by open() but not by read() of this file system.
+					fd = reader->Fd;
+					drop = true;
+					posix_fadvise( fd, offset, 0, POSIX_FADV_SEQUENTIAL );
+					continue;
+				}
+			}else{
+				size = read( reader->Fd, &block->Data[ block->Length ], ring->BlockSize - block->Length );
+			}
+			TS_STATS_ADD( ReadCalls, 1 );
+			if( 0 < size ){
+				TS_STATS_ADD( ReadSyscallBytes, size );
+				block->Length += size;
+				offset += size;
+			}else if( ( 0 > size ) && ( EINTR == errno ) ){
+				continue;
+			}else{
+				break;
+			}
+		}
+		if( 0 < block->Length ){
+			if( drop ){
+				posix_fadvise( fd, offset - block->Length, block->Length, POSIX_FADV_DONTNEED );
+			}
+			ts_ring_publish( ring );
+		}
+	}
+	ts_ring_close( ring );
+
+	return NULL;
+}
+
+/**
+* @brief		Start the read-ahead thread at Position
+* @param[in]	reader		Reader. The buffer is empty
+* @return		bool		Result
+* @details		Reads start at the aligned offset below Position. The window starts at one block and\n
+*				doubles with every consumed block, so a short read after a seek ( a bisection probe )\n
+*				does not read the whole ring ahead.
+*/
+static	bool			ts_reader_thread_start( TS_READER* reader )
+{
+	uint64_t		aligned = reader->Position;
+
+	if( reader->Seekable ){
+		aligned -= reader->Position % TS_RING_ALIGN;
+	}
+	ts_ring_reset( &reader->ThreadRing );
+	reader->ThreadRing.Window = 1;
+	reader->ThreadOffset = aligned;
+	reader->RingPos = reader->Position - aligned;
+
+	if( 0 != pthread_create( &reader->Thread, NULL, ts_reader_thread, reader ) ){
+		return false;
+	}
+	reader->ThreadStarted = true;
+
+	return true;
+}
+
+/**
+* @brief		Stop the read-ahead thread
+* @param[in]	reader		Reader
+*/
+static	void			ts_reader_thread_stop( TS_READER* reader )
+{
+	if( reader->ThreadStarted ){
+		// The thread may be blocked in read() or waiting for a free block.
+		pthread_cancel( reader->Thread );
+		pthread_join( reader->Thread, NULL );
+		reader->ThreadStarted = false;
+	}
+}
+
+/**
+* @brief		Refill stream buffer
+* @param[in]	reader		Reader
+* @return		bool		false if no more data
+* @details		Unconsumed bytes are moved to the head of the buffer.
+*/
+static	bool			ts_reader_fill( TS_READER* reader )
+{
+	size_t		remain;
+	ssize_t		read_size;
+
+	remain = reader->BufferLength - reader->BufferPos;
+	if( 0 < remain ){
+		memmove( reader->Buffer, &reader->Buffer[ reader->BufferPos ], remain );
+	}
+	reader->BufferPos = 0;
+	reader->BufferLength = remain;
+
+	while( !reader->Eof && ( reader->BufferLength < reader->BufferSize ) ){
+		read_size = read( reader->Fd, &reader->Buffer[ reader->BufferLength ], reader->BufferSize - reader->BufferLength );
+		TS_STATS_ADD( ReadCalls, 1 );
+		if( 0 < read_size ){
+			TS_STATS_ADD( ReadSyscallBytes, read_size );
+			reader->BufferLength += read_size;
+		}else if( ( 0 > read_size ) && ( EINTR == errno ) ){
+			continue;
+		}else{
+			reader->Eof = true;
+		}
+	}
+
+	return ( TS_PACKET_SIZE <= reader->BufferLength );
+}
+
+/**
+* @brief		Get unread data of the ring
+* @param[in]	reader		Reader
+* @param[in]	want		Wanted length
+* @param[out]	length		Length of unread data
+* @return		const uint8_t*	Unread data
+* @details		Data is handed out in place from the peeked block. When less than want is left in the block,\n
+*				the rest of it and the head of the next blocks are copied to Buffer, so a packet or a sync window\n
+*				straddling two blocks is contiguous. Buffer is consumed before the block is handed out again.
+*/
+static	const uint8_t*	ts_reader_ring_peek( TS_READER* reader, size_t want, uint64_t* length )
+{
+	TS_RING_BLOCK*	block;
+	size_t			copy;
+
+	if( ( TS_READER_MODE_THREAD == reader->Mode ) && !reader->ThreadStarted && !reader->Eof ){
+		if( !ts_reader_thread_start( reader ) ){
+			reader->Eof = true;
+		}
+	}
+
+	if( 0 < reader->BufferPos ){
+		memmove( reader->Buffer, &reader->Buffer[ reader->BufferPos ], reader->BufferLength - reader->BufferPos );
+		reader->BufferLength -= reader->BufferPos;
+		reader->BufferPos = 0;
+	}
+
+	while( reader->BufferLength < want ){
+		if( NULL == reader->Block ){
+			if( reader->Eof || ( NULL == ( reader->Block = ts_ring_peek( reader->Ring, true ) ) ) ){
+				reader->Eof = true;
+				break;
+			}
+		}
+		block = reader->Block;
+		if( reader->RingPos >= block->Length ){
+			// Consumed, or skipped by the alignment after a seek.
+			reader->RingPos -= block->Length;
+			ts_ring_release( reader->Ring );
+			reader->Block = NULL;
+			continue;
+		}
+		if( ( 0 == reader->BufferLength ) && ( block->Length - reader->RingPos >= want ) ){
+			*length = block->Length - reader->RingPos;
+			return &block->Data[ reader->RingPos ];
+		}
+		copy = block->Length - reader->RingPos;
+		if( copy > want - reader->BufferLength ){
+			copy = want - reader->BufferLength;
+		}
+		memcpy( &reader->Buffer[ reader->BufferLength ], &block->Data[ reader->RingPos ], copy );
+		reader->BufferLength += copy;
+		reader->RingPos += copy;
+	}
+
+	*length = reader->BufferLength;
+	return reader->Buffer;
+}
+
+/**
+* @brief		Get unread data
+* @param[in]	reader		Reader
+* @param[in]	want		Wanted length. Stream buffer is refilled if less than this
+* @param[out]	length		Length of unread data
+* @return		const uint8_t*	Unread data
+*/
+static	const uint8_t*	ts_reader_peek( TS_READER* reader, size_t want, uint64_t* length )
+{
+	if( TS_READER_MODE_MMAP == reader->Mode ){
+		*length = ( reader->Position < reader->FileSize ) ? ( reader->FileSize - reader->Position ) : 0;
+		return &reader->Map[ reader->Position ];
+	}
+
+	if( NULL != reader->Ring ){
+		return ts_reader_ring_peek( reader, want, length );
+	}
+
+	if( want > ( reader->BufferLength - reader->BufferPos ) ){
+		ts_reader_fill( reader );
+	}
+	*length = reader->BufferLength - reader->BufferPos;
+	return &reader->Buffer[ reader->BufferPos ];
+}
+
+/**
+* @brief		Skip unread data
+* @param[in]	reader		Reader
+* @param[in]	length		Skip length. Must not exceed the peeked length
+*/
+static	void			ts_reader_skip( TS_READER* reader, uint64_t length )
+{
+	if( ( NULL != reader->Ring ) && ( 0 == reader->BufferLength ) ){
+		reader->RingPos += length;
+	}else if( TS_READER_MODE_MMAP != reader->Mode ){
+		reader->BufferPos += length;
+	}
+	reader->Position += length;
+}
+
+/**
+* @brief		Re-lock on the packet alignment
+* @param[in]	reader		Reader
+* @return		bool		false if no more packets
+* @details		Bytes before the next run of TS_SYNC_WINDOW_PACKETS aligned sync bytes are skipped.\n
+*				Near the end of file the window shrinks to the remaining packets.
+*/
+static	bool			ts_reader_resync( TS_READER* reader )
+{
+	const uint8_t*	data;
+	uint64_t		length;
+	uint32_t		window;
+	size_t			offset;
+	bool			counted = false;
+
+	for( ;; ){
+		// The window is only peeked out of lock, so a ring block end in lock copies no more than a packet.
+		data = ts_reader_peek( reader, TS_PACKET_SIZE, &length );
+		if( TS_PACKET_SIZE > length ){
+			return false;
+		}
+		if( TS_SYNC_BYTE == data[ 0 ] ){
+			reader->Seeked = false;
+			return true;
+		}
+		data = ts_reader_peek( reader, TS_SYNC_WINDOW_PACKETS * TS_PACKET_SIZE, &length );
+
+		if( !counted && !reader->Seeked ){
+			reader->ResyncCount++;
+			TS_STATS_ADD( Resyncs, 1 );
+			counted = true;
+		}
+
+		window = length / TS_PACKET_SIZE;
+		if( TS_SYNC_WINDOW_PACKETS < window ){
+			window = TS_SYNC_WINDOW_PACKETS;
+		}
+		offset = ts_sync_find( data, length, window );
+		if( TS_SYNC_NOT_FOUND == offset ){
+			// Every candidate in the data was tested, keep only the bytes which could still start a window.
+			offset = length - ( window - 1 ) * TS_PACKET_SIZE;
+		}
+		if( !reader->Seeked ){
+			reader->SkippedBytes += offset;
+			TS_STATS_ADD( SkippedBytes, offset );
+		}
+		ts_reader_skip( reader, offset );
+	}
+}
+
+/**
+* @brief		Get next packets
+* @param[in]	reader		Reader
+* @param[out]	packets		First packet. Valid until the next call
+* @param[in]	max_packets	Maximum number of packets
+* @return		uint32_t	Number of contiguous packets. 0 at the end of file
+* @details		Every returned packet starts with the sync byte.\n
+*				Corrupted data is skipped and counted in SkippedBytes.
+*/
+uint32_t		ts_reader_next( TS_READER* reader, const uint8_t** packets, uint32_t max_packets )
+{
+	const uint8_t*	data;
+	uint64_t		length;
+	uint64_t		avail;
+	uint32_t		count;
+
+	if( !ts_reader_resync( reader ) ){
+		return 0;
+	}
+
+	data = ts_reader_peek( reader, TS_PACKET_SIZE, &length );
+	avail = length / TS_PACKET_SIZE;
+	if( avail > max_packets ){
+		avail = max_packets;
+	}
+	for( count = 1 ; count < avail ; count++ ){
+		if( TS_SYNC_BYTE != data[ count * TS_PACKET_SIZE ] ){
+			break;
+		}
+	}
+
+	*packets = data;
+	ts_reader_skip( reader, ( uint64_t )count * TS_PACKET_SIZE );
+	TS_STATS_ADD( BytesRead, ( uint64_t )count * TS_PACKET_SIZE );
+
+	return count;
+}
+
+/**
+* @brief		Seek
+* @param[in]	reader		Reader
+* @param[in]	offset		File offset
+* @return		bool		Result
+* @details		Non-seekable input can only skip forward.\n
+*				The offset does not need to be packet aligned, the next read re-locks without counting skipped bytes.
+*/
+bool			ts_reader_seek( TS_READER* reader, uint64_t offset )
+{
+	reader->Seeked = true;
+	TS_STATS_ADD( SeekCalls, 1 );
+	if( ( TS_READER_MODE_THREAD == reader->Mode ) && reader->Seekable ){
+		uint64_t	length = reader->BufferLength - reader->BufferPos;
+
+		if( ( 0 == length ) && ( NULL != reader->Block ) && ( reader->Block->Length > reader->RingPos ) ){
+			length = reader->Block->Length - reader->RingPos;
+		}
+		if( ( offset >= reader->Position ) && ( offset - reader->Position <= length ) ){
+			ts_reader_skip( reader, offset - reader->Position );
+			return true;
+		}
+		ts_reader_thread_stop( reader );
+		reader->Block = NULL;
+		reader->BufferPos = 0;
+		reader->BufferLength = 0;
+		reader->Eof = false;
+		reader->Position = offset;
+		return true;
+	}
+	if( TS_READER_MODE_MMAP == reader->Mode ){
+		if( offset > reader->FileSize ){
+			offset = reader->FileSize;
+		}
+		reader->Position = offset;
+		return true;
+	}
+
+	if( reader->Seekable ){
+		TS_STATS_ADD( LseekCalls, 1 );
+		if( 0 > lseek( reader->Fd, offset, SEEK_SET ) ){
+			return false;
+		}
+		reader->BufferPos = 0;
+		reader->BufferLength = 0;
+		reader->Eof = false;
+		reader->Position = offset;
+		return true;
+	}
+
+	if( offset < reader->Position ){
+		return false;
+	}
+	while( reader->Position < offset ){
+		uint64_t	skip;
+
+		ts_reader_peek( reader, 1, &skip );
+		if( 0 == skip ){
+			return false;
+		}
+		if( skip > offset - reader->Position ){
+			skip = offset - reader->Position;
+		}
+		ts_reader_skip( reader, skip );
+	}
+
+	return true;
+}
+
+/**
+* @brief		Get file offset of the next packet
+* @param[in]	reader		Reader
+* @return		uint64_t	File offset
+*/
+uint64_t		ts_reader_tell( const TS_READER* reader )
+{
+	return reader->Position;
+}
@@ -0,0 +1,182 @@
+/**
+* @file ts_restamp.c
+* @brief PCR / PTS / DTS restamping
+* @author sage
+* @date 2019/01/15
+* @details The shift is a multiple of 300, so the PCR extension and 90kHz time stamps move together.\n
+*			At a discontinuity of the PCR PID the shift is chosen again so that the output PCR\n
+*			continues at the byte rate of the last PCR interval. discontinuity_indicator is kept\n
+*			as it is, it also allows the continuity counter jump that usually comes with it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_restamp.h"
+
+#define PCR_CYCLE					( ( ( uint64_t )1 << 33 ) * 300 )
+#define PTS_CYCLE					( ( uint64_t )1 << 33 )
+
+static inline	uint64_t	ts_restamp_read_timestamp( const uint8_t* data );
+static inline	void		ts_restamp_write_timestamp( uint8_t* data, uint64_t timestamp );
+static	void			ts_restamp_pes( TS_RESTAMP* restamp, uint8_t* ts_packet, uint8_t payload_offset );
+
+/**
+* @brief		Decode PTS / DTS
+* @param[in]	data		5 bytes of the time stamp
+* @return		uint64_t	33bit time stamp ( 90kHz )
+*/
+static inline	uint64_t	ts_restamp_read_timestamp( const uint8_t* data )
+{
+	return   ( ( ( uint64_t )data[ 0 ] >> 1 ) & 0x07 ) << 30
+		   | ( uint64_t )data[ 1 ] << 22
+		   | ( ( uint64_t )data[ 2 ] >> 1 ) << 15
+		   | ( uint64_t )data[ 3 ] << 7
+		   | ( uint64_t )data[ 4 ] >> 1;
+}
+
+/**
+* @brief		Encode PTS / DTS. The prefix bits and marker bits are kept
+* @param[out]	data		5 bytes of the time stamp
+* @param[in]	timestamp	33bit time stamp ( 90kHz )
+*/
+static inline	void		ts_restamp_write_timestamp( uint8_t* data, uint64_t timestamp )
+{
+	data[ 0 ] = ( data[ 0 ] & 0xF1 ) | ( ( timestamp >> 29 ) & 0x0E );
+	data[ 1 ] = ( timestamp >> 22 ) & 0xFF;
+	data[ 2 ] = ( data[ 2 ] & 0x01 ) | ( ( timestamp >> 14 ) & 0xFE );
+	data[ 3 ] = ( timestamp >> 7 ) & 0xFF;
+	data[ 4 ] = ( data[ 4 ] & 0x01 ) | ( ( timestamp << 1 ) & 0xFE );
+}
+
+/**
+* @brief		Initialize restamping
+* @param[out]	restamp		Restamp state
+* @details		Without ts_restamp_start(), the first PCR, DTS or PTS of the input becomes TS_RESTAMP_ORIGIN.
+*/
+void			ts_restamp_init( TS_RESTAMP* restamp )
+{
+	memset( restamp, 0, sizeof( TS_RESTAMP ) );
+	restamp->PcrPid = PID_NULL;
+}
+
+/**
+* @brief		Set the input PCR that becomes TS_RESTAMP_ORIGIN
+* @param[in]	restamp		Restamp state
+* @param[in]	pcr_pid		PCR PID
+* @param[in]	pcr			First PCR of the output ( 27MHz )
+*/
+void			ts_restamp_start( TS_RESTAMP* restamp, uint16_t pcr_pid, uint64_t pcr )
+{
+	restamp->Shift = ( pcr + PCR_CYCLE - TS_RESTAMP_ORIGIN ) % PCR_CYCLE;
+	restamp->Shift -= restamp->Shift % 300;
+	restamp->PcrPid = pcr_pid;
+	restamp->Started = true;
+}
+
+/**
+* @brief		Restamp PTS / DTS of a PES header starting in the packet
+* @param[in]	restamp			Restamp state
+* @param[in,out]	ts_packet	TS packet with payload_unit_start_indicator
+* @param[in]	payload_offset	Offset of payload in ts_packet
+* @details		A PES header continuing into the next packet is left as it is.
+*/
+static	void			ts_restamp_pes( TS_RESTAMP* restamp, uint8_t* ts_packet, uint8_t payload_offset )
+{
+	uint8_t*	pes = &ts_packet[ payload_offset ];
+	uint8_t		pts_dts_flags;
+	uint64_t	shift;
+
+	if(    ( TS_PACKET_SIZE < payload_offset + 14 )
+		|| ( 0x00 != pes[ 0 ] ) || ( 0x00 != pes[ 1 ] ) || ( 0x01 != pes[ 2 ] )
+		|| ( 0x80 != ( pes[ 6 ] & 0xC0 ) ) ){			// '10' of the optional PES header
+		return;
+	}
+	pts_dts_flags = pes[ 7 ] >> 6;
+	if( !( pts_dts_flags & 0x02 ) ){
+		return;
+	}
+	if( ( 0x03 == pts_dts_flags ) && ( TS_PACKET_SIZE < payload_offset + 19 ) ){
+		return;
+	}
+
+	if( !restamp->Started ){
+		// No PCR yet. DTS is closer to the PCR than PTS.
+		ts_restamp_start( restamp, PID_NULL,
+						  ts_restamp_read_timestamp( &pes[ ( 0x03 == pts_dts_flags ) ? 14 : 9 ] ) * 300 );
+	}
+
+	shift = restamp->Shift / 300;
+	ts_restamp_write_timestamp( &pes[ 9 ], ( ts_restamp_read_timestamp( &pes[ 9 ] ) + PTS_CYCLE - shift ) % PTS_CYCLE );
+	if( 0x03 == pts_dts_flags ){
+		ts_restamp_write_timestamp( &pes[ 14 ], ( ts_restamp_read_timestamp( &pes[ 14 ] ) + PTS_CYCLE - shift ) % PTS_CYCLE );
+	}
+}
+
+/**
+* @brief		Restamp one TS packet
+* @param[in]	restamp			Restamp state
+* @param[in,out]	ts_packet	TS packet. Rewritten in place
+* @param[in]	pid				PID
+* @param[in]	flags			TS_PKT_FLAG_*
+* @param[in]	payload_offset	Offset of payload in ts_packet
+*/
+void			ts_restamp_packet( TS_RESTAMP* restamp, uint8_t* ts_packet, uint16_t pid, uint16_t flags, uint8_t payload_offset )
+{
+	if( flags & TS_PKT_FLAG_PCR ){
+		uint8_t*	pcr_bin = &ts_packet[ 6 ];
+		uint64_t	pcr;
+		uint64_t	out;
+
+		GET_PCR_EXT( pcr_bin, pcr );
+		if( !restamp->Started ){
+			ts_restamp_start( restamp, pid, pcr );
+		}
+		if( PID_NULL == restamp->PcrPid ){
+			restamp->PcrPid = pid;
+		}
+		if( ( pid == restamp->PcrPid ) && restamp->HasPcr ){
+			uint64_t	step = ( pcr + PCR_CYCLE - restamp->LastPcr ) % PCR_CYCLE;
+			uint64_t	bytes = restamp->Bytes - restamp->LastPcrBytes;
+
+			if( ( flags & TS_PKT_FLAG_DISCONTINUITY ) || ( TS_RESTAMP_JUMP_TICKS < step ) ){
+				uint64_t	expected = restamp->LastOutPcr;
+
+				if( 0.0 < restamp->TicksPerByte ){
+					expected += ( uint64_t )( bytes * restamp->TicksPerByte );
+				}else{
+					expected += PCR_CLOCK_EXT / 25;
+				}
+				restamp->Shift = ( pcr + PCR_CYCLE - expected % PCR_CYCLE ) % PCR_CYCLE;
+				restamp->Shift -= restamp->Shift % 300;
+				restamp->TicksPerByte = 0.0;
+				restamp->Rebases++;
+			}else if( 0 < bytes ){
+				restamp->TicksPerByte = ( double )step / bytes;
+			}
+		}
+
+		out = ( pcr + PCR_CYCLE - restamp->Shift ) % PCR_CYCLE;
+		out /= 300;									// The extension is not changed by a shift of 300 multiple
+		SET_PCR( pcr_bin, out );
+		if( pid == restamp->PcrPid ){
+			restamp->HasPcr = true;
+			restamp->LastPcr = pcr;
+			restamp->LastOutPcr = ( pcr + PCR_CYCLE - restamp->Shift ) % PCR_CYCLE;
+			restamp->LastPcrBytes = restamp->Bytes;
+		}
+	}
+
+	if(    ( TS_PKT_FLAG_PUSI | TS_PKT_FLAG_PAYLOAD ) == ( flags & ( TS_PKT_FLAG_PUSI | TS_PKT_FLAG_PAYLOAD ) )
+		&& ( TS_SCRAMBLE_NONE == TS_PKT_SCRAMBLE( flags ) )
+		&& ( PID_SI_LAST < pid ) ){
+		ts_restamp_pes( restamp, ts_packet, payload_offset );
+	}
+
+	restamp->Bytes += TS_PACKET_SIZE;
+}
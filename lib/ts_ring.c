@@ -0,0 +1,183 @@
+/**
+* @file ts_ring.c
+* @brief Single producer / single consumer block ring
+* @author sage
+* @date 2018/12/11
+* @details Head is only written by the producer and Tail only by the consumer.\n
+*			A full ring makes the producer wait instead of dropping data,\n
+*			so the memory is bounded by BlockCount * BlockSize.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "ts_ring.h"
+
+/**
+* @brief		Initialize ring
+* @param[out]	ring		Ring
+* @param[in]	block_count	Number of blocks. Rounded up to a power of 2
+* @param[in]	block_size	Size of one block. Multiple of TS_RING_ALIGN for O_DIRECT
+* @return		bool		Result
+*/
+bool			ts_ring_init( TS_RING* ring, uint32_t block_count, uint32_t block_size )
+{
+	uint32_t	count = 2;
+	uint32_t	i;
+	void*		data;
+
+	memset( ring, 0, sizeof( TS_RING ) );
+	while( count < block_count ){
+		count *= 2;
+	}
+
+	ring->Blocks = malloc( ( size_t )count * sizeof( TS_RING_BLOCK ) );
+	if( NULL == ring->Blocks ){
+		return false;
+	}
+	if( 0 != posix_memalign( &data, TS_RING_ALIGN, ( size_t )count * block_size ) ){
+		free( ring->Blocks );
+		ring->Blocks = NULL;
+		return false;
+	}
+	ring->Data = data;
+	for( i = 0 ; i < count ; i++ ){
+		ring->Blocks[ i ].Length = 0;
+		ring->Blocks[ i ].Data = &ring->Data[ ( size_t )i * block_size ];
+	}
+	ring->BlockCount = count;
+	ring->BlockSize = block_size;
+
+	return true;
+}
+
+/**
+* @brief		Free ring
+* @param[in]	ring		Ring
+*/
+void			ts_ring_free( TS_RING* ring )
+{
+	free( ring->Data );
+	free( ring->Blocks );
+	memset( ring, 0, sizeof( TS_RING ) );
+}
+
+/**
+* @brief		Get the next free block ( producer )
+* @param[in]	ring		Ring
+* @return		TS_RING_BLOCK*	Block to fill. Waits while the ring is full
+*/
+TS_RING_BLOCK*	ts_ring_acquire( TS_RING* ring )
+{
+	uint64_t	head = ring->Head;
+	uint32_t	window;
+	bool		waited = false;
+
+	for( ;; ){
+		window = __atomic_load_n( &ring->Window, __ATOMIC_ACQUIRE );
+		if( ( 0 == window ) || ( ring->BlockCount < window ) ){
+			window = ring->BlockCount;
+		}
+		if( head - __atomic_load_n( &ring->Tail, __ATOMIC_ACQUIRE ) < window ){
+			break;
+		}
+		if( !waited ){
+			ring->FullWaits++;
+			waited = true;
+		}
+		usleep( TS_RING_WAIT_US );
+	}
+
+	return &ring->Blocks[ head & ( ring->BlockCount - 1 ) ];
+}
+
+/**
+* @brief		Hand the acquired block to the consumer ( producer )
+* @param[in]	ring		Ring
+*/
+void			ts_ring_publish( TS_RING* ring )
+{
+	uint64_t	used = ring->Head + 1 - __atomic_load_n( &ring->Tail, __ATOMIC_ACQUIRE );
+
+	if( used > ring->MaxUsed ){
+		ring->MaxUsed = used;
+	}
+	__atomic_store_n( &ring->Head, ring->Head + 1, __ATOMIC_RELEASE );
+}
+
+/**
+* @brief		Number of published blocks the consumer has not released ( producer )
+* @param[in]	ring		Ring
+* @return		uint32_t	Blocks in use
+*/
+uint32_t		ts_ring_used( const TS_RING* ring )
+{
+	return ( uint32_t )( ring->Head - __atomic_load_n( &ring->Tail, __ATOMIC_ACQUIRE ) );
+}
+
+/**
+* @brief		End of input ( producer )
+* @param[in]	ring		Ring
+*/
+void			ts_ring_close( TS_RING* ring )
+{
+	__atomic_store_n( &ring->Closed, true, __ATOMIC_RELEASE );
+}
+
+/**
+* @brief		Get the oldest published block ( consumer )
+* @param[in]	ring		Ring
+* @param[in]	wait		Wait until a block is published
+* @return		TS_RING_BLOCK*	Block. NULL if there is none and the ring is closed, or wait is false
+*/
+TS_RING_BLOCK*	ts_ring_peek( TS_RING* ring, bool wait )
+{
+	uint64_t	tail = ring->Tail;
+
+	while( __atomic_load_n( &ring->Head, __ATOMIC_ACQUIRE ) == tail ){
+		if( !wait ){
+			return NULL;
+		}
+		if( __atomic_load_n( &ring->Closed, __ATOMIC_ACQUIRE ) ){
+			// Closed is set after the last publish, check Head once more.
+			if( __atomic_load_n( &ring->Head, __ATOMIC_ACQUIRE ) == tail ){
+				return NULL;
+			}
+			break;
+		}
+		usleep( TS_RING_WAIT_US );
+	}
+
+	return &ring->Blocks[ tail & ( ring->BlockCount - 1 ) ];
+}
+
+/**
+* @brief		Give the peeked block back to the producer ( consumer )
+* @param[in]	ring		Ring
+* @details		A Window is doubled by every release until it covers the ring.
+*/
+void			ts_ring_release( TS_RING* ring )
+{
+	uint32_t	window = ring->Window;
+
+	if( ( 0 != window ) && ( window < ring->BlockCount ) ){
+		__atomic_store_n( &ring->Window, window * 2, __ATOMIC_RELEASE );
+	}
+	__atomic_store_n( &ring->Tail, ring->Tail + 1, __ATOMIC_RELEASE );
+}
+
+/**
+* @brief		Drop every block and reopen the ring
+* @param[in]	ring		Ring
+* @details		Only while there is no producer.
+*/
+void			ts_ring_reset( TS_RING* ring )
+{
+	ring->Head = 0;
+	ring->Tail = 0;
+	ring->Closed = false;
+}
@@ -0,0 +1,254 @@
+/**
+* @file ts_section.c
+* @brief PSI / SI section reassembly
+* @author sage
+* @date 2018/12/18
+* @details A section is collected until section_length is reached.\n
+*			A packet with payload_unit_start_indicator first completes the pending section\n
+*			with the bytes before pointer_field, then starts new sections until stuffing ( 0xFF ).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_crc32.h"
+#include "ts_section.h"
+
+static inline	void	ts_section_drop( TS_SECTION_FILTER* filter, TS_SECTION_BUFFER* buffer );
+static	void			ts_section_complete( TS_SECTION_FILTER* filter, uint16_t pid, TS_SECTION_BUFFER* buffer );
+static	uint32_t		ts_section_collect( TS_SECTION_FILTER* filter, uint16_t pid, TS_SECTION_BUFFER* buffer, const uint8_t* data, uint32_t size );
+
+/**
+* @brief		Discard the pending section
+* @param[in]	filter		Filter
+* @param[in]	buffer		PID state
+*/
+static inline	void	ts_section_drop( TS_SECTION_FILTER* filter, TS_SECTION_BUFFER* buffer )
+{
+	if( 0 < buffer->Length ){
+		buffer->Incomplete++;
+		filter->Incomplete++;
+	}
+	buffer->Length = 0;
+	buffer->Size = 0;
+}
+
+/**
+* @brief		CRC check of a section
+* @param[in]	section		Section
+* @param[in]	size		Size of the section
+* @return		bool		true if the CRC_32 is correct or the section has none
+* @details		Sections with section_syntax_indicator and the TOT carry a CRC_32.
+*/
+bool			ts_section_crc_ok( const uint8_t* section, uint32_t size )
+{
+	if( !TS_SECTION_SYNTAX( section ) && ( TABLE_ID_TOT != section[ 0 ] ) ){
+		return true;
+	}
+	if( TS_SECTION_HEADER_SIZE + TS_SECTION_CRC_SIZE > size ){
+		return false;
+	}
+
+	return 0 == ts_crc32( section, size, TS_CRC32_INIT );
+}
+
+/**
+* @brief		Deliver the collected section
+* @param[in]	filter		Filter
+* @param[in]	pid			PID
+* @param[in]	buffer		PID state holding a complete section
+*/
+static	void			ts_section_complete( TS_SECTION_FILTER* filter, uint16_t pid, TS_SECTION_BUFFER* buffer )
+{
+	uint32_t	size = buffer->Size;
+
+	buffer->Length = 0;
+	buffer->Size = 0;
+
+	if( !ts_section_crc_ok( buffer->Data, size ) ){
+		buffer->CrcErrors++;
+		filter->CrcErrors++;
+		return;
+	}
+	buffer->Sections++;
+	filter->Sections++;
+	if( NULL != filter->Handler ){
+		filter->Handler( filter->Context, pid, buffer->Data, size );
+	}
+}
+
+/**
+* @brief		Append payload bytes to the pending section
+* @param[in]	filter		Filter
+* @param[in]	pid			PID
+* @param[in]	buffer		PID state
+* @param[in]	data		Payload bytes
+* @param[in]	size		Number of bytes
+* @return		uint32_t	Used bytes. Less than size only when the section is completed
+*/
+static	uint32_t		ts_section_collect( TS_SECTION_FILTER* filter, uint16_t pid, TS_SECTION_BUFFER* buffer, const uint8_t* data, uint32_t size )
+{
+	uint32_t	done = 0;
+	uint32_t	copy;
+
+	while( done < size ){
+		if( TS_SECTION_HEADER_SIZE > buffer->Length ){
+			copy = TS_SECTION_HEADER_SIZE - buffer->Length;
+		}else{
+			copy = buffer->Size - buffer->Length;
+		}
+		if( size - done < copy ){
+			copy = size - done;
+		}
+		memcpy( &buffer->Data[ buffer->Length ], &data[ done ], copy );
+		buffer->Length += copy;
+		done += copy;
+
+		if( ( 0 == buffer->Size ) && ( TS_SECTION_HEADER_SIZE == buffer->Length ) ){
+			buffer->Size = TS_SECTION_HEADER_SIZE + TS_SECTION_LENGTH( buffer->Data );
+			if( TS_SECTION_SIZE_MAX < buffer->Size ){
+				ts_section_drop( filter, buffer );
+				return size;
+			}
+		}
+		if( ( 0 != buffer->Size ) && ( buffer->Size == buffer->Length ) ){
+			ts_section_complete( filter, pid, buffer );
+			break;
+		}
+	}
+
+	return done;
+}
+
+/**
+* @brief		Initialize filter
+* @param[out]	filter		Filter
+* @param[in]	handler		Called for every section. May be NULL to only count
+* @param[in]	context		Passed to handler
+*/
+void			ts_section_init( TS_SECTION_FILTER* filter, TS_SECTION_HANDLER handler, void* context )
+{
+	memset( filter, 0, sizeof( TS_SECTION_FILTER ) );
+	filter->Handler = handler;
+	filter->Context = context;
+}
+
+/**
+* @brief		Select PID
+* @param[in]	filter		Filter
+* @param[in]	pid			PID carrying sections
+* @return		bool		Result
+*/
+bool			ts_section_add_pid( TS_SECTION_FILTER* filter, uint16_t pid )
+{
+	pid &= 0x1FFF;
+	if( NULL == filter->Pid[ pid ] ){
+		filter->Pid[ pid ] = calloc( 1, sizeof( TS_SECTION_BUFFER ) );
+	}
+
+	return NULL != filter->Pid[ pid ];
+}
+
+/**
+* @brief		Process one TS packet
+* @param[in]	filter			Filter
+* @param[in]	ts_packet		TS packet
+* @param[in]	pid				PID
+* @param[in]	flags			TS_PKT_FLAG_*
+* @param[in]	cc				continuity_counter
+* @param[in]	payload_offset	Offset of payload in ts_packet
+*/
+void			ts_section_packet( TS_SECTION_FILTER* filter, const uint8_t* ts_packet, uint16_t pid, uint16_t flags, uint8_t cc, uint8_t payload_offset )
+{
+	TS_SECTION_BUFFER*	buffer = filter->Pid[ pid ];
+	const uint8_t*		data;
+	uint32_t			size;
+	uint32_t			pointer;
+
+	if(    ( NULL == buffer )
+		|| !( flags & TS_PKT_FLAG_PAYLOAD )
+		|| ( TS_PACKET_SIZE <= payload_offset ) ){
+		return;
+	}
+	if( flags & TS_PKT_FLAG_TEI ){
+		ts_section_drop( filter, buffer );
+		return;
+	}
+	if( buffer->HasCc ){
+		if( cc == buffer->LastCc ){
+			return;							// Duplicate packet
+		}
+		if( !( flags & TS_PKT_FLAG_DISCONTINUITY ) && ts_cc_error( buffer->LastCc, cc ) ){
+			ts_section_drop( filter, buffer );
+		}
+	}
+	buffer->HasCc = true;
+	buffer->LastCc = cc;
+
+	data = &ts_packet[ payload_offset ];
+	size = TS_PACKET_SIZE - payload_offset;
+
+	if( !( flags & TS_PKT_FLAG_PUSI ) ){
+		if( 0 < buffer->Length ){
+			ts_section_collect( filter, pid, buffer, data, size );
+		}
+		return;
+	}
+
+	pointer = data[ 0 ];
+	data++;
+	size--;
+	if( pointer >= size ){
+		ts_section_drop( filter, buffer );
+		return;
+	}
+	if( 0 < buffer->Length ){
+		ts_section_collect( filter, pid, buffer, data, pointer );
+		ts_section_drop( filter, buffer );		// Still pending if the section did not end at pointer_field
+	}
+	data += pointer;
+	size -= pointer;
+
+	while( ( 0 < size ) && ( TS_SECTION_STUFFING != data[ 0 ] ) ){
+		uint32_t	done = ts_section_collect( filter, pid, buffer, data, size );
+
+		data += done;
+		size -= done;
+	}
+}
+
+/**
+* @brief		Process decoded packets
+* @param[in]	filter		Filter
+* @param[in]	batch		Decoded packets
+*/
+void			ts_section_batch( TS_SECTION_FILTER* filter, const TS_PACKET_BATCH* batch )
+{
+	uint32_t	i;
+
+	for( i = 0 ; i < batch->Count ; i++ ){
+		if( NULL != filter->Pid[ batch->Pid[ i ] ] ){
+			ts_section_packet( filter, &batch->Packets[ i * TS_PACKET_SIZE ], batch->Pid[ i ],
+								batch->Flags[ i ], batch->ContinuityCounter[ i ], batch->PayloadOffset[ i ] );
+		}
+	}
+}
+
+/**
+* @brief		Free filter
+* @param[in]	filter		Filter
+*/
+void			ts_section_free( TS_SECTION_FILTER* filter )
+{
+	uint32_t	pid;
+
+	for( pid = 0 ; pid < 8192 ; pid++ ){
+		free( filter->Pid[ pid ] );
+		filter->Pid[ pid ] = NULL;
+	}
+}
@@ -0,0 +1,283 @@
+/**
+* @file ts_seek.c
+* @brief Time based seek without index
+* @author sage
+* @date 2018/10/30
+* @details Finds the position of a TOT time by bisection over the file.\n
+*			The first TOT of the file is paired with the PCR just before it,\n
+*			after that each probe only has to read up to the next PCR to know its time.\n
+*			The result is verified with a real TOT, so a PCR discontinuity can not make\n
+*			the seek land after the wanted time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_tot.h"
+#include "ts_seek.h"
+#include "ts_stats.h"
+
+#define PCR_CYCLE					( ( ( uint64_t )1 << 33 ) * 300 )
+#define SECOND_TICKS				( ( uint64_t )PCR_CLOCK_EXT )
+#define DATETIME_TO_TICKS(dt)		( ( ( uint64_t )TS_DATETIME_MJD( dt ) * 86400 + TS_DATETIME_SEC( dt ) ) * SECOND_TICKS )
+
+/**
+* @def		PCR_MARGIN_TICKS
+* @brief	TOT has a resolution of one second, keep PCR based probes this much before the target
+*/
+#define PCR_MARGIN_TICKS			( 2 * SECOND_TICKS )
+
+typedef struct {
+	TS_READER*			Reader;
+	TS_PACKET_BATCH*	Batch;
+	uint16_t			PcrPid;
+	uint64_t			RefPcr;
+	uint64_t			RefTicks;
+	uint32_t			ProbeCount;
+} TS_SEEK_CONTEXT;
+
+static	bool			ts_seek_reference( TS_SEEK_CONTEXT* ctx, uint64_t* tot_offset, uint64_t* tot_ticks );
+static	bool			ts_seek_probe( TS_SEEK_CONTEXT* ctx, uint64_t offset, uint64_t limit, bool tot_only, uint64_t* ticks );
+
+/**
+* @brief		Find the first TOT and the PCR paired with it
+* @param[in]	ctx			Context
+* @param[out]	tot_offset	Offset of the first TOT packet
+* @param[out]	tot_ticks	Time of the first TOT ( 27MHz )
+* @return		bool		false if there is no TOT
+*/
+static	bool			ts_seek_reference( TS_SEEK_CONTEXT* ctx, uint64_t* tot_offset, uint64_t* tot_ticks )
+{
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	uint32_t			n;
+	uint64_t			datetime;
+	uint64_t			scanned = 0;
+	bool				found_tot = false;
+	bool				found_pcr = false;
+
+	if( !ts_reader_seek( ctx->Reader, 0 ) ){
+		return false;
+	}
+	ctx->ProbeCount++;
+
+	while( 0 < ( read_count = ts_reader_next( ctx->Reader, &ts_buffer, TS_BATCH_PACKETS ) ) ){
+		uint64_t	offset = ts_reader_tell( ctx->Reader ) - ( uint64_t )read_count * TS_PACKET_SIZE;
+
+		ts_parse_batch( ts_buffer, read_count, ctx->Batch );
+		for( n = 0 ; n < read_count ; n++ ){
+			if( ctx->Batch->Flags[ n ] & TS_PKT_FLAG_PCR ){
+				if( PID_NULL == ctx->PcrPid ){
+					ctx->PcrPid = ctx->Batch->Pid[ n ];
+				}
+				if( ( ctx->PcrPid == ctx->Batch->Pid[ n ] ) && ( !found_tot || !found_pcr ) ){
+					ctx->RefPcr = ctx->Batch->Pcr[ n ];
+					found_pcr = true;
+				}
+			}
+			if(    !found_tot
+				&& ( PID_TOT == ctx->Batch->Pid[ n ] )
+				&& ts_tot_parse( &ts_buffer[ n * TS_PACKET_SIZE ], ctx->Batch->PayloadOffset[ n ], &datetime ) ){
+				found_tot = true;
+				*tot_offset = offset + ( uint64_t )n * TS_PACKET_SIZE;
+				*tot_ticks = DATETIME_TO_TICKS( datetime );
+				ctx->RefTicks = *tot_ticks;
+				TS_STATS_ADD( PacketsBeforeTot, scanned + n );
+			}
+			if( found_tot && found_pcr ){
+				return true;
+			}
+		}
+		scanned += read_count;
+	}
+
+	// No PCR at all, probes use TOT only.
+	ctx->PcrPid = PID_NULL;
+
+	return found_tot;
+}
+
+/**
+* @brief		Read the first time stamp at or after offset
+* @param[in]	ctx			Context
+* @param[in]	offset		Probe offset
+* @param[in]	limit		Maximum bytes to read
+* @param[in]	tot_only	Ignore PCR
+* @param[out]	ticks		Time ( 27MHz )
+* @return		bool		false if nothing was found within limit
+*/
+static	bool			ts_seek_probe( TS_SEEK_CONTEXT* ctx, uint64_t offset, uint64_t limit, bool tot_only, uint64_t* ticks )
+{
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	uint32_t			n;
+	uint64_t			datetime;
+
+	if( !ts_reader_seek( ctx->Reader, offset ) ){
+		return false;
+	}
+	ctx->ProbeCount++;
+
+	while( 0 < ( read_count = ts_reader_next( ctx->Reader, &ts_buffer, TS_BATCH_PACKETS ) ) ){
+		ts_parse_batch( ts_buffer, read_count, ctx->Batch );
+		for( n = 0 ; n < read_count ; n++ ){
+			if(    !tot_only
+				&& ( ctx->Batch->Flags[ n ] & TS_PKT_FLAG_PCR )
+				&& ( ctx->PcrPid == ctx->Batch->Pid[ n ] ) ){
+				*ticks = ctx->RefTicks + ( ctx->Batch->Pcr[ n ] + PCR_CYCLE - ctx->RefPcr ) % PCR_CYCLE;
+				return true;
+			}
+			if(    ( PID_TOT == ctx->Batch->Pid[ n ] )
+				&& ts_tot_parse( &ts_buffer[ n * TS_PACKET_SIZE ], ctx->Batch->PayloadOffset[ n ], &datetime ) ){
+				*ticks = DATETIME_TO_TICKS( datetime );
+				return true;
+			}
+		}
+		if( ts_reader_tell( ctx->Reader ) - offset > limit ){
+			break;
+		}
+	}
+
+	return false;
+}
+
+/**
+* @brief		Seek to the TOT time
+* @param[in]	reader		Seekable reader
+* @param[in]	datetime	TS_DATETIME( MJD, second of day )
+* @param[out]	probe_count	Number of probes. NULL if not needed
+* @return		bool		false if the reader can not seek or there is no TOT
+* @details		The reader is positioned before the first TOT at or after datetime,\n
+*				so that reading forward from there finds it.\n
+*				The number of probes is bounded by log2( file size / TS_SEEK_RANGE_BYTES ).
+*/
+bool			ts_tot_seek( TS_READER* reader, uint64_t datetime, uint32_t* probe_count )
+{
+	TS_SEEK_CONTEXT		ctx;
+	TS_STATS_PHASE		phase;
+	uint64_t			target = DATETIME_TO_TICKS( datetime );
+	uint64_t			low, high, mid, step;
+	uint64_t			bisected;
+	uint64_t			ref_offset = 0, ref_ticks = 0;
+	uint64_t			ticks;
+	bool				result = false;
+
+	if( !reader->Seekable || ( 0 == reader->FileSize ) ){
+		return false;
+	}
+
+	memset( &ctx, 0, sizeof( ctx ) );
+	ctx.Reader = reader;
+	ctx.PcrPid = PID_NULL;
+	ctx.Batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( NULL == ctx.Batch ){
+		return false;
+	}
+	phase = ts_stats_phase( TS_STATS_PHASE_SEEK );
+
+	if( !ts_seek_reference( &ctx, &ref_offset, &ref_ticks ) ){
+		goto end;
+	}
+
+	low = ref_offset;
+	if( ref_ticks < target ){
+		// Bisection. low always has a time stamp before target.
+		high = reader->FileSize;
+		while( high - low > TS_SEEK_RANGE_BYTES ){
+			mid = low + ( ( high - low ) / 2 / TS_PACKET_SIZE ) * TS_PACKET_SIZE;
+			if(    ts_seek_probe( &ctx, mid, TS_SEEK_PROBE_BYTES, PID_NULL == ctx.PcrPid, &ticks )
+				&& ( ticks + PCR_MARGIN_TICKS < target ) ){
+				low = mid;
+			}else{
+				high = mid;
+			}
+		}
+
+		// Verify with TOT. Step back while the TOT after low is already at or after target.
+		step = TS_SEEK_RANGE_BYTES;
+		bisected = low;
+		while(    ( low > ref_offset )
+			   && ts_seek_probe( &ctx, low, reader->FileSize, true, &ticks )
+			   && ( ticks >= target ) ){
+			low = ( low - ref_offset > step ) ? ( low - step ) : ref_offset;
+			step *= 2;
+		}
+		TS_STATS_ADD( SeekOvershootBytes, bisected - low );
+	}
+
+	result = ts_reader_seek( reader, low );
+
+end:
+	free( ctx.Batch );
+	if( NULL != probe_count ){
+		*probe_count = ctx.ProbeCount;
+	}
+	TS_STATS_ADD( SeekProbes, ctx.ProbeCount );
+	ts_stats_phase( phase );
+
+	return result;
+}
+
+/**
+* @brief		Find the first TOT at or after the TOT time
+* @param[in]	reader		Reader
+* @param[in]	datetime	TS_DATETIME( MJD, second of day )
+* @param[out]	offset		Offset of the TOT packet
+* @param[out]	tot_datetime	Time of the TOT packet
+* @return		bool		false if every TOT is before datetime
+* @details		The reader position is undefined after this call.
+*/
+bool			ts_tot_find( TS_READER* reader, uint64_t datetime, uint64_t* offset, uint64_t* tot_datetime )
+{
+	TS_PACKET_BATCH*	batch;
+	TS_STATS_PHASE		phase;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	uint32_t			n;
+	uint64_t			found;
+	uint64_t			landing;
+	uint64_t			scanned = 0;
+	bool				result = false;
+
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( NULL == batch ){
+		return false;
+	}
+
+	phase = ts_stats_phase( TS_STATS_PHASE_SEEK );
+	TS_STATS_ADD( TotSearches, 1 );
+	if( !ts_tot_seek( reader, datetime, NULL ) ){
+		ts_reader_seek( reader, 0 );
+	}
+	landing = ts_reader_tell( reader );
+
+	while( !result && ( 0 < ( read_count = ts_reader_next( reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+		uint64_t	position = ts_reader_tell( reader ) - ( uint64_t )read_count * TS_PACKET_SIZE;
+
+		ts_parse_batch( ts_buffer, read_count, batch );
+		for( n = 0 ; n < read_count ; n++ ){
+			if(    ( PID_TOT == batch->Pid[ n ] )
+				&& ts_tot_parse( &ts_buffer[ n * TS_PACKET_SIZE ], batch->PayloadOffset[ n ], &found )
+				&& ( datetime <= found ) ){
+				*offset = position + ( uint64_t )n * TS_PACKET_SIZE;
+				*tot_datetime = found;
+				TS_STATS_ADD( PacketsBeforeTot, scanned + n );
+				TS_STATS_ADD( SeekUndershootBytes, *offset - landing );
+				result = true;
+				break;
+			}
+		}
+		scanned += read_count;
+	}
+
+	free( batch );
+	ts_stats_phase( phase );
+
+	return result;
+}
@@ -0,0 +1,154 @@
+/**
+* @file ts_stats.c
+* @brief Run time counters and phase timers
+* @author sage
+* @date 2019/02/12
+* @details The report is one JSON object, so it can be collected by monitoring as it is.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "ts_stats.h"
+
+TS_STATS		TsStats;
+
+static	const char*		PhaseName[ TS_STATS_PHASE_MAX ] = {
+	"open",
+	"index",
+	"seek",
+	"scan",
+	"write",
+};
+
+static	uint64_t		ts_stats_now( void );
+static	void			ts_stats_put_string( FILE* fp, const char* str );
+
+/**
+* @brief		Monotonic time in ns
+*/
+static	uint64_t		ts_stats_now( void )
+{
+	struct timespec		ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ( uint64_t )ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+* @brief		Start counting. The open phase starts now
+*/
+void			ts_stats_enable( void )
+{
+	memset( &TsStats, 0, sizeof( TsStats ) );
+	TsStats.StartTime = ts_stats_now();
+	TsStats.PhaseStart = TsStats.StartTime;
+	TsStats.Phase = TS_STATS_PHASE_OPEN;
+	TsStats.Enabled = true;
+}
+
+/**
+* @brief		Change the current phase
+* @param[in]	phase			New phase
+* @return		TS_STATS_PHASE	Previous phase, to be restored by nested callers
+* @details		Only called from the main thread.
+*/
+TS_STATS_PHASE	ts_stats_phase( TS_STATS_PHASE phase )
+{
+	TS_STATS_PHASE	previous = TsStats.Phase;
+	uint64_t		now;
+
+	if( !TsStats.Enabled || ( phase == previous ) ){
+		return previous;
+	}
+	now = ts_stats_now();
+	TsStats.PhaseNs[ previous ] += now - TsStats.PhaseStart;
+	TsStats.PhaseStart = now;
+	TsStats.Phase = phase;
+
+	return previous;
+}
+
+/**
+* @brief		Write string as JSON string
+*/
+static	void			ts_stats_put_string( FILE* fp, const char* str )
+{
+	fputc( '"', fp );
+	for( ; '\0' != *str ; str++ ){
+		if( ( '"' == *str ) || ( '\\' == *str ) ){
+			fprintf( fp, "\\%c", *str );
+		}else if( 0x20 > ( uint8_t )*str ){
+			fprintf( fp, "\\u%04x", ( uint8_t )*str );
+		}else{
+			fputc( *str, fp );
+		}
+	}
+	fputc( '"', fp );
+}
+
+/**
+* @brief		Write the counters as one line of JSON
+* @param[in]	path		Output file, appended. NULL is stderr
+* @param[in]	tool		Tool name
+* @param[in]	input		Input file path
+* @return		bool		Result
+* @details		The current phase is closed first. Times are in ns.
+*/
+bool			ts_stats_report( const char* path, const char* tool, const char* input )
+{
+	FILE*		fp = stderr;
+	uint64_t	now;
+	uint32_t	i;
+	bool		result = true;
+
+	if( !TsStats.Enabled ){
+		return true;
+	}
+	now = ts_stats_now();
+	TsStats.PhaseNs[ TsStats.Phase ] += now - TsStats.PhaseStart;
+	TsStats.PhaseStart = now;
+
+	if( NULL != path ){
+		fp = fopen( path, "a" );
+		if( NULL == fp ){
+			return false;
+		}
+	}
+
+	fprintf( fp, "{\"tool\":" );
+	ts_stats_put_string( fp, tool );
+	fprintf( fp, ",\"input\":" );
+	ts_stats_put_string( fp, ( NULL != input ) ? input : "" );
+	fprintf( fp, ",\"wall_ns\":%lu", now - TsStats.StartTime );
+	fprintf( fp, ",\"bytes_read\":%lu", TsStats.BytesRead );
+	fprintf( fp, ",\"read_calls\":%lu", TsStats.ReadCalls );
+	fprintf( fp, ",\"read_syscall_bytes\":%lu", TsStats.ReadSyscallBytes );
+	fprintf( fp, ",\"seek_calls\":%lu", TsStats.SeekCalls );
+	fprintf( fp, ",\"lseek_calls\":%lu", TsStats.LseekCalls );
+	fprintf( fp, ",\"resyncs\":%lu", TsStats.Resyncs );
+	fprintf( fp, ",\"skipped_bytes\":%lu", TsStats.SkippedBytes );
+	fprintf( fp, ",\"tot_searches\":%lu", TsStats.TotSearches );
+	fprintf( fp, ",\"packets_before_tot\":%lu", TsStats.PacketsBeforeTot );
+	fprintf( fp, ",\"seek_probes\":%lu", TsStats.SeekProbes );
+	fprintf( fp, ",\"seek_overshoot_bytes\":%lu", TsStats.SeekOvershootBytes );
+	fprintf( fp, ",\"seek_undershoot_bytes\":%lu", TsStats.SeekUndershootBytes );
+	fprintf( fp, ",\"bytes_written\":%lu", TsStats.BytesWritten );
+	fprintf( fp, ",\"write_calls\":%lu", TsStats.WriteCalls );
+	fprintf( fp, ",\"phase_ns\":{" );
+	for( i = 0 ; i < TS_STATS_PHASE_MAX ; i++ ){
+		fprintf( fp, "%s\"%s\":%lu", ( 0 == i ) ? "" : ",", PhaseName[ i ], TsStats.PhaseNs[ i ] );
+	}
+	fprintf( fp, "}}\n" );
+
+	if( ( stderr != fp ) && ( 0 != fclose( fp ) ) ){
+		result = false;
+	}
+
+	return result;
+}
@@ -0,0 +1,168 @@
+/**
+* @file ts_sync.c
+* @brief TS sync byte scanner
+* @author sage
+* @date 2018/10/16
+* @details Finds the packet alignment by checking 0x47 at stride 188.\n
+*			16 ( SSE2 ) or 32 ( AVX2 ) candidate offsets are tested at once,\n
+*			the implementation is selected at runtime.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define TS_SYNC_X86		1
+#else
+#define TS_SYNC_X86		0
+#endif
+
+#include "ts.h"
+#include "ts_sync.h"
+
+typedef size_t ( *TS_SYNC_FIND_FUNC )( const uint8_t* buffer, size_t length, uint32_t window );
+
+static	size_t			ts_sync_find_scalar( const uint8_t* buffer, size_t start, size_t limit, uint32_t window );
+static	size_t			ts_sync_find_generic( const uint8_t* buffer, size_t length, uint32_t window );
+#if TS_SYNC_X86
+static	size_t			ts_sync_find_sse2( const uint8_t* buffer, size_t length, uint32_t window );
+static	size_t			ts_sync_find_avx2( const uint8_t* buffer, size_t length, uint32_t window );
+#endif
+static	size_t			ts_sync_find_dispatch( const uint8_t* buffer, size_t length, uint32_t window );
+
+static	TS_SYNC_FIND_FUNC	ts_sync_find_impl = ts_sync_find_dispatch;
+
+/**
+* @brief		Test candidate offsets one by one
+* @param[in]	buffer		Data
+* @param[in]	start		First candidate offset
+* @param[in]	limit		Last candidate offset + 1
+* @param[in]	window		Number of packets to check
+* @return		size_t		Offset. TS_SYNC_NOT_FOUND if not found
+*/
+static	size_t			ts_sync_find_scalar( const uint8_t* buffer, size_t start, size_t limit, uint32_t window )
+{
+	size_t		pos;
+	uint32_t	k;
+
+	for( pos = start ; pos < limit ; pos++ ){
+		if( TS_SYNC_BYTE != buffer[ pos ] ){
+			continue;
+		}
+		for( k = 1 ; k < window ; k++ ){
+			if( TS_SYNC_BYTE != buffer[ pos + k * TS_PACKET_SIZE ] ){
+				break;
+			}
+		}
+		if( k == window ){
+			return pos;
+		}
+	}
+
+	return TS_SYNC_NOT_FOUND;
+}
+
+/**
+* @brief		Portable implementation
+*/
+static	size_t			ts_sync_find_generic( const uint8_t* buffer, size_t length, uint32_t window )
+{
+	return ts_sync_find_scalar( buffer, 0, length - ( window - 1 ) * TS_PACKET_SIZE, window );
+}
+
+#if TS_SYNC_X86
+/**
+* @brief		SSE2 implementation
+*/
+static	size_t			ts_sync_find_sse2( const uint8_t* buffer, size_t length, uint32_t window )
+{
+	const __m128i	sync = _mm_set1_epi8( TS_SYNC_BYTE );
+	size_t			limit = length - ( window - 1 ) * TS_PACKET_SIZE;
+	size_t			pos;
+	uint32_t		k;
+	uint32_t		mask;
+
+	for( pos = 0 ; pos + 16 <= limit ; pos += 16 ){
+		mask = 0xFFFF;
+		for( k = 0 ; ( k < window ) && mask ; k++ ){
+			__m128i		v = _mm_loadu_si128( ( const __m128i* )&buffer[ pos + k * TS_PACKET_SIZE ] );
+			mask &= ( uint32_t )_mm_movemask_epi8( _mm_cmpeq_epi8( v, sync ) );
+		}
+		if( mask ){
+			return pos + __builtin_ctz( mask );
+		}
+	}
+
+	return ts_sync_find_scalar( buffer, pos, limit, window );
+}
+
+/**
+* @brief		AVX2 implementation
+*/
+__attribute__(( target( "avx2" ) ))
+static	size_t			ts_sync_find_avx2( const uint8_t* buffer, size_t length, uint32_t window )
+{
+	const __m256i	sync = _mm256_set1_epi8( TS_SYNC_BYTE );
+	size_t			limit = length - ( window - 1 ) * TS_PACKET_SIZE;
+	size_t			pos;
+	uint32_t		k;
+	uint32_t		mask;
+
+	for( pos = 0 ; pos + 32 <= limit ; pos += 32 ){
+		mask = 0xFFFFFFFF;
+		for( k = 0 ; ( k < window ) && mask ; k++ ){
+			__m256i		v = _mm256_loadu_si256( ( const __m256i* )&buffer[ pos + k * TS_PACKET_SIZE ] );
+			mask &= ( uint32_t )_mm256_movemask_epi8( _mm256_cmpeq_epi8( v, sync ) );
+		}
+		if( mask ){
+			return pos + __builtin_ctz( mask );
+		}
+	}
+
+	return ts_sync_find_scalar( buffer, pos, limit, window );
+}
+#endif
+
+/**
+* @brief		Select implementation on first call
+*/
+static	size_t			ts_sync_find_dispatch( const uint8_t* buffer, size_t length, uint32_t window )
+{
+	TS_SYNC_FIND_FUNC	impl = ts_sync_find_generic;
+
+#if TS_SYNC_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx2" ) ){
+		impl = ts_sync_find_avx2;
+	}else if( __builtin_cpu_supports( "sse2" ) ){
+		impl = ts_sync_find_sse2;
+	}
+#endif
+	ts_sync_find_impl = impl;
+
+	return impl( buffer, length, window );
+}
+
+/**
+* @brief		Find TS packet alignment
+* @param[in]	buffer		Data
+* @param[in]	length		Length of buffer
+* @param[in]	window		Number of consecutive packets which must start with 0x47
+* @return		size_t		Offset of the first aligned packet. TS_SYNC_NOT_FOUND if not found
+* @details		Only offsets followed by window packets inside the buffer are tested.
+*/
+size_t			ts_sync_find( const uint8_t* buffer, size_t length, uint32_t window )
+{
+	if( 0 == window ){
+		window = 1;
+	}
+	if( length < ( window - 1 ) * TS_PACKET_SIZE + 1 ){
+		return TS_SYNC_NOT_FOUND;
+	}
+
+	return ts_sync_find_impl( buffer, length, window );
+}
@@ -0,0 +1,352 @@
+/**
+* @file ts_timeline.c
+* @brief PCR time line
+* @author sage
+* @date 2018/11/27
+* @details Every PCR PID is followed. Points come from one master PID,\n
+*			when it stops the next PCR PID that is still running takes over.\n
+*			PCR wrap around is unwrapped. Across a discontinuity the new segment is\n
+*			placed at the time estimated from the average rate, so the time never goes back.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_timeline.h"
+
+#define PCR_CYCLE					( ( ( uint64_t )1 << 33 ) * 300 )
+
+static	bool			ts_timeline_add( TS_TIMELINE* timeline, uint64_t offset, uint64_t time );
+static	double			ts_timeline_rate( const TS_TIMELINE* timeline );
+static	uint64_t		ts_timeline_estimate( const TS_TIMELINE* timeline, uint64_t offset );
+static	bool			ts_timeline_pcr( TS_TIMELINE* timeline, uint16_t pid, uint64_t pcr, uint64_t offset, bool discontinuity );
+
+/**
+* @brief		Append point
+* @param[in,out]	timeline	Time line
+* @param[in]	offset		File offset
+* @param[in]	time		Time ( 27MHz )
+* @return		bool		false if out of memory
+*/
+static	bool			ts_timeline_add( TS_TIMELINE* timeline, uint64_t offset, uint64_t time )
+{
+	if( timeline->Count == timeline->Capacity ){
+		uint64_t			capacity = ( 0 == timeline->Capacity ) ? 4096 : timeline->Capacity * 2;
+		TS_TIMELINE_POINT*	points = realloc( timeline->Points, capacity * sizeof( TS_TIMELINE_POINT ) );
+
+		if( NULL == points ){
+			return false;
+		}
+		timeline->Points = points;
+		timeline->Capacity = capacity;
+	}
+
+	timeline->Points[ timeline->Count ].Offset = offset;
+	timeline->Points[ timeline->Count ].Time = time;
+	timeline->Count++;
+
+	return true;
+}
+
+/**
+* @brief		Average rate
+* @param[in]	timeline	Time line
+* @return		double		27MHz ticks per byte. 0 if unknown
+*/
+static	double			ts_timeline_rate( const TS_TIMELINE* timeline )
+{
+	const TS_TIMELINE_POINT*	first;
+	const TS_TIMELINE_POINT*	last;
+
+	if( 0 == timeline->Count ){
+		return 0.0;
+	}
+	first = &timeline->Points[ 0 ];
+	last = timeline->LastPending ? &timeline->Last : &timeline->Points[ timeline->Count - 1 ];
+	if( last->Offset <= first->Offset ){
+		return 0.0;
+	}
+
+	return ( double )( last->Time - first->Time ) / ( last->Offset - first->Offset );
+}
+
+/**
+* @brief		Estimate time of an offset after the last master PCR
+* @param[in]	timeline	Time line
+* @param[in]	offset		File offset
+* @return		uint64_t	Time ( 27MHz )
+*/
+static	uint64_t		ts_timeline_estimate( const TS_TIMELINE* timeline, uint64_t offset )
+{
+	if( ( 0 == timeline->Count ) || ( offset <= timeline->Last.Offset ) ){
+		return timeline->Last.Time;
+	}
+
+	return timeline->Last.Time + ( uint64_t )( ( offset - timeline->Last.Offset ) * ts_timeline_rate( timeline ) );
+}
+
+/**
+* @brief		Add one PCR
+* @param[in,out]	timeline	Time line
+* @param[in]	pid			PID
+* @param[in]	pcr			PCR ( 27MHz )
+* @param[in]	offset		File offset of the PCR packet
+* @param[in]	discontinuity	discontinuity_indicator
+* @return		bool		false if out of memory
+*/
+static	bool			ts_timeline_pcr( TS_TIMELINE* timeline, uint16_t pid, uint64_t pcr, uint64_t offset, bool discontinuity )
+{
+	TS_TIMELINE_PID*	state = &timeline->Pid[ pid ];
+	uint64_t			step;
+	uint64_t			time = 0;
+	bool				continuous = false;
+
+	if( state->Valid && !discontinuity ){
+		step = ( pcr + PCR_CYCLE - state->Pcr ) % PCR_CYCLE;
+		if( TS_TIMELINE_JUMP_TICKS >= step ){
+			time = state->Time + step;
+			continuous = true;
+		}
+	}
+	if( !continuous ){
+		time = ts_timeline_estimate( timeline, offset );
+	}
+	state->Pcr = pcr;
+	state->Time = time;
+	state->Offset = offset;
+	state->Valid = true;
+
+	if( PID_NULL == timeline->MasterPid ){
+		timeline->MasterPid = pid;
+	}else if( pid != timeline->MasterPid ){
+		// The master PID stopped ( e.g. program change ), follow this one.
+		if( time <= timeline->Last.Time + TS_TIMELINE_JUMP_TICKS ){
+			return true;
+		}
+		timeline->MasterPid = pid;
+		if( timeline->LastPending && !ts_timeline_add( timeline, timeline->Last.Offset, timeline->Last.Time ) ){
+			return false;
+		}
+		timeline->LastPending = false;
+	}
+
+	if( 0 == timeline->Count ){
+		timeline->Last.Offset = offset;
+		timeline->Last.Time = time;
+		return ts_timeline_add( timeline, offset, time );
+	}
+
+	if( !continuous || ( time < timeline->Last.Time ) ){
+		// Close the previous segment exactly at its last PCR.
+		if( timeline->LastPending && !ts_timeline_add( timeline, timeline->Last.Offset, timeline->Last.Time ) ){
+			return false;
+		}
+		if( time < timeline->Last.Time ){
+			time = timeline->Last.Time;
+		}
+		timeline->Discontinuities++;
+		timeline->LastPending = false;
+		timeline->Last.Offset = offset;
+		timeline->Last.Time = time;
+		return ts_timeline_add( timeline, offset, time );
+	}
+
+	timeline->Last.Offset = offset;
+	timeline->Last.Time = time;
+	if( TS_TIMELINE_INTERVAL_TICKS <= time - timeline->Points[ timeline->Count - 1 ].Time ){
+		timeline->LastPending = false;
+		return ts_timeline_add( timeline, offset, time );
+	}
+	timeline->LastPending = true;
+
+	return true;
+}
+
+/**
+* @brief		Initialize time line
+* @param[out]	timeline	Time line
+*/
+void			ts_timeline_init( TS_TIMELINE* timeline )
+{
+	memset( timeline, 0, sizeof( TS_TIMELINE ) );
+	timeline->MasterPid = PID_NULL;
+}
+
+/**
+* @brief		Add decoded packets
+* @param[in,out]	timeline	Time line
+* @param[in]	batch		Decoded packets
+* @param[in]	offset		File offset of the first packet in batch
+* @return		bool		false if out of memory
+*/
+bool			ts_timeline_batch( TS_TIMELINE* timeline, const TS_PACKET_BATCH* batch, uint64_t offset )
+{
+	uint32_t		i;
+
+	for( i = 0 ; i < batch->Count ; i++ ){
+		if(    ( batch->Flags[ i ] & TS_PKT_FLAG_PCR )
+			&& !ts_timeline_pcr( timeline, batch->Pid[ i ], batch->Pcr[ i ], offset + ( uint64_t )i * TS_PACKET_SIZE,
+								 ( batch->Flags[ i ] & TS_PKT_FLAG_DISCONTINUITY ) ? true : false ) ){
+			return false;
+		}
+	}
+	timeline->EndOffset = offset + ( uint64_t )batch->Count * TS_PACKET_SIZE;
+
+	return true;
+}
+
+/**
+* @brief		Close the time line
+* @param[in,out]	timeline	Time line
+* @param[in]	end_offset	End of the analyzed data
+* @return		bool		false if out of memory
+*/
+bool			ts_timeline_finish( TS_TIMELINE* timeline, uint64_t end_offset )
+{
+	timeline->EndOffset = end_offset;
+	if( timeline->LastPending ){
+		timeline->LastPending = false;
+		return ts_timeline_add( timeline, timeline->Last.Offset, timeline->Last.Time );
+	}
+
+	return true;
+}
+
+/**
+* @brief		Build time line of the whole TS file
+* @param[in]	ts_file		TS file path. "-" is stdin
+* @param[in]	mode		How the file is read. TS_READER_MODE_*
+* @param[out]	timeline	Time line. Free with ts_timeline_free()
+* @return		bool		Result
+*/
+bool			ts_timeline_build( const char* ts_file, TS_READER_MODE mode, TS_TIMELINE* timeline )
+{
+	TS_READER			reader;
+	TS_PACKET_BATCH*	batch;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	bool				result = true;
+
+	ts_timeline_init( timeline );
+
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( NULL == batch ){
+		return false;
+	}
+	if( !ts_reader_open( &reader, ts_file, mode ) ){
+		free( batch );
+		return false;
+	}
+
+	while( result && ( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+		ts_parse_batch( ts_buffer, read_count, batch );
+		result = ts_timeline_batch( timeline, batch, ts_reader_tell( &reader ) - ( uint64_t )read_count * TS_PACKET_SIZE );
+	}
+	if( result ){
+		result = ts_timeline_finish( timeline, ts_reader_tell( &reader ) );
+	}
+
+	ts_reader_close( &reader );
+	free( batch );
+
+	if( !result ){
+		ts_timeline_free( timeline );
+	}
+
+	return result;
+}
+
+/**
+* @brief		Free time line
+* @param[in]	timeline	Time line
+*/
+void			ts_timeline_free( TS_TIMELINE* timeline )
+{
+	free( timeline->Points );
+	timeline->Points = NULL;
+	timeline->Count = 0;
+	timeline->Capacity = 0;
+}
+
+/**
+* @brief		Time of a file offset
+* @param[in]	timeline	Time line
+* @param[in]	offset		File offset
+* @return		uint64_t	Time ( 27MHz ). Interpolated between points, extrapolated outside of them
+*/
+uint64_t		ts_timeline_time( const TS_TIMELINE* timeline, uint64_t offset )
+{
+	const TS_TIMELINE_POINT*	p = timeline->Points;
+	uint64_t					low = 0;
+	uint64_t					high = timeline->Count;
+	uint64_t					mid;
+	double						rate = ts_timeline_rate( timeline );
+
+	if( 0 == timeline->Count ){
+		return 0;
+	}
+	if( offset <= p[ 0 ].Offset ){
+		return 0;
+	}
+
+	// Last point at or before offset.
+	while( high - low > 1 ){
+		mid = low + ( high - low ) / 2;
+		if( p[ mid ].Offset <= offset ){
+			low = mid;
+		}else{
+			high = mid;
+		}
+	}
+	if( low + 1 < timeline->Count ){
+		rate = ( double )( p[ low + 1 ].Time - p[ low ].Time ) / ( p[ low + 1 ].Offset - p[ low ].Offset );
+	}
+
+	return p[ low ].Time + ( uint64_t )( ( offset - p[ low ].Offset ) * rate );
+}
+
+/**
+* @brief		File offset of a time
+* @param[in]	timeline	Time line
+* @param[in]	time		Time ( 27MHz )
+* @return		uint64_t	File offset, not packet aligned. Clipped to EndOffset
+*/
+uint64_t		ts_timeline_offset( const TS_TIMELINE* timeline, uint64_t time )
+{
+	const TS_TIMELINE_POINT*	p = timeline->Points;
+	uint64_t					low = 0;
+	uint64_t					high = timeline->Count;
+	uint64_t					mid;
+	uint64_t					offset;
+	double						rate = ts_timeline_rate( timeline );
+
+	if( ( 0 == timeline->Count ) || ( 0 == time ) ){
+		return 0;
+	}
+
+	// Last point at or before time. Equal times ( discontinuity ) resolve to the later segment.
+	while( high - low > 1 ){
+		mid = low + ( high - low ) / 2;
+		if( p[ mid ].Time <= time ){
+			low = mid;
+		}else{
+			high = mid;
+		}
+	}
+	if( ( low + 1 < timeline->Count ) && ( p[ low + 1 ].Time > p[ low ].Time ) ){
+		rate = ( double )( p[ low + 1 ].Time - p[ low ].Time ) / ( p[ low + 1 ].Offset - p[ low ].Offset );
+	}
+	if( 0.0 >= rate ){
+		return p[ low ].Offset;
+	}
+
+	offset = p[ low ].Offset + ( uint64_t )( ( time - p[ low ].Time ) / rate );
+
+	return ( offset < timeline->EndOffset ) ? offset : timeline->EndOffset;
+}
@@ -0,0 +1,297 @@
+/**
+* @file ts_tot.c
+* @brief TOT ( Time Offset Table ) parser and time index
+* @author sage
+* @date 2018/10/23
+* @details The index records every TOT with its byte offset.\n
+*			It is saved next to the TS file so that the full scan is done only once.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_section.h"
+#include "ts_index_file.h"
+#include "ts_tot.h"
+
+static inline	uint8_t		bcd_to_dec( uint8_t bcd );
+static	bool			ts_tot_index_add( TS_TOT_INDEX* index, uint64_t offset, uint64_t datetime );
+
+/**
+* @brief		BCD => DECIMAL converter
+* @param[in]	bcd			BCD
+* @return		uint8_t		Converted decimal
+* @details		This function convert DCB to decimal.\n
+* 				Example : 0x12 => 12
+*/
+static inline	uint8_t		bcd_to_dec( uint8_t bcd )
+{
+	uint8_t result = bcd & 0x0F;
+	
+	result += ( ( bcd & 0xF0 ) >> 4 ) * 10;
+	
+	return result;
+}
+
+/**
+* @brief		Parse TOT packet
+* @param[in]	ts_packet		TS packet of PID_TOT
+* @param[in]	payload_offset	Offset of payload in ts_packet
+* @param[out]	datetime		TS_DATETIME( MJD, second of day )
+* @return		bool			false if the packet does not start a TOT section or its CRC_32 is wrong
+* @details		A TOT continuing into the next packet ( long descriptor loop ) cannot be checked\n
+*				from one packet and is accepted as before. Use TS_SECTION_FILTER for those.
+*/
+bool			ts_tot_parse( const uint8_t* ts_packet, uint8_t payload_offset, uint64_t* datetime )
+{
+	const uint8_t*	section;
+	uint32_t		pos;
+	uint32_t		size;
+	uint16_t		mjd;
+	uint32_t		sec;
+	
+	if( !( ts_packet[ 1 ] & TS_START_IND_BIT ) || ( TS_PACKET_SIZE <= payload_offset ) ){
+		return false;
+	}
+	
+	pos = payload_offset + 1 + ts_packet[ payload_offset ];		// skip pointer_field
+	if( TS_PACKET_SIZE < pos + 8 ){
+		return false;
+	}
+	section = &ts_packet[ pos ];
+	if( TABLE_ID_TOT != section[ 0 ] ){
+		return false;
+	}
+	size = TS_SECTION_HEADER_SIZE + TS_SECTION_LENGTH( section );
+	if( ( TS_PACKET_SIZE >= pos + size ) && !ts_section_crc_ok( section, size ) ){
+		return false;
+	}
+	
+	mjd = ( ( uint16_t )section[ 3 ] << 8 ) | section[ 4 ];
+	sec  = bcd_to_dec( section[ 5 ] ) * 3600;
+	sec += bcd_to_dec( section[ 6 ] ) * 60;
+	sec += bcd_to_dec( section[ 7 ] );
+	
+	*datetime = TS_DATETIME( mjd, sec );
+	
+	return true;
+}
+
+/**
+* @brief		Convert TS_DATETIME to calendar date and time
+* @param[in]	datetime	TS_DATETIME( MJD, second of day )
+* @param[out]	tm			Date and time. tm_year is years since 1900, tm_mon starts from 0
+* @details		MJD conversion of ETSI EN 300 468 Annex C.
+*/
+void			ts_tot_datetime_to_tm( uint64_t datetime, struct tm* tm )
+{
+	uint32_t	mjd = TS_DATETIME_MJD( datetime );
+	uint32_t	sec = TS_DATETIME_SEC( datetime );
+	int			y, m, k;
+	
+	y = ( int )( ( mjd - 15078.2 ) / 365.25 );
+	m = ( int )( ( mjd - 14956.1 - ( int )( y * 365.25 ) ) / 30.6001 );
+	k = ( ( 14 == m ) || ( 15 == m ) ) ? 1 : 0;
+	
+	memset( tm, 0, sizeof( struct tm ) );
+	tm->tm_mday = mjd - 14956 - ( int )( y * 365.25 ) - ( int )( m * 30.6001 );
+	tm->tm_year = y + k;
+	tm->tm_mon = m - 1 - k * 12 - 1;
+	tm->tm_hour = sec / 3600;
+	tm->tm_min = ( sec / 60 ) % 60;
+	tm->tm_sec = sec % 60;
+}
+
+/**
+* @brief		Convert "YYYY/MM/DD-hh:mm:ss" to TS_DATETIME
+* @param[in]	str_datetime	String datetime ( 2018/01/02-09:00:00 )
+* @param[out]	datetime		TS_DATETIME( MJD, second of day )
+* @return		bool			false if a field is missing or out of range
+* @details		MJD conversion of ETSI EN 300 468 Annex C, in integers.
+*/
+bool			ts_tot_datetime_parse( const char* str_datetime, uint64_t* datetime )
+{
+	int			year, month, day;
+	int			hour, min, sec;
+	int			mjd;
+	
+	if( 6 != sscanf( str_datetime, "%d/%d/%d-%d:%d:%d", &year, &month, &day, &hour, &min, &sec ) ){
+		return false;
+	}
+	if(    ( 1900 > year ) || ( 1 > month ) || ( 12 < month ) || ( 1 > day ) || ( 31 < day )
+		|| ( 0 > hour ) || ( 23 < hour ) || ( 0 > min ) || ( 59 < min ) || ( 0 > sec ) || ( 59 < sec ) ){
+		return false;
+	}
+	
+	if( ( month == 1 ) || ( month == 2 ) ){
+		year = year - 1;
+		month = month + 12;
+	}
+	mjd = ( 1461 * year ) / 4 + ( year / 400 ) - ( year / 100 ) + ( 3059 * ( month - 2 ) ) / 100 + day - 678912;
+	if( 0xFFFF < mjd ){
+		return false;
+	}
+	*datetime = TS_DATETIME( mjd, hour * 3600 + min * 60 + sec );
+	
+	return true;
+}
+
+/**
+* @brief		Make index file path
+* @param[in]	ts_file		TS file path
+* @param[out]	index_file	Index file path
+* @param[in]	size		Size of index_file
+*/
+void			ts_tot_index_path( const char* ts_file, char* index_file, size_t size )
+{
+	snprintf( index_file, size, "%s%s", ts_file, TS_TOT_INDEX_SUFFIX );
+}
+
+/**
+* @brief		Append entry
+*/
+static	bool			ts_tot_index_add( TS_TOT_INDEX* index, uint64_t offset, uint64_t datetime )
+{
+	TS_TOT_ENTRY*	entry = ts_index_file_append( ( void** )&index->Entries, &index->Header.Count, &index->Capacity, sizeof( TS_TOT_ENTRY ) );
+	
+	if( NULL == entry ){
+		return false;
+	}
+	entry->Offset = offset;
+	entry->DateTime = datetime;
+	
+	return true;
+}
+
+/**
+* @brief		Build TOT index by scanning the whole TS file
+* @param[in]	ts_file		TS file path
+* @param[in]	mode		How the file is read. TS_READER_MODE_*
+* @param[out]	index		Index. Free with ts_tot_index_free()
+* @return		bool		Result
+*/
+bool			ts_tot_index_build( const char* ts_file, TS_READER_MODE mode, TS_TOT_INDEX* index )
+{
+	TS_READER			reader;
+	TS_PACKET_BATCH*	batch = NULL;
+	const uint8_t*		ts_buffer;
+	uint32_t			read_count;
+	uint64_t			offset;
+	uint64_t			datetime;
+	uint32_t			n;
+	bool				result = true;
+	
+	memset( index, 0, sizeof( TS_TOT_INDEX ) );
+	if( !ts_index_file_stamp( &index->Header, TS_TOT_INDEX_MAGIC, TS_TOT_INDEX_VERSION, ts_file ) ){
+		return false;
+	}
+	
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( NULL == batch ){
+		return false;
+	}
+	
+	if( !ts_reader_open( &reader, ts_file, mode ) ){
+		free( batch );
+		return false;
+	}
+	
+	while( result && ( 0 < ( read_count = ts_reader_next( &reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+		// The reader may have skipped corrupted bytes before this run.
+		offset = ts_reader_tell( &reader ) - ( uint64_t )read_count * TS_PACKET_SIZE;
+		
+		ts_parse_batch( ts_buffer, read_count, batch );
+		for( n = 0 ; n < batch->Count ; n++ ){
+			if( PID_TOT != batch->Pid[ n ] ){
+				continue;
+			}
+			if( ts_tot_parse( &ts_buffer[ n * TS_PACKET_SIZE ], batch->PayloadOffset[ n ], &datetime ) ){
+				if( !ts_tot_index_add( index, offset + ( uint64_t )n * TS_PACKET_SIZE, datetime ) ){
+					result = false;
+					break;
+				}
+			}
+		}
+	}
+	
+	ts_reader_close( &reader );
+	free( batch );
+	
+	if( !result ){
+		ts_tot_index_free( index );
+	}
+	
+	return result;
+}
+
+/**
+* @brief		Save TOT index
+* @param[in]	index_file	Index file path
+* @param[in]	index		Index
+* @return		bool		Result
+*/
+bool			ts_tot_index_save( const char* index_file, const TS_TOT_INDEX* index )
+{
+	return ts_index_file_save( index_file, &index->Header, sizeof( index->Header ), index->Entries, sizeof( TS_TOT_ENTRY ), index->Header.Count );
+}
+
+/**
+* @brief		Load TOT index
+* @param[in]	index_file	Index file path
+* @param[in]	ts_file		TS file path. The index is rejected if the TS file was changed after indexing
+* @param[out]	index		Index. Free with ts_tot_index_free()
+* @return		bool		false if there is no valid index
+*/
+bool			ts_tot_index_load( const char* index_file, const char* ts_file, TS_TOT_INDEX* index )
+{
+	memset( index, 0, sizeof( TS_TOT_INDEX ) );
+	if( !ts_index_file_load( index_file, ts_file, TS_TOT_INDEX_MAGIC, TS_TOT_INDEX_VERSION, &index->Header, sizeof( index->Header ),
+							 &index->Header.Count, ( void** )&index->Entries, sizeof( TS_TOT_ENTRY ) ) ){
+		ts_tot_index_free( index );
+		return false;
+	}
+	index->Capacity = index->Header.Count;
+	
+	return true;
+}
+
+/**
+* @brief		Free TOT index
+* @param[in]	index		Index
+*/
+void			ts_tot_index_free( TS_TOT_INDEX* index )
+{
+	free( index->Entries );
+	memset( index, 0, sizeof( TS_TOT_INDEX ) );
+}
+
+/**
+* @brief		Search the first TOT at or after datetime
+* @param[in]	index		Index
+* @param[in]	datetime	TS_DATETIME( MJD, second of day )
+* @return		int64_t		Entry number. -1 if every TOT is before datetime
+* @details		TOT times are expected to increase through the file.
+*/
+int64_t			ts_tot_index_search( const TS_TOT_INDEX* index, uint64_t datetime )
+{
+	uint64_t	low = 0;
+	uint64_t	high = index->Header.Count;
+	uint64_t	mid;
+	
+	while( low < high ){
+		mid = low + ( high - low ) / 2;
+		if( index->Entries[ mid ].DateTime < datetime ){
+			low = mid + 1;
+		}else{
+			high = mid;
+		}
+	}
+	
+	return ( low < index->Header.Count ) ? ( int64_t )low : -1;
+}
@@ -0,0 +1,354 @@
+/**
+* @file ts_trace.c
+* @brief Binary header trace
+* @author sage
+* @date 2018/11/20
+* @details The writer appends the columns of each decoded batch as they are,\n
+*			so writing a trace costs little more than parsing the file.\n
+*			The reader maps every column file, queries never touch the TS file.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_tot.h"
+#include "ts_trace.h"
+
+#define TRACE_HAS_CC				( 0x80 )
+
+static	const char*		ColumnSuffix[ TS_TRACE_COLUMN_MAX ] = {
+	".pid",
+	".flags",
+	".cc",
+	".offset",
+	".pcr",
+	".tot",
+};
+
+static	const size_t	ColumnWidth[ TS_TRACE_COLUMN_MAX ] = {
+	sizeof( uint16_t ),
+	sizeof( uint16_t ),
+	sizeof( uint8_t ),
+	sizeof( uint64_t ),
+	sizeof( TS_TRACE_PCR ),
+	sizeof( TS_TRACE_TOT ),
+};
+
+static	char*			ts_trace_path( const char* prefix, const char* suffix );
+
+/**
+* @brief		Make file path of prefix + suffix
+* @param[in]	prefix		Trace prefix
+* @param[in]	suffix		Suffix
+* @return		char*		File path. free() after use. NULL if out of memory
+*/
+static	char*			ts_trace_path( const char* prefix, const char* suffix )
+{
+	char*		path;
+
+	path = malloc( strlen( prefix ) + strlen( suffix ) + 1 );
+	if( NULL != path ){
+		strcpy( path, prefix );
+		strcat( path, suffix );
+	}
+
+	return path;
+}
+
+/**
+* @brief		Create trace files
+* @param[out]	writer		Writer
+* @param[in]	prefix		Trace prefix
+* @param[in]	ts_file		Traced TS file path. "-" is stdin
+* @return		bool		Result
+*/
+bool			ts_trace_create( TS_TRACE_WRITER* writer, const char* prefix, const char* ts_file )
+{
+	struct stat		st;
+	uint32_t		c;
+	char*			path;
+
+	memset( writer, 0, sizeof( TS_TRACE_WRITER ) );
+	memcpy( writer->Header.Magic, TS_TRACE_MAGIC, sizeof( writer->Header.Magic ) );
+	writer->Header.Version = TS_TRACE_VERSION;
+	if( ( 0 != strcmp( ts_file, "-" ) ) && ( 0 == stat( ts_file, &st ) ) ){
+		writer->Header.FileSize = st.st_size;
+		writer->Header.FileMtime = st.st_mtime;
+	}
+
+	writer->Prefix = strdup( prefix );
+	if( NULL == writer->Prefix ){
+		return false;
+	}
+
+	for( c = 0 ; c < TS_TRACE_COLUMN_MAX ; c++ ){
+		path = ts_trace_path( prefix, ColumnSuffix[ c ] );
+		if( NULL != path ){
+			writer->Fp[ c ] = fopen( path, "wb" );
+			free( path );
+		}
+		if( NULL == writer->Fp[ c ] ){
+			ts_trace_finish( writer );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+* @brief		Append decoded packets
+* @param[in,out]	writer	Writer
+* @param[in]	batch		Decoded packets. batch->Packets must still be valid
+* @param[in]	offset		File offset of the first packet in batch
+* @return		bool		false if write failed
+*/
+bool			ts_trace_write( TS_TRACE_WRITER* writer, const TS_PACKET_BATCH* batch, uint64_t offset )
+{
+	uint16_t		flags[ TS_BATCH_PACKETS ];
+	uint64_t		offsets[ TS_BATCH_PACKETS ];
+	TS_TRACE_PCR	pcr;
+	TS_TRACE_TOT	tot;
+	uint32_t		i;
+	uint32_t		count = batch->Count;
+
+	for( i = 0 ; i < count ; i++ ){
+		uint16_t	pid = batch->Pid[ i ];
+		uint8_t*	last_cc = &writer->LastCc[ pid ];
+
+		flags[ i ] = batch->Flags[ i ];
+		offsets[ i ] = offset + ( uint64_t )i * TS_PACKET_SIZE;
+
+		if( ( PID_NULL != pid ) && ( flags[ i ] & TS_PKT_FLAG_PAYLOAD ) ){
+			if(    ( *last_cc & TRACE_HAS_CC )
+				&& !( flags[ i ] & TS_PKT_FLAG_DISCONTINUITY )
+				&& ts_cc_error( *last_cc & 0x0F, batch->ContinuityCounter[ i ] ) ){
+				flags[ i ] |= TS_TRACE_FLAG_CC_ERROR;
+			}
+			*last_cc = TRACE_HAS_CC | batch->ContinuityCounter[ i ];
+		}
+
+		if( flags[ i ] & TS_PKT_FLAG_PCR ){
+			pcr.Packet = writer->Header.Packets + i;
+			pcr.Pcr = batch->Pcr[ i ];
+			if( 1 != fwrite( &pcr, sizeof( pcr ), 1, writer->Fp[ TS_TRACE_COLUMN_PCR ] ) ){
+				return false;
+			}
+			writer->Header.PcrCount++;
+		}
+
+		if(    ( PID_TOT == pid )
+			&& ts_tot_parse( &batch->Packets[ i * TS_PACKET_SIZE ], batch->PayloadOffset[ i ], &tot.DateTime ) ){
+			tot.Packet = writer->Header.Packets + i;
+			if( 1 != fwrite( &tot, sizeof( tot ), 1, writer->Fp[ TS_TRACE_COLUMN_TOT ] ) ){
+				return false;
+			}
+			writer->Header.TotCount++;
+		}
+	}
+
+	if(    ( count != fwrite( batch->Pid, sizeof( uint16_t ), count, writer->Fp[ TS_TRACE_COLUMN_PID ] ) )
+		|| ( count != fwrite( flags, sizeof( uint16_t ), count, writer->Fp[ TS_TRACE_COLUMN_FLAGS ] ) )
+		|| ( count != fwrite( batch->ContinuityCounter, sizeof( uint8_t ), count, writer->Fp[ TS_TRACE_COLUMN_CC ] ) )
+		|| ( count != fwrite( offsets, sizeof( uint64_t ), count, writer->Fp[ TS_TRACE_COLUMN_OFFSET ] ) ) ){
+		return false;
+	}
+	writer->Header.Packets += count;
+
+	return true;
+}
+
+/**
+* @brief		Close column files and write the header file
+* @param[in]	writer		Writer
+* @return		bool		Result
+* @details		The header file is written last, a trace without it is incomplete.
+*/
+bool			ts_trace_finish( TS_TRACE_WRITER* writer )
+{
+	FILE*		fp;
+	uint32_t	c;
+	char*		path;
+	bool		result = true;
+
+	for( c = 0 ; c < TS_TRACE_COLUMN_MAX ; c++ ){
+		if( NULL == writer->Fp[ c ] ){
+			result = false;
+		}else if( 0 != fclose( writer->Fp[ c ] ) ){
+			result = false;
+		}
+		writer->Fp[ c ] = NULL;
+	}
+
+	if( result && ( NULL != writer->Prefix ) ){
+		result = false;
+		path = ts_trace_path( writer->Prefix, TS_TRACE_SUFFIX );
+		if( NULL != path ){
+			fp = fopen( path, "wb" );
+			if( NULL != fp ){
+				result = ( 1 == fwrite( &writer->Header, sizeof( writer->Header ), 1, fp ) );
+				if( 0 != fclose( fp ) ){
+					result = false;
+				}
+			}
+			free( path );
+		}
+	}
+
+	free( writer->Prefix );
+	writer->Prefix = NULL;
+
+	return result;
+}
+
+/**
+* @brief		Open trace
+* @param[out]	trace		Trace. Close with ts_trace_close()
+* @param[in]	prefix		Trace prefix
+* @return		bool		false if the trace is missing or incomplete
+*/
+bool			ts_trace_open( TS_TRACE* trace, const char* prefix )
+{
+	FILE*		fp;
+	char*		path;
+	uint32_t	c;
+	uint64_t	rows;
+	int			fd;
+	struct stat	st;
+	bool		result = false;
+
+	memset( trace, 0, sizeof( TS_TRACE ) );
+
+	path = ts_trace_path( prefix, TS_TRACE_SUFFIX );
+	if( NULL == path ){
+		return false;
+	}
+	fp = fopen( path, "rb" );
+	free( path );
+	if( NULL == fp ){
+		return false;
+	}
+	if(    ( 1 == fread( &trace->Header, sizeof( trace->Header ), 1, fp ) )
+		&& ( 0 == memcmp( trace->Header.Magic, TS_TRACE_MAGIC, sizeof( trace->Header.Magic ) ) )
+		&& ( TS_TRACE_VERSION == trace->Header.Version ) ){
+		result = true;
+	}
+	fclose( fp );
+
+	for( c = 0 ; result && ( c < TS_TRACE_COLUMN_MAX ) ; c++ ){
+		rows = ( TS_TRACE_COLUMN_PCR == c ) ? trace->Header.PcrCount :
+			   ( TS_TRACE_COLUMN_TOT == c ) ? trace->Header.TotCount : trace->Header.Packets;
+
+		result = false;
+		path = ts_trace_path( prefix, ColumnSuffix[ c ] );
+		if( NULL == path ){
+			break;
+		}
+		fd = open( path, O_RDONLY );
+		free( path );
+		if( 0 > fd ){
+			break;
+		}
+		if( ( 0 == fstat( fd, &st ) ) && ( ( uint64_t )st.st_size == rows * ColumnWidth[ c ] ) ){
+			result = true;
+			if( 0 < st.st_size ){
+				trace->Map[ c ] = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+				if( MAP_FAILED == trace->Map[ c ] ){
+					trace->Map[ c ] = NULL;
+					result = false;
+				}else{
+					trace->MapSize[ c ] = st.st_size;
+				}
+			}
+		}
+		close( fd );
+	}
+
+	if( !result ){
+		ts_trace_close( trace );
+		return false;
+	}
+
+	trace->Pid		= trace->Map[ TS_TRACE_COLUMN_PID ];
+	trace->Flags	= trace->Map[ TS_TRACE_COLUMN_FLAGS ];
+	trace->Cc		= trace->Map[ TS_TRACE_COLUMN_CC ];
+	trace->Offset	= trace->Map[ TS_TRACE_COLUMN_OFFSET ];
+	trace->Pcr		= trace->Map[ TS_TRACE_COLUMN_PCR ];
+	trace->Tot		= trace->Map[ TS_TRACE_COLUMN_TOT ];
+
+	return true;
+}
+
+/**
+* @brief		Close trace
+* @param[in]	trace		Trace
+*/
+void			ts_trace_close( TS_TRACE* trace )
+{
+	uint32_t	c;
+
+	for( c = 0 ; c < TS_TRACE_COLUMN_MAX ; c++ ){
+		if( NULL != trace->Map[ c ] ){
+			munmap( trace->Map[ c ], trace->MapSize[ c ] );
+		}
+	}
+	memset( trace, 0, sizeof( TS_TRACE ) );
+}
+
+/**
+* @brief		Search the first TOT at or after datetime
+* @param[in]	trace		Trace
+* @param[in]	datetime	TS_DATETIME( MJD, second of day )
+* @return		uint64_t	Packet number of the TOT. Header.Packets if every TOT is before datetime
+*/
+uint64_t		ts_trace_tot_search( const TS_TRACE* trace, uint64_t datetime )
+{
+	uint64_t	low = 0;
+	uint64_t	high = trace->Header.TotCount;
+	uint64_t	mid;
+
+	while( low < high ){
+		mid = low + ( high - low ) / 2;
+		if( trace->Tot[ mid ].DateTime < datetime ){
+			low = mid + 1;
+		}else{
+			high = mid;
+		}
+	}
+
+	return ( low < trace->Header.TotCount ) ? trace->Tot[ low ].Packet : trace->Header.Packets;
+}
+
+/**
+* @brief		Search the first PCR at or after packet
+* @param[in]	trace		Trace
+* @param[in]	packet		Packet number
+* @return		uint64_t	Entry number of the PCR column. Header.PcrCount if there is none
+*/
+uint64_t		ts_trace_pcr_search( const TS_TRACE* trace, uint64_t packet )
+{
+	uint64_t	low = 0;
+	uint64_t	high = trace->Header.PcrCount;
+	uint64_t	mid;
+
+	while( low < high ){
+		mid = low + ( high - low ) / 2;
+		if( trace->Pcr[ mid ].Packet < packet ){
+			low = mid + 1;
+		}else{
+			high = mid;
+		}
+	}
+
+	return low;
+}
@@ -0,0 +1,214 @@
+/**
+* @file ts_writer.c
+* @brief Block writer of output files
+* @author sage
+* @date 2019/01/29
+* @details The ring and the thread are made by the first write, so outputs which are opened\n
+*			but never written ( ranges waiting for their TOT ) cost nothing.\n
+*			Without a thread the same block is written in place when it is full.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "ts_ring.h"
+#include "ts_writer.h"
+#include "ts_stats.h"
+
+static	bool			ts_writer_write_all( int fd, const uint8_t* data, size_t size );
+static	void*			ts_writer_thread( void* arg );
+static	bool			ts_writer_start( TS_WRITER* writer );
+static	void			ts_writer_submit( TS_WRITER* writer );
+
+/**
+* @brief		write() until every byte is written
+*/
+static	bool			ts_writer_write_all( int fd, const uint8_t* data, size_t size )
+{
+	ssize_t		written;
+
+	while( 0 < size ){
+		written = write( fd, data, size );
+		TS_STATS_ADD( WriteCalls, 1 );
+		if( 0 < written ){
+			TS_STATS_ADD( BytesWritten, written );
+			data += written;
+			size -= written;
+		}else if( ( 0 > written ) && ( EINTR == errno ) ){
+			continue;
+		}else{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+* @brief		Writer thread
+* @param[in]	arg			TS_WRITER
+* @details		Blocks after a write error are dropped, so the producer never waits forever.
+*/
+static	void*			ts_writer_thread( void* arg )
+{
+	TS_WRITER*		writer = arg;
+	TS_RING_BLOCK*	block;
+
+	while( NULL != ( block = ts_ring_peek( &writer->Ring, true ) ) ){
+		if(    !__atomic_load_n( &writer->Error, __ATOMIC_ACQUIRE )
+			&& !ts_writer_write_all( writer->Fd, block->Data, block->Length ) ){
+			__atomic_store_n( &writer->Error, true, __ATOMIC_RELEASE );
+		}
+		ts_ring_release( &writer->Ring );
+	}
+
+	return NULL;
+}
+
+/**
+* @brief		Make the ring ( and the thread ) on the first write
+*/
+static	bool			ts_writer_start( TS_WRITER* writer )
+{
+	if( !ts_ring_init( &writer->Ring, writer->Threaded ? TS_WRITER_BLOCKS : 1, TS_WRITER_BLOCK_SIZE ) ){
+		return false;
+	}
+	if( writer->Threaded ){
+		if( 0 != pthread_create( &writer->Thread, NULL, ts_writer_thread, writer ) ){
+			ts_ring_free( &writer->Ring );
+			return false;
+		}
+		writer->Started = true;
+	}
+
+	return true;
+}
+
+/**
+* @brief		Write the filled block, or hand it to the thread
+*/
+static	void			ts_writer_submit( TS_WRITER* writer )
+{
+	if( writer->Threaded ){
+		ts_ring_publish( &writer->Ring );
+		writer->Block = NULL;
+	}else{
+		if( !ts_writer_write_all( writer->Fd, writer->Block->Data, writer->Block->Length ) ){
+			writer->Error = true;
+		}
+		writer->Block->Length = 0;
+	}
+}
+
+/**
+* @brief		Open output file
+* @param[out]	writer		Writer
+* @param[in]	path		Output file path. Created or truncated
+* @param[in]	threaded	Write blocks from a writer thread
+* @return		bool		Result
+*/
+bool			ts_writer_open( TS_WRITER* writer, const char* path, bool threaded )
+{
+	memset( writer, 0, sizeof( TS_WRITER ) );
+	writer->Threaded = threaded;
+	writer->Fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+
+	return ( 0 <= writer->Fd );
+}
+
+/**
+* @brief		Write data
+* @param[in]	writer		Writer
+* @param[in]	data		Data
+* @param[in]	size		Size of data
+* @return		bool		false if a previous write failed
+*/
+bool			ts_writer_write( TS_WRITER* writer, const void* data, size_t size )
+{
+	const uint8_t*	pos = data;
+	size_t			copy;
+
+	if( ( NULL == writer->Ring.Blocks ) && !ts_writer_start( writer ) ){
+		writer->Error = true;
+		return false;
+	}
+
+	writer->Bytes += size;
+	while( 0 < size ){
+		if( NULL == writer->Block ){
+			writer->Block = ts_ring_acquire( &writer->Ring );
+			writer->Block->Length = 0;
+		}
+		copy = writer->Ring.BlockSize - writer->Block->Length;
+		if( copy > size ){
+			copy = size;
+		}
+		memcpy( &writer->Block->Data[ writer->Block->Length ], pos, copy );
+		writer->Block->Length += copy;
+		pos += copy;
+		size -= copy;
+		if( writer->Block->Length == writer->Ring.BlockSize ){
+			ts_writer_submit( writer );
+		}
+	}
+
+	return !__atomic_load_n( &writer->Error, __ATOMIC_ACQUIRE );
+}
+
+/**
+* @brief		Write every buffered byte to the file
+* @param[in]	writer		Writer
+* @return		bool		false if a write failed
+* @details		Waits for the writer thread. The file descriptor can then be written directly.
+*/
+bool			ts_writer_flush( TS_WRITER* writer )
+{
+	if( ( NULL != writer->Block ) && ( 0 < writer->Block->Length ) ){
+		ts_writer_submit( writer );
+	}
+	if( writer->Started ){
+		while( __atomic_load_n( &writer->Ring.Tail, __ATOMIC_ACQUIRE ) != writer->Ring.Head ){
+			usleep( TS_RING_WAIT_US );
+		}
+	}
+
+	return !__atomic_load_n( &writer->Error, __ATOMIC_ACQUIRE );
+}
+
+/**
+* @brief		Flush, stop the thread and close the file
+* @param[in]	writer		Writer
+* @return		bool		false if a write or close failed
+*/
+bool			ts_writer_close( TS_WRITER* writer )
+{
+	bool		result = true;
+
+	if( 0 > writer->Fd ){
+		return true;
+	}
+
+	result = ts_writer_flush( writer );
+	if( writer->Started ){
+		ts_ring_close( &writer->Ring );
+		pthread_join( writer->Thread, NULL );
+		writer->Started = false;
+	}
+	if( NULL != writer->Ring.Blocks ){
+		ts_ring_free( &writer->Ring );
+	}
+	writer->Block = NULL;
+	if( 0 != close( writer->Fd ) ){
+		result = false;
+	}
+	writer->Fd = -1;
+
+	return result;
+}
@@ -0,0 +1,189 @@
+/**
+* @file ts_trace_query.c
+* @brief Query header trace.
+* @author sage
+* @date 2018/11/20
+* @details Filters the packets of a header trace ( ts_base -T ) by PID, TOT time range and error flags.\n
+*			Only the memory-mapped trace columns are read, the TS file is not needed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "ts.h"
+#include "ts_packet.h"
+#include "ts_tot.h"
+#include "ts_trace.h"
+
+/**
+* @def		ERROR_FLAGS
+* @brief	Flags selected by -E
+*/
+#define ERROR_FLAGS				( TS_PKT_FLAG_TEI | TS_TRACE_FLAG_CC_ERROR )
+
+struct {
+	bool		SelectPid;				// -p was given
+	uint8_t		Pid[ 8192 ];			// Selected PIDs
+	uint64_t	StartDateTime;
+	uint64_t	EndDateTime;
+	bool		HasStart;
+	bool		HasEnd;
+	bool		ErrorOnly;				// Only packets with ERROR_FLAGS
+	bool		CountOnly;				// Print number of matched packets only
+} Options;
+
+
+static	bool			query( const char* prefix );
+static	void			show_help( void );
+
+/**
+* @brief		Print matched packets
+* @param[in]	prefix			Trace prefix
+* @return		bool			Result
+*/
+static	bool			query( const char* prefix )
+{
+	TS_TRACE		trace;
+	uint64_t		start = 0;
+	uint64_t		end;
+	uint64_t		packet;
+	uint64_t		pcr;
+	uint64_t		matched = 0;
+
+	if( !ts_trace_open( &trace, prefix ) ){
+		printf( "Trace open error. %s%s\n", prefix, TS_TRACE_SUFFIX );
+		return false;
+	}
+
+	end = trace.Header.Packets;
+	if( Options.HasStart ){
+		start = ts_trace_tot_search( &trace, Options.StartDateTime );
+	}
+	if( Options.HasEnd ){
+		// Up to the TOT after the end time, same as ts_tot_spliter.
+		end = ts_trace_tot_search( &trace, Options.EndDateTime + 1 );
+	}
+	if( end < start ){
+		// End time before the start time matches nothing.
+		end = start;
+	}
+	pcr = ts_trace_pcr_search( &trace, start );
+
+	if( !Options.CountOnly ){
+		printf( "Packet,Offset,PID,Flags,CC,PCR\n" );
+	}
+	for( packet = start ; packet < end ; packet++ ){
+		if( Options.SelectPid && !Options.Pid[ trace.Pid[ packet ] ] ){
+			continue;
+		}
+		if( Options.ErrorOnly && !( trace.Flags[ packet ] & ERROR_FLAGS ) ){
+			continue;
+		}
+		matched++;
+		if( Options.CountOnly ){
+			continue;
+		}
+
+		printf( "%lu,%lu,0x%04X,0x%04X,%u,", packet, trace.Offset[ packet ], trace.Pid[ packet ], trace.Flags[ packet ], trace.Cc[ packet ] );
+		if( trace.Flags[ packet ] & TS_PKT_FLAG_PCR ){
+			while( ( pcr < trace.Header.PcrCount ) && ( trace.Pcr[ pcr ].Packet < packet ) ){
+				pcr++;
+			}
+			if( ( pcr < trace.Header.PcrCount ) && ( trace.Pcr[ pcr ].Packet == packet ) ){
+				printf( "%lu\n", trace.Pcr[ pcr ].Pcr );
+				continue;
+			}
+		}
+		printf( "-\n" );
+	}
+
+	if( Options.CountOnly ){
+		printf( "Matched packets = %lu / %lu\n", matched, end - start );
+	}
+
+	ts_trace_close( &trace );
+
+	return true;
+}
+
+/**
+* @brief		Show help
+*/
+static	void			show_help( void )
+{
+	printf( " -i\tTrace prefix ( ts_base -T ).\n" );
+	printf( " -p\tPID. Repeat for several PIDs (default = all).\n" );
+	printf( " -s\tStart Date time.(exp 2018/01/02-09:00:00)\n" );
+	printf( " -e\tEnd Date time.(exp 2018/01/02-09:15:00)\n" );
+	printf( " -E\tOnly packets with TEI or continuity counter error. Resynced bytes are not in the trace.\n" );
+	printf( " -c\tPrint the number of matched packets only.\n" );
+	printf( " -h\tShow Help.\n" );
+}
+
+/**
+* @brief		Main
+*/
+int						main( int args, char* argc[] )
+{
+	char*				prefix = NULL;
+	long				pid;
+	char				ch;
+
+	memset( &Options, 0, sizeof( Options ) );
+
+	while( (ch = getopt( args, argc, "i:p:s:e:Ech") ) != -1 ){
+		if( ch == 255 ){
+			break;
+		}
+		switch( ch ){
+			case 'i':
+				prefix = optarg;
+				break;
+			case 'p':
+				pid = strtol( optarg, NULL, 0 );
+				if( ( 0 > pid ) || ( PID_NULL < pid ) ){
+					printf( "Invalid PID. %s\n", optarg );
+					return -1;
+				}
+				Options.Pid[ pid ] = true;
+				Options.SelectPid = true;
+				break;
+			case 's':
+				if( !ts_tot_datetime_parse( optarg, &Options.StartDateTime ) ){
+					printf( "Invalid Start Datetime. %s\n", optarg );
+					return -1;
+				}
+				Options.HasStart = true;
+				break;
+			case 'e':
+				if( !ts_tot_datetime_parse( optarg, &Options.EndDateTime ) ){
+					printf( "Invalid End Datetime. %s\n", optarg );
+					return -1;
+				}
+				Options.HasEnd = true;
+				break;
+			case 'E':
+				Options.ErrorOnly = true;
+				break;
+			case 'c':
+				Options.CountOnly = true;
+				break;
+			case 'h':
+			default:
+				show_help();
+				return 0;
+				break;
+		}
+	}
+
+	if( NULL == prefix ){
+		printf( "Please input trace prefix. -i prefix \n" );
+		return -1;
+	}
+
+	return query( prefix ) ? 0 : -1;
+}
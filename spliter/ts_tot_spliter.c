@@ -12,9 +12,31 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
-#include <math.h>
+#include <getopt.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "ts.h"
+#include "ts_packet.h"
+#include "ts_reader.h"
+#include "ts_tot.h"
+#include "ts_seek.h"
+#include "ts_rap.h"
+#include "ts_restamp.h"
+#include "ts_pid_filter.h"
+#include "ts_output.h"
+#include "ts_writer.h"
+#include "ts_live.h"
+#include "ts_stats.h"
+#include "ts_index_cache.h"
 
 #define	DEBUG	0
 #if _DEBUG
@@ -25,294 +47,1298 @@
 
 
 
-/**
-* @def		BIT_RATE_COUNT_PCR
-* @brief	Define the number of PCRs used for calculating the bit rate
-*/
-#define BIT_RATE_COUNT_PCR		( 100 )
-
 typedef struct{
 	uint64_t		DateTime;
 	uint16_t		MJD;
 	uint32_t		Time;
 } ST_DATETIME;
 
-inline	uint8_t			bcd_to_dec( uint8_t bcd );
-static	double			ts_calc_bitrate( const char* ts_file );
-static	bool			ts_split( const char* in_filename, const char* out_filename, ST_DATETIME* start, ST_DATETIME* end );
-static	bool			get_datetime( char* str_datetime, ST_DATETIME* st_datetime );
+typedef struct{
+	ST_DATETIME		Start;
+	ST_DATETIME		End;
+	char*			OutFilename;
+	TS_WRITER		Writer;
+	bool			Writing;
+	bool			Finished;
+	uint64_t		TotalPacket;
+	uint64_t		DroppedPacket;			// Not written by the PID filter
+	uint64_t		CopiedBytes;			// Moved by ts_copy_range(), packets are not counted
+	TS_RESTAMP		Restamp;
+} ST_SPLIT_RANGE;
+
+/**
+* @def		MAX_RANGE_OPTIONS
+* @brief	Maximum number of -s/-e/-o options. Use a schedule file for more ranges
+*/
+#define MAX_RANGE_OPTIONS		( 256 )
+
+/**
+* @def		LIVE_FILENAME_FORMAT
+* @brief	Rotated file name. Prefix and the TOT time of the start of the period
+*/
+#define LIVE_FILENAME_FORMAT	"%s-%04d%02d%02d-%02d%02d%02d.ts"
+
+/**
+* @def		DAEMON_WORKERS
+* @brief	Default number of daemon worker threads ( -w )
+*/
+#define DAEMON_WORKERS			( 4 )
+
+/**
+* @def		DAEMON_CACHE_ENTRIES
+* @brief	Default number of recordings whose indexes the daemon keeps ( -c )
+*/
+#define DAEMON_CACHE_ENTRIES	( 16 )
+
+/**
+* @def		DAEMON_CONNECTIONS
+* @brief	Open client connections. More are refused with "ERROR busy"
+*/
+#define DAEMON_CONNECTIONS		( 64 )
+
+/**
+* @def		DAEMON_LINE_SIZE
+* @brief	Longest request line
+*/
+#define DAEMON_LINE_SIZE		( 8192 )
+
+/**
+* @def		DAEMON_POLL_MS
+* @brief	poll() timeout of the daemon. Bounds the delay of a stop signal arriving just before poll()
+*/
+#define DAEMON_POLL_MS			( 1000 )
+
+/**
+* @def		OPTION_STATS
+* @brief	getopt_long() value of --stats
+*/
+#define OPTION_STATS			( 0x100 )
+
+/**
+* @def		OPTION_NO_CACHE
+* @brief	getopt_long() value of --no-cache
+*/
+#define OPTION_NO_CACHE			( 0x101 )
+
+static	const struct option	LongOptions[] = {
+	{ "stats",		optional_argument,	NULL,	OPTION_STATS },
+	{ "no-cache",	no_argument,		NULL,	OPTION_NO_CACHE },
+	{ NULL,			0,					NULL,	0 },
+};
+
+typedef struct{
+	int					Fd;							// -1 when the slot is free
+	bool				Busy;						// Request is queued or served by a worker
+	bool				Eof;						// Client closed its side
+	size_t				Length;						// Received bytes in Buffer
+	char				Buffer[ DAEMON_LINE_SIZE ];
+	char				Request[ DAEMON_LINE_SIZE + 1 ];	// Line served by a worker
+} ST_SPLIT_CONNECTION;
+
+typedef struct{
+	TS_INDEX_CACHE		Cache;
+	pthread_mutex_t		Lock;
+	pthread_cond_t		Queued;
+	ST_SPLIT_CONNECTION*	Queue[ DAEMON_CONNECTIONS ];	// Connections with a request, one request each
+	uint32_t			QueueHead;
+	uint32_t			QueueCount;
+	bool				Stopping;
+	int					Wake[ 2 ];					// Pipe. A worker writes a byte when it answered a request
+	bool				Snap;
+	bool				Restamp;
+	bool				Threaded;
+	TS_READER_MODE		Mode;						// How the recordings are read
+	TS_PID_FILTER*		Filter;						// Shared by the workers, read only. NULL writes every PID
+} ST_SPLIT_DAEMON;
+
+static	TS_LIVE*		LiveInput = NULL;
+static	volatile sig_atomic_t	DaemonStop = 0;
+
+static	bool			ts_split( const char* in_filename, TS_READER_MODE mode, ST_SPLIT_RANGE* ranges, uint32_t range_count, const TS_TOT_INDEX* index, const TS_RAP_INDEX* rap, TS_PID_FILTER* filter, bool restamp, bool threaded );
+static	bool			ts_split_resolve( TS_READER* reader, const ST_SPLIT_RANGE* range, const TS_TOT_INDEX* index, uint64_t* start_offset, uint64_t* end_offset );
+static	void			ts_split_snap( const TS_RAP_INDEX* rap, uint64_t file_size, uint64_t* start_offset, uint64_t* end_offset );
+static	bool			ts_split_copy( TS_READER* reader, ST_SPLIT_RANGE* range, const TS_TOT_INDEX* index, const TS_RAP_INDEX* rap );
+static	bool			ts_split_write( TS_READER* reader, ST_SPLIT_RANGE* range, const TS_TOT_INDEX* index, const TS_RAP_INDEX* rap, TS_PID_FILTER* filter, bool restamp, TS_PACKET_BATCH* batch, uint8_t* buffer );
+static	bool			add_range( ST_SPLIT_RANGE** ranges, uint32_t* range_count, const char* start_datetime, const char* end_datetime, const char* out_filename );
+static	bool			load_schedule( const char* schedule_filename, ST_SPLIT_RANGE** ranges, uint32_t* range_count );
+static	bool			ts_build_index( const char* in_filename, TS_READER_MODE mode, const char* index_filename, TS_TOT_INDEX* index );
+static	bool			ts_load_rap_index( const char* in_filename, TS_READER_MODE mode, TS_RAP_INDEX* rap );
+static	bool			ts_split_live( const char* in_source, const char* out_prefix, uint32_t period );
+static	void			stop_live( int signal_number );
+static	bool			ts_split_daemon( const char* socket_path, uint32_t workers, uint32_t cache_entries, TS_READER_MODE mode, bool snap, bool restamp, bool threaded, TS_PID_FILTER* filter );
+static	void*			ts_split_daemon_worker( void* arg );
+static	void			ts_split_daemon_receive( ST_SPLIT_CONNECTION* connection );
+static	void			ts_split_daemon_dispatch( ST_SPLIT_DAEMON* daemon, ST_SPLIT_CONNECTION* connection );
+static	bool			ts_split_daemon_request( ST_SPLIT_DAEMON* daemon, const char* line, int fd );
+static	void			stop_daemon( int signal_number );
+static	bool			get_datetime( const char* str_datetime, ST_DATETIME* st_datetime );
 static	void			show_help( void );
 
 /**
-* @brief		BCD => DECIMAL converter
-* @param[in]	bcd			BCD
-* @return		uint8_t		Converted decimal
-* @details		This function convert DCB to decimal.\n
-* 				Example : 0x12 => 12
+* @brief		Resolve byte range of split range
+* @param[in]	reader			Seekable reader of the input file
+* @param[in]	range			Split range
+* @param[in]	index			TOT index of the input file. NULL if there is none
+* @param[out]	start_offset	Offset of the first TOT packet in the range
+* @param[out]	end_offset		Offset of the first TOT packet after the range, or the file size
+* @return		bool			false if the range has no TOT
 */
-inline	uint8_t		bcd_to_dec( uint8_t bcd )
+static	bool		ts_split_resolve( TS_READER* reader, const ST_SPLIT_RANGE* range, const TS_TOT_INDEX* index, uint64_t* start_offset, uint64_t* end_offset )
 {
-	uint8_t result = bcd & 0x0F;
+	uint64_t	datetime;
 	
-	result += ( ( bcd & 0xF0 ) >> 4 ) * 10;
+	if( NULL != index ){
+		int64_t		entry = ts_tot_index_search( index, range->Start.DateTime );
+		
+		if( ( 0 > entry ) || ( index->Entries[ entry ].DateTime > range->End.DateTime ) ){
+			return false;
+		}
+		*start_offset = index->Entries[ entry ].Offset;
+		
+		*end_offset = reader->FileSize;
+		if( 0xFFFFFFFFFFFFFFFF != range->End.DateTime ){
+			entry = ts_tot_index_search( index, range->End.DateTime + 1 );
+			if( 0 <= entry ){
+				*end_offset = index->Entries[ entry ].Offset;
+			}
+		}
+	}else{
+		if(    !ts_tot_find( reader, range->Start.DateTime, start_offset, &datetime )
+			|| ( datetime > range->End.DateTime ) ){
+			return false;
+		}
+		
+		*end_offset = reader->FileSize;
+		if( 0xFFFFFFFFFFFFFFFF != range->End.DateTime ){
+			uint64_t	offset;
+			
+			if( ts_tot_find( reader, range->End.DateTime + 1, &offset, &datetime ) ){
+				*end_offset = offset;
+			}
+		}
+	}
 	
-	return result;
+	return true;
 }
 
 /**
-* @brief		Split ts file.
-* @param[in]	ts_file			TS file path
-* @param[in]	out_filename	Output TS file path
-* @return		double			bitrate. if error return 0.0
+* @brief		Move cut points to random access points
+* @param[in]	rap				Random access point index
+* @param[in]	file_size		Size of the input file. An end at the file size is kept
+* @param[in,out]	start_offset	Start of the range
+* @param[in,out]	end_offset		End of the range
+* @details		The start moves back to the last random access point at or before it, so the range only grows\n
+*				and stays before the end. A start before the first random access point moves forward to it\n
+*				only if that is still before the end.\n
+*				The end moves to the nearest random access point, and is kept when that is not after the start\n
+*				( range shorter than a GOP ).
 */
-static	double		ts_calc_bitrate( const char* ts_file )
+static	void		ts_split_snap( const TS_RAP_INDEX* rap, uint64_t file_size, uint64_t* start_offset, uint64_t* end_offset )
 {
-	FILE*		ifp = NULL;
+	int64_t		entry;
 	
-	uint8_t		ts_buffer[ TS_PACKET_SIZE ];
+	if( 0 == rap->Header.Count ){
+		return;
+	}
+	entry = ts_rap_index_before( rap, *start_offset );
+	if( 0 <= entry ){
+		DEBUG_PRINT( "Snap start %lu => %lu\n", *start_offset, rap->Entries[ entry ].Offset );
+		*start_offset = rap->Entries[ entry ].Offset;
+	}else if( rap->Entries[ 0 ].Offset < *end_offset ){
+		DEBUG_PRINT( "Snap start %lu => %lu\n", *start_offset, rap->Entries[ 0 ].Offset );
+		*start_offset = rap->Entries[ 0 ].Offset;
+	}
 	
-	uint64_t	total_packet = 0;
+	if( *end_offset < file_size ){
+		entry = ts_rap_index_nearest( rap, *end_offset );
+		if( rap->Entries[ entry ].Offset > *start_offset ){
+			DEBUG_PRINT( "Snap end %lu => %lu\n", *end_offset, rap->Entries[ entry ].Offset );
+			*end_offset = rap->Entries[ entry ].Offset;
+		}
+	}
+}
+
+/**
+* @brief		Write split range with kernel copy
+* @param[in]	reader			Seekable reader of the input file
+* @param[in]	range			Split range. Finished on return
+* @param[in]	index			TOT index of the input file. NULL if there is none
+* @param[in]	rap				Random access point index to snap the cut points. NULL cuts at TOT
+* @return		bool			Result
+* @details		The packet aligned byte range is moved by ts_copy_range() without passing through user space.\n
+*				Unlike the packet loop, bytes dropped by resync inside the range are copied as they are.
+*/
+static	bool		ts_split_copy( TS_READER* reader, ST_SPLIT_RANGE* range, const TS_TOT_INDEX* index, const TS_RAP_INDEX* rap )
+{
+	uint64_t		start_offset;
+	uint64_t		end_offset;
+	TS_COPY_METHOD	method = TS_COPY_NONE;
+	bool			result = true;
+	bool			found;
+	
+	found = ts_split_resolve( reader, range, index, &start_offset, &end_offset );
+	if( found && ( NULL != rap ) ){
+		ts_split_snap( rap, reader->FileSize, &start_offset, &end_offset );
+	}
+	ts_stats_phase( TS_STATS_PHASE_WRITE );
+	if( found && ( start_offset < end_offset ) ){
+		DEBUG_PRINT( "Copy [%s] %lu - %lu\n", range->OutFilename, start_offset, end_offset );
+		result = ts_writer_flush( &range->Writer )
+			  && ts_copy_range( reader->Fd, range->Writer.Fd, start_offset, end_offset - start_offset, &method );
+		if( result ){
+			// Bytes dropped by resync are copied too, so the length is not a packet count.
+			range->CopiedBytes = end_offset - start_offset;
+		}
+		DEBUG_PRINT( "Copy method %d\n", method );
+	}
+	
+	range->Finished = true;
+	if( !ts_writer_close( &range->Writer ) ){
+		result = false;
+	}
+	
+	return result;
+}
+
+/**
+* @brief		Write split range through the packet loop ( PID filter, restamp )
+* @param[in]	reader			Seekable reader of the input file
+* @param[in]	range			Split range. Finished on return
+* @param[in]	index			TOT index of the input file. NULL if there is none
+* @param[in]	rap				Random access point index to snap the cut points. NULL cuts at TOT
+* @param[in]	filter			PID filter. NULL writes every PID
+* @param[in]	restamp			Restamp PCR / PTS / DTS
+* @param[in]	batch			Work area
+* @param[out]	buffer			Work area of TS_BATCH_PACKETS packets
+* @return		bool			Result
+* @details		Passing packets are gathered into buffer, rewritten there and written out by one fwrite.\n
+*				With restamp, the first PCR of the range is read ahead, so the PES before it are restamped on the same base.
+*/
+static	bool		ts_split_write( TS_READER* reader, ST_SPLIT_RANGE* range, const TS_TOT_INDEX* index, const TS_RAP_INDEX* rap, TS_PID_FILTER* filter, bool restamp, TS_PACKET_BATCH* batch, uint8_t* buffer )
+{
+	const uint8_t*	ts_buffer;
+	uint32_t		read_count;
+	uint32_t		n;
+	uint32_t		count;
+	uint64_t		start_offset;
+	uint64_t		end_offset;
+	uint64_t		offset;
+	bool			result = true;
 	
-	uint64_t	start_pcr;
-	uint64_t	end_pcr;
-	int			pcr_count = 0;
-	double		bitrate = 0.0;
-	uint16_t	pcr_pid = PID_NULL;
+	ts_restamp_init( &range->Restamp );
+	if( !ts_split_resolve( reader, range, index, &start_offset, &end_offset ) ){
+		goto end;
+	}
+	if( NULL != rap ){
+		ts_split_snap( rap, reader->FileSize, &start_offset, &end_offset );
+	}
 	
-	ifp = fopen( ts_file, "rb" );
-	total_packet = 0;
-	if( ifp ){
-		while( TS_PACKET_SIZE == fread( ts_buffer, 1, sizeof( ts_buffer ), ifp ) ){
-			if( TS_SYNC_BYTE != ts_buffer[ 0 ] ){
+	ts_stats_phase( TS_STATS_PHASE_SCAN );
+	ts_reader_seek( reader, start_offset );
+	while( restamp && !range->Restamp.Started && ( 0 < ( read_count = ts_reader_next( reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+		if( ts_reader_tell( reader ) - ( uint64_t )read_count * TS_PACKET_SIZE >= end_offset ){
+			break;
+		}
+		ts_parse_batch( ts_buffer, read_count, batch );
+		for( n = 0 ; n < batch->Count ; n++ ){
+			if( ( batch->Flags[ n ] & TS_PKT_FLAG_PCR ) && ( ( NULL == filter ) || TS_PID_FILTER_PASS( filter, batch->Pid[ n ] ) ) ){
+				ts_restamp_start( &range->Restamp, batch->Pid[ n ], batch->Pcr[ n ] );
 				break;
 			}
+		}
+	}
+	
+	ts_reader_seek( reader, start_offset );
+	while( result && ( 0 < ( read_count = ts_reader_next( reader, &ts_buffer, TS_BATCH_PACKETS ) ) ) ){
+		offset = ts_reader_tell( reader ) - ( uint64_t )read_count * TS_PACKET_SIZE;
+		if( offset >= end_offset ){
+			break;
+		}
+		if( ( end_offset - offset - 1 ) / TS_PACKET_SIZE + 1 < read_count ){
+			read_count = ( end_offset - offset - 1 ) / TS_PACKET_SIZE + 1;
+		}
+		ts_parse_batch( ts_buffer, read_count, batch );
+		if( NULL != filter ){
+			ts_pid_filter_batch( filter, batch );
+		}
+		for( n = 0, count = 0 ; n < batch->Count ; n++ ){
+			uint8_t*		packet = &buffer[ count * TS_PACKET_SIZE ];
+			const uint8_t*	source = &ts_buffer[ n * TS_PACKET_SIZE ];
 			
-			if( 0 < pcr_count ){
-				total_packet++;
-			}else{
-				total_packet = 0;
+			if( ( NULL != filter ) && !TS_PID_FILTER_PASS( filter, batch->Pid[ n ] ) ){
+				continue;
 			}
-			
-			if( ts_buffer[ 3 ] & TS_ADAPTATION_FIELD ){			// Is adaptaion_file ON ?
-				if( ts_buffer[ 5 ] & ADAPTATION_FIELD_PCR ){	// PCR Flag ?
-					if( PID_NULL == pcr_pid ){
-						pcr_pid = GET_PID( ts_buffer[ 1 ], ts_buffer[ 2 ] );
-					}
-					
-					if( pcr_pid != GET_PID( ts_buffer[ 1 ], ts_buffer[ 2 ] ) ){
-						continue;
-					}
-					
-					if( 0 == pcr_count ){
-						start_pcr  = ( ( ( uint64_t )ts_buffer[ 6 ] ) << 25 ) & 0x1FE000000;
-						start_pcr |= ( ( ( uint64_t )ts_buffer[ 7 ] ) << 17 ) & 0x001FE0000;
-						start_pcr |= ( ( ( uint64_t )ts_buffer[ 8 ] ) << 9  ) & 0x00001FE00;
-						start_pcr |= ( ( ( uint64_t )ts_buffer[ 9 ] ) << 1 )  & 0x0000001FE;
-						start_pcr |= ( ( ( ( uint64_t )ts_buffer[ 10 ] ) & 0x80 ) >> 7 ) & 0x00000001;
-						DEBUG_PRINT( "Start PCR = %lu\n", start_pcr );
-						pcr_count++;
-					}else if( 0 < pcr_count ){
-						end_pcr  = ( ( ( uint64_t )ts_buffer[ 6 ] ) << 25 ) & 0x1FE000000;
-						end_pcr |= ( ( ( uint64_t )ts_buffer[ 7 ] ) << 17 ) & 0x001FE0000;
-						end_pcr |= ( ( ( uint64_t )ts_buffer[ 8 ] ) << 9  ) & 0x00001FE00;
-						end_pcr |= ( ( ( uint64_t )ts_buffer[ 9 ] ) << 1 )  & 0x0000001FE;
-						end_pcr |= ( ( ( ( uint64_t )ts_buffer[ 10 ] ) & 0x80 ) >> 7 ) & 0x00000001;
-						
-						if( start_pcr > end_pcr ){
-							DEBUG_PRINT( "PCR RESET %lu => %lu\n", start_pcr, end_pcr );
-							pcr_count = 0;
-							total_packet = 0;
-							continue;
-						}
-						
-						pcr_count++;
-						
-						if( BIT_RATE_COUNT_PCR < pcr_count ){
-							DEBUG_PRINT("End   PCR = %lu / Total = %lu\n", end_pcr, total_packet );
-							bitrate = ( total_packet * TS_PACKET_SIZE * 8 ) / ( ( end_pcr - start_pcr ) / 90000.0 );
-							DEBUG_PRINT( "TS Bitrate = %lf\n", bitrate );
-							break;
-						}
-					}
-				}
+			if( ( NULL != filter ) && ( PID_PAT == batch->Pid[ n ] ) && ( NULL == ( source = ts_pid_filter_pat( filter, source, batch->Flags[ n ] ) ) ) ){
+				continue;
 			}
+			memcpy( packet, source, TS_PACKET_SIZE );
+			if( restamp ){
+				ts_restamp_packet( &range->Restamp, packet, batch->Pid[ n ], batch->Flags[ n ], batch->PayloadOffset[ n ] );
+			}
+			count++;
+		}
+		if( !ts_writer_write( &range->Writer, buffer, ( size_t )count * TS_PACKET_SIZE ) ){
+			result = false;
 		}
-		fclose( ifp );
+		range->TotalPacket += count;
+		range->DroppedPacket += batch->Count - count;
 	}
 	
-	return bitrate;
+end:
+	ts_stats_phase( TS_STATS_PHASE_WRITE );
+	range->Finished = true;
+	if( !ts_writer_close( &range->Writer ) ){
+		result = false;
+	}
+	
+	return result;
 }
 
 /**
 * @brief		Split ts file.
 * @param[in]	in_filename		Input TS file path
-* @param[in]	out_filename	Output TS file path
-* @param[in]	start			Start datetime of output file
-* @param[in]	end				End datetime of output file
+* @param[in]	mode			How the input is read. TS_READER_MODE_*
+* @param[in]	ranges			Output ranges. Ranges may overlap
+* @param[in]	range_count		Number of ranges
+* @param[in]	index			TOT index of the input file. NULL if there is none
+* @param[in]	rap				Random access point index to snap the cut points. NULL cuts at TOT
+* @param[in]	filter			PID filter. NULL writes every PID
+* @param[in]	restamp			Restamp PCR / PTS / DTS of every range to start at TS_RESTAMP_ORIGIN
+* @param[in]	threaded		Write the outputs from writer threads
 * @return		bool			Result
 * @details		Divide the file according to the following procedure
-*				1) Calculate the bit rate of the input file.\n
-*				PCR is used for calculation.\n
-*				2) Seek from the calculated bit rate to the approximate start position of the input file.\n
-*				3) If the seek has succeeded, continue processing.\n
-*				If it fails, the processing is terminated.\n
-*				4) Write the TS packet from the input file to the output file, and terminate the process in the case of discovering the time of power of the TOT.\n
-*				Also, even if it is not the end time, the process ends when the input file ends.\n
+*				0) If the input is seekable, resolve the byte range of each range by the TOT index or bisection\n
+*				and copy it with ts_copy_range(). Nothing else is needed.\n
+*				With the PID filter or restamp, the byte range goes through the packet loop instead.\n
+*				1) If the TOT index is given, seek to the first TOT at or after the earliest start time.\n
+*				2) Otherwise seek near the earliest start time by bisection over TOT and PCR.\n
+*				A pipe is read from the head.\n
+*				3) Read the input once. Each TS packet is written to every range whose TOT time window\n
+*				contains the last TOT. A range is closed at the first TOT after its end time.\n
+*				The process ends when every range is closed or the input file ends.\n
 */
-static	bool		ts_split( const char* in_filename, const char* out_filename, ST_DATETIME* start, ST_DATETIME* end )
+static	bool		ts_split( const char* in_filename, TS_READER_MODE mode, ST_SPLIT_RANGE* ranges, uint32_t range_count, const TS_TOT_INDEX* index, const TS_RAP_INDEX* rap, TS_PID_FILTER* filter, bool restamp, bool threaded )
 {
-	FILE*		ifp = NULL;
-	FILE*		ofp = NULL;
+	TS_READER	reader;
 	
-	uint8_t		ts_buffer[ TS_PACKET_SIZE ];
+	const uint8_t*		ts_read_buffer = NULL;
+	const uint8_t*		ts_buffer = NULL;
+	TS_PACKET_BATCH*	batch = NULL;
+	uint8_t*			write_buffer = NULL;
+	uint32_t			read_count;
+	uint32_t			n;
+	uint32_t			r;
+	uint32_t			finished = 0;
+	uint32_t			writing = 0;
+	uint64_t			first_start;
+	uint64_t			landing;
+	uint64_t			scanned = 0;
+	bool				tot_seen = false;
 	
-	uint64_t	total_packet = 0;
+	bool		result = true;
 	
-	bool		file_write_flag = false;
-	bool		file_seeked = false;
+	memset( &reader, 0, sizeof( reader ) );
 	
-	double		bitrate = 0;
+	first_start = ranges[ 0 ].Start.DateTime;
+	for( r = 0 ; r < range_count ; r++ ){
+		if( ranges[ r ].Start.DateTime < first_start ){
+			first_start = ranges[ r ].Start.DateTime;
+		}
+		if( !ts_writer_open( &ranges[ r ].Writer, ranges[ r ].OutFilename, threaded ) ){
+			printf( "%s()[%d] OUT File open error. [%s]\n", __func__, __LINE__, ranges[ r ].OutFilename );
+			result = false;
+			goto end;
+		}
+		ts_restamp_init( &ranges[ r ].Restamp );
+	}
+	
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( NULL == batch ){
+		result = false;
+		goto end;
+	}
+	if( restamp || ( NULL != filter ) ){
+		write_buffer = malloc( TS_BATCH_PACKETS * TS_PACKET_SIZE );
+		if( NULL == write_buffer ){
+			result = false;
+			goto end;
+		}
+	}
 	
-	bool		find_tot = false;
+	if( !ts_reader_open( &reader, in_filename, mode ) ){
+		printf( "%s()[%d] IN File open error. [%s]\n", __func__, __LINE__, in_filename );
+		result = false;
+		goto end;
+	}
 	
-	bool		result = true;
+	if( reader.Seekable && ( NULL != filter ) && !ts_pid_filter_resolve( filter, &reader ) ){
+		printf( "%s()[%d] PMT of program %u is not found.\n", __func__, __LINE__, filter->ProgramNumber );
+		result = false;
+		goto end;
+	}
 	
-	bitrate = ts_calc_bitrate( in_filename );
-	if( 0.0 >= bitrate ){
-		perror( "Error calc bitrate.\n" );
-		return false;
+	if( reader.Seekable ){
+		for( r = 0 ; r < range_count ; r++ ){
+			if( restamp || ( NULL != filter ) ){
+				// Dropped or rewritten packets can not be moved by the kernel copy.
+				if( !ts_split_write( &reader, &ranges[ r ], index, rap, filter, restamp, batch, write_buffer ) ){
+					printf( "%s()[%d] Write error. [%s]\n", __func__, __LINE__, ranges[ r ].OutFilename );
+					result = false;
+				}
+			}else if( !ts_split_copy( &reader, &ranges[ r ], index, rap ) ){
+				printf( "%s()[%d] Copy error. [%s]\n", __func__, __LINE__, ranges[ r ].OutFilename );
+				result = false;
+			}
+			finished++;
+		}
 	}
 	
-	ifp = fopen( in_filename, "rb" );
-	if( ifp ){
-		ofp = fopen( out_filename, "wb" );
+	if( finished == range_count ){
+		// Every range is written.
+	}else if( NULL != index ){
+		int64_t		entry = ts_tot_index_search( index, first_start );
 		
-		if( ofp ){
-			while( TS_PACKET_SIZE == fread( ts_buffer, 1, sizeof( ts_buffer ), ifp ) ){
-				if( TS_SYNC_BYTE != ts_buffer[ 0 ] ){
-					result = true;
-					break;
+		if( 0 <= entry ){
+			DEBUG_PRINT( "Index seek %lu\n", index->Entries[ entry ].Offset );
+			ts_reader_seek( &reader, index->Entries[ entry ].Offset );
+		}else{
+			ts_reader_seek( &reader, reader.FileSize );
+		}
+	}else if( reader.Seekable ){
+		uint32_t	probe_count = 0;
+		
+		if( ts_tot_seek( &reader, first_start, &probe_count ) ){
+			DEBUG_PRINT( "Bisection seek %lu ( %u probes )\n", ts_reader_tell( &reader ), probe_count );
+		}else{
+			ts_reader_seek( &reader, 0 );
+		}
+	}else{
+		// A pipe can not be scanned twice, so it is read from the head.
+	}
+	
+	ts_stats_phase( TS_STATS_PHASE_SCAN );
+	landing = ts_reader_tell( &reader );
+	while( ( finished < range_count ) && ( 0 < ( read_count = ts_reader_next( &reader, &ts_read_buffer, TS_BATCH_PACKETS ) ) ) ){
+		ts_parse_batch( ts_read_buffer, read_count, batch );
+		if( NULL != filter ){
+			ts_pid_filter_batch( filter, batch );
+		}
+		for( n = 0 ; ( n < batch->Count ) && ( finished < range_count ) ; n++ ){
+			uint64_t	tot_datetime;
+			
+			ts_buffer = &ts_read_buffer[ n * TS_PACKET_SIZE ];
+			
+			if(    ( PID_TOT == batch->Pid[ n ] )
+				&& ts_tot_parse( ts_buffer, batch->PayloadOffset[ n ], &tot_datetime ) ){
+				if( !tot_seen ){
+					tot_seen = true;
+					TS_STATS_ADD( TotSearches, 1 );
+					TS_STATS_ADD( PacketsBeforeTot, scanned + n );
+					if( reader.Seekable ){
+						TS_STATS_ADD( SeekUndershootBytes, ts_reader_tell( &reader ) - ( uint64_t )( read_count - n ) * TS_PACKET_SIZE - landing );
+					}
 				}
-				
-				if( PID_TOT == GET_PID( ts_buffer[ 1 ], ts_buffer[ 2 ] ) ){
-					int		payload_start_pos;
+				for( r = 0 ; r < range_count ; r++ ){
+					ST_SPLIT_RANGE*	range = &ranges[ r ];
 					
-					if( ts_buffer[ 3 ] & TS_ADAPTATION_FIELD ){
-						payload_start_pos = 4 + 1 + ts_buffer[ 4 ];
-					}else{
-						payload_start_pos = 5;
+					if( range->Finished ){
+						continue;
 					}
-					
-					if( TABLE_ID_TOT == ts_buffer[ payload_start_pos ] ){
-						uint16_t	tot_mjd;
-						uint32_t	tot_time;
-						uint64_t	tot_datetime;
-						uint32_t	hour, min, sec;
-						
-						tot_mjd = ( ( ( uint16_t )ts_buffer[ payload_start_pos + 3 ] << 8 ) & 0xFF00 ) | ( ( ( uint16_t )ts_buffer[ payload_start_pos + 4 ] ) & 0x00FF );
-						
-						hour = bcd_to_dec( ts_buffer[ payload_start_pos + 5 ] );
-						min  = bcd_to_dec( ts_buffer[ payload_start_pos + 6 ] );
-						sec  = bcd_to_dec( ts_buffer[ payload_start_pos + 7 ] );
-						tot_time = hour * 3600 + min * 60 + sec;
-						
-						tot_datetime = ( ( uint64_t )tot_mjd ) << 32 | ( uint64_t )tot_time;
-						if( file_seeked ){
-							DEBUG_PRINT("MJD = %d  Time = %u Datatime = %ld Time = %02X:%02X:%02X\n", tot_mjd, tot_time, tot_datetime, ts_buffer[ payload_start_pos + 5 ], ts_buffer[ payload_start_pos + 6 ], ts_buffer[ payload_start_pos + 7 ]);
-							file_seeked = false;
+					if( range->Start.DateTime <= tot_datetime && tot_datetime <= range->End.DateTime ){
+						if( !range->Writing ){
+							DEBUG_PRINT( "Split start [%s] MJD %u  Time %u Datetime = %lu\n", range->OutFilename, TS_DATETIME_MJD( tot_datetime ), TS_DATETIME_SEC( tot_datetime ), tot_datetime );
+							range->Writing = true;
+							writing++;
 						}
-						if( start->DateTime <= tot_datetime && tot_datetime <= end->DateTime ){
-							if( !file_write_flag ){
-								DEBUG_PRINT( "Split start MJD %u  Time %u Datetime = %lu\n", tot_mjd, tot_time, tot_datetime );
-							}
-							file_write_flag = true;
-							find_tot = true;
-						}else{
-							if( file_write_flag ){
-								DEBUG_PRINT( "Split end MJD %u  Time %u Datetime = %lu\n", tot_mjd, tot_time, tot_datetime );
-								break;
-							}
-							file_write_flag = false;
-							
-							if( !find_tot ){
-								DEBUG_PRINT( "First TOT Packet\n" );
-								DEBUG_PRINT("MJD = %d  Time = %u Datatime = %ld Time = %02X:%02X:%02X\n", tot_mjd, tot_time, tot_datetime, ts_buffer[ payload_start_pos + 5 ], ts_buffer[ payload_start_pos + 6 ], ts_buffer[ payload_start_pos + 7 ]);
-								if( tot_datetime < start->DateTime ){
-									uint64_t	diff_second;
-									uint64_t	seek_byte;
-									if( tot_time < start->Time ){
-										diff_second = start->Time - tot_time;
-										diff_second += ( start->MJD - tot_mjd ) * 24 * 3600;
-									}else{
-										diff_second = 24 * 3600 - ( tot_time - start->Time );
-										diff_second += ( ( start->MJD - 1 ) - tot_mjd ) * 24 * 3600;
-									}
-									seek_byte = ( ( uint64_t )( ( bitrate / 8 * diff_second * 0.999 ) / TS_PACKET_SIZE ) ) * TS_PACKET_SIZE;
-									
-									DEBUG_PRINT( "Diff Second = %lu / Seek_Byte = %lu\n", diff_second, seek_byte );
-									fseeko( ifp, seek_byte, SEEK_SET );
-									file_seeked = true;
-								}
-								find_tot = true;
-							}
+					}else if( range->Writing ){
+						DEBUG_PRINT( "Split end [%s] MJD %u  Time %u Datetime = %lu\n", range->OutFilename, TS_DATETIME_MJD( tot_datetime ), TS_DATETIME_SEC( tot_datetime ), tot_datetime );
+						range->Writing = false;
+						range->Finished = true;
+						if( !ts_writer_close( &range->Writer ) ){
+							result = false;
 						}
+						writing--;
+						finished++;
 					}
 				}
-				
-				if( file_write_flag ){
-					fwrite( ts_buffer, 1, sizeof( ts_buffer ), ofp );
-					total_packet++;
-				}
 			}
 			
-			fclose( ofp );
+			if( ( 0 < writing ) && ( NULL != filter ) && ( PID_PAT == batch->Pid[ n ] ) ){
+				ts_buffer = ts_pid_filter_pat( filter, ts_buffer, batch->Flags[ n ] );
+			}
+			if( ( 0 < writing ) && ( NULL != filter ) && ( !TS_PID_FILTER_PASS( filter, batch->Pid[ n ] ) || ( NULL == ts_buffer ) ) ){
+				for( r = 0 ; r < range_count ; r++ ){
+					if( ranges[ r ].Writing ){
+						ranges[ r ].DroppedPacket++;
+					}
+				}
+			}else if( 0 < writing ){
+				for( r = 0 ; r < range_count ; r++ ){
+					if( !ranges[ r ].Writing ){
+						continue;
+					}
+					if( restamp ){
+						memcpy( write_buffer, ts_buffer, TS_PACKET_SIZE );
+						ts_restamp_packet( &ranges[ r ].Restamp, write_buffer, batch->Pid[ n ], batch->Flags[ n ], batch->PayloadOffset[ n ] );
+						ts_writer_write( &ranges[ r ].Writer, write_buffer, TS_PACKET_SIZE );
+					}else{
+						ts_writer_write( &ranges[ r ].Writer, ts_buffer, TS_PACKET_SIZE );
+					}
+					ranges[ r ].TotalPacket++;
+				}
+			}
+		}
+		scanned += read_count;
+	}
+	
+	ts_reader_close( &reader );
+	
+end:
+	ts_stats_phase( TS_STATS_PHASE_WRITE );
+	free( batch );
+	free( write_buffer );
+	
+	for( r = 0 ; r < range_count ; r++ ){
+		if( !ts_writer_close( &ranges[ r ].Writer ) ){
+			result = false;
+		}
+		printf( "OUT File	 = %s\n", ranges[ r ].OutFilename );
+		if( 0 < ranges[ r ].CopiedBytes ){
+			printf( "Total copied bytes = %lu\n", ranges[ r ].CopiedBytes );
 		}else{
-			printf( "%s()[%d] IN File open error. [%s]", __func__, __LINE__, out_filename );
+			printf( "Total read TS packet = %ld\n", ranges[ r ].TotalPacket );
+		}
+		if( NULL != filter ){
+			printf( "Dropped TS packet = %lu\n", ranges[ r ].DroppedPacket );
+		}
+		if( 0 < ranges[ r ].Restamp.Rebases ){
+			printf( "Restamp discontinuity = %lu\n", ranges[ r ].Restamp.Rebases );
+		}
+	}
+	if( 0 < reader.ResyncCount ){
+		printf( "Resync = %lu / Skipped bytes = %lu\n", reader.ResyncCount, reader.SkippedBytes );
+	}
+	
+	return result;
+}
+
+/**
+* @brief		Stop live input on SIGINT / SIGTERM
+* @param[in]	signal_number	Signal
+*/
+static	void			stop_live( int signal_number )
+{
+	( void )signal_number;
+	if( NULL != LiveInput ){
+		ts_live_stop( LiveInput );
+	}
+}
+
+/**
+* @brief		Split live input into files of a fixed TOT period
+* @param[in]	in_source		"-" for stdin or "udp://address:port"
+* @param[in]	out_prefix		Output file prefix
+* @param[in]	period			Period in seconds. 60 rotates every TOT minute, 3600 every hour
+* @return		bool			Result
+* @details		A new file starts at the first TOT of each period, like the start of a split range.\n
+*				Packets before the first TOT are not written.\n
+*				Input is received by another thread into a bounded ring, so writing the output\n
+*				does not make the receiver drop data. Runs until the end of input or SIGINT.
+*/
+static	bool			ts_split_live( const char* in_source, const char* out_prefix, uint32_t period )
+{
+	TS_LIVE				live;
+	TS_READER			reader;
+	TS_PACKET_BATCH*	batch;
+	const uint8_t*		ts_read_buffer;
+	uint32_t			read_count;
+	uint32_t			n;
+	uint32_t			run;
+	FILE*				fp = NULL;
+	char*				out_filename = NULL;
+	size_t				out_filename_size;
+	struct sigaction	action;
+	uint64_t			period_number = UINT64_MAX;
+	uint64_t			total_packet = 0;
+	uint32_t			files = 0;
+	bool				result = true;
+	
+	out_filename_size = strlen( out_prefix ) + 32;
+	out_filename = malloc( out_filename_size );
+	batch = malloc( sizeof( TS_PACKET_BATCH ) );
+	if( ( NULL == out_filename ) || ( NULL == batch ) ){
+		free( out_filename );
+		free( batch );
+		return false;
+	}
+	
+	if( !ts_live_open( &live, in_source ) ){
+		printf( "%s()[%d] IN open error. [%s]\n", __func__, __LINE__, in_source );
+		free( out_filename );
+		free( batch );
+		return false;
+	}
+	if( !ts_reader_open_ring( &reader, &live.Ring ) ){
+		ts_live_close( &live );
+		free( out_filename );
+		free( batch );
+		return false;
+	}
+	LiveInput = &live;
+	// Without SA_RESTART, so that a blocked read() of the input returns on the signal.
+	memset( &action, 0, sizeof( action ) );
+	action.sa_handler = stop_live;
+	sigemptyset( &action.sa_mask );
+	sigaction( SIGINT, &action, NULL );
+	sigaction( SIGTERM, &action, NULL );
+	
+	while( result && ( 0 < ( read_count = ts_reader_next( &reader, &ts_read_buffer, TS_BATCH_PACKETS ) ) ) ){
+		ts_parse_batch( ts_read_buffer, read_count, batch );
+		
+		// Packets are written in runs, a run ends at a rotation.
+		for( n = 0, run = 0 ; n < batch->Count ; n++ ){
+			uint64_t	tot_datetime;
+			uint64_t	number;
+			
+			if(    ( PID_TOT != batch->Pid[ n ] )
+				|| !ts_tot_parse( &ts_read_buffer[ n * TS_PACKET_SIZE ], batch->PayloadOffset[ n ], &tot_datetime ) ){
+				continue;
+			}
+			number = ( ( uint64_t )TS_DATETIME_MJD( tot_datetime ) * 86400 + TS_DATETIME_SEC( tot_datetime ) ) / period;
+			if( number == period_number ){
+				continue;
+			}
+			
+			if( NULL != fp ){
+				if( n - run != fwrite( &ts_read_buffer[ run * TS_PACKET_SIZE ], TS_PACKET_SIZE, n - run, fp ) ){
+					result = false;
+				}
+				total_packet += n - run;
+				fclose( fp );
+				printf( "Total read TS packet = %lu\n", total_packet );
+			}
+			run = n;
+			period_number = number;
+			total_packet = 0;
+			
+			{
+				struct tm	tm;
+				uint32_t	start = ( number * period ) % 86400;
+				
+				ts_tot_datetime_to_tm( TS_DATETIME( number * period / 86400, start ), &tm );
+				snprintf( out_filename, out_filename_size, LIVE_FILENAME_FORMAT, out_prefix,
+						  tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec );
+			}
+			fp = fopen( out_filename, "wb" );
+			if( NULL == fp ){
+				printf( "%s()[%d] OUT File open error. [%s]\n", __func__, __LINE__, out_filename );
+				result = false;
+				break;
+			}
+			files++;
+			printf( "OUT File	 = %s\n", out_filename );
+			fflush( stdout );
+		}
+		
+		if( result && ( NULL != fp ) && ( run < batch->Count ) ){
+			if( batch->Count - run != fwrite( &ts_read_buffer[ run * TS_PACKET_SIZE ], TS_PACKET_SIZE, batch->Count - run, fp ) ){
+				result = false;
+			}
+			total_packet += batch->Count - run;
+		}
+	}
+	if( NULL != fp ){
+		fclose( fp );
+		printf( "Total read TS packet = %lu\n", total_packet );
+	}
+	
+	signal( SIGINT, SIG_DFL );
+	signal( SIGTERM, SIG_DFL );
+	LiveInput = NULL;
+	
+	printf( "Files = %u / Received bytes = %lu\n", files, live.Bytes );
+	printf( "Ring max used = %lu / %u blocks / Receiver waits = %lu\n", live.Ring.MaxUsed, live.Ring.BlockCount, live.Ring.FullWaits );
+	if( 0 < reader.ResyncCount ){
+		printf( "Resync = %lu / Skipped bytes = %lu\n", reader.ResyncCount, reader.SkippedBytes );
+	}
+	if( live.Error ){
+		perror( "Receive error." );
+		result = false;
+	}
+	
+	ts_reader_close( &reader );
+	ts_live_close( &live );
+	free( out_filename );
+	free( batch );
+	
+	return result;
+}
+
+/**
+* @brief		Stop daemon on SIGINT / SIGTERM
+* @param[in]	signal_number	Signal
+*/
+static	void			stop_daemon( int signal_number )
+{
+	( void )signal_number;
+	DaemonStop = 1;
+}
+
+/**
+* @brief		Serve split requests on a Unix domain socket
+* @param[in]	socket_path		Socket path. A socket left by a killed daemon is removed, a served one is an error
+* @param[in]	workers			Number of worker threads
+* @param[in]	cache_entries	Number of recordings whose indexes are kept
+* @param[in]	mode			How the recordings are read ( -A, --no-cache )
+* @param[in]	snap			Snap cut points to random access points ( -g )
+* @param[in]	restamp			Restamp PCR / PTS / DTS ( -z )
+* @param[in]	threaded		Threaded reader and writers ( -A )
+* @param[in]	filter			PID filter without program selection. NULL writes every PID
+* @return		bool			Result
+* @details		A client sends one request per line : "input start end output", end "-" is the tail of the input,\n
+*				and gets one line per request : "OK <bytes written>" or "ERROR <reason>".\n
+*				Reasons : busy, format, range ( bad or inverted times ), index, tot ( no TOT in the range ), split.\n
+*				Requests, not connections, are queued to the workers. This thread polls every connection and\n
+*				queues its next line once the previous one is answered, so an idle client holds no worker.\n
+*				The TOT and random access point indexes of a recording are loaded or built once\n
+*				and reused by the following requests while the recording is unchanged.\n
+*				Runs until SIGINT / SIGTERM. Queued requests are answered, then every connection is closed.
+*/
+static	bool			ts_split_daemon( const char* socket_path, uint32_t workers, uint32_t cache_entries, TS_READER_MODE mode, bool snap, bool restamp, bool threaded, TS_PID_FILTER* filter )
+{
+	ST_SPLIT_DAEMON		daemon;
+	ST_SPLIT_CONNECTION*	connections = NULL;
+	struct pollfd		fds[ 2 + DAEMON_CONNECTIONS ];
+	char				drain[ 64 ];
+	struct sockaddr_un	addr;
+	struct sigaction	action;
+	sigset_t			block;
+	sigset_t			saved;
+	struct stat			st;
+	pthread_t*			threads = NULL;
+	uint32_t			started = 0;
+	uint32_t			w;
+	uint32_t			c;
+	bool				busy;
+	int					listen_fd = -1;
+	int					fd;
+	bool				result = true;
+	
+	memset( &addr, 0, sizeof( addr ) );
+	if( sizeof( addr.sun_path ) <= strlen( socket_path ) ){
+		printf( "%s()[%d] Socket path is too long. [%s]\n", __func__, __LINE__, socket_path );
+		return false;
+	}
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, socket_path );
+	
+	memset( &daemon, 0, sizeof( daemon ) );
+	daemon.Wake[ 0 ] = -1;
+	daemon.Wake[ 1 ] = -1;
+	if( !ts_index_cache_init( &daemon.Cache, cache_entries ) ){
+		return false;
+	}
+	pthread_mutex_init( &daemon.Lock, NULL );
+	pthread_cond_init( &daemon.Queued, NULL );
+	daemon.Snap = snap;
+	daemon.Restamp = restamp;
+	daemon.Threaded = threaded;
+	daemon.Mode = mode;
+	daemon.Filter = filter;
+	
+	threads = calloc( workers, sizeof( pthread_t ) );
+	connections = calloc( DAEMON_CONNECTIONS, sizeof( ST_SPLIT_CONNECTION ) );
+	if( ( NULL == threads ) || ( NULL == connections ) ){
+		result = false;
+		goto end;
+	}
+	for( c = 0 ; c < DAEMON_CONNECTIONS ; c++ ){
+		connections[ c ].Fd = -1;
+	}
+	if(    ( 0 != pipe( daemon.Wake ) )
+		|| ( 0 != fcntl( daemon.Wake[ 0 ], F_SETFL, O_NONBLOCK ) )
+		|| ( 0 != fcntl( daemon.Wake[ 1 ], F_SETFL, O_NONBLOCK ) ) ){
+		perror( "Pipe error." );
+		result = false;
+		goto end;
+	}
+	
+	if( ( 0 == stat( socket_path, &st ) ) && S_ISSOCK( st.st_mode ) ){
+		// Only a socket nobody answers on is left by a killed daemon.
+		fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if( ( 0 <= fd ) && ( 0 == connect( fd, ( struct sockaddr* )&addr, sizeof( addr ) ) ) ){
+			printf( "%s()[%d] Another daemon serves the socket. [%s]\n", __func__, __LINE__, socket_path );
+			close( fd );
 			result = false;
+			goto end;
+		}
+		if( 0 <= fd ){
+			close( fd );
 		}
+		unlink( socket_path );
+	}
+	listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if(    ( 0 > listen_fd )
+		|| ( 0 != bind( listen_fd, ( struct sockaddr* )&addr, sizeof( addr ) ) )
+		|| ( 0 != listen( listen_fd, DAEMON_CONNECTIONS ) ) ){
+		perror( "Socket error." );
+		result = false;
+		goto end;
+	}
+	
+	// Without SA_RESTART, so that poll() returns on the signal.
+	memset( &action, 0, sizeof( action ) );
+	action.sa_handler = stop_daemon;
+	sigemptyset( &action.sa_mask );
+	sigaction( SIGINT, &action, NULL );
+	sigaction( SIGTERM, &action, NULL );
+	signal( SIGPIPE, SIG_IGN );
+	
+	// Workers block the stop signals, so that they interrupt poll() of this thread.
+	sigemptyset( &block );
+	sigaddset( &block, SIGINT );
+	sigaddset( &block, SIGTERM );
+	pthread_sigmask( SIG_BLOCK, &block, &saved );
+	for( w = 0 ; w < workers ; w++ ){
+		if( 0 != pthread_create( &threads[ w ], NULL, ts_split_daemon_worker, &daemon ) ){
+			perror( "Worker start error." );
+			break;
+		}
+		started++;
+	}
+	pthread_sigmask( SIG_SETMASK, &saved, NULL );
+	if( 0 == started ){
+		result = false;
+		goto end;
+	}
+	printf( "Daemon socket	 = %s ( %u workers, %u recordings cached )\n", socket_path, started, cache_entries );
+	fflush( stdout );
+	
+	while( !DaemonStop ){
+		fds[ 0 ].fd = listen_fd;
+		fds[ 0 ].events = POLLIN;
+		fds[ 1 ].fd = daemon.Wake[ 0 ];
+		fds[ 1 ].events = POLLIN;
+		pthread_mutex_lock( &daemon.Lock );
+		for( c = 0 ; c < DAEMON_CONNECTIONS ; c++ ){
+			// A connection is not read while its request is served, the next lines wait in the socket.
+			fds[ 2 + c ].fd = ( connections[ c ].Busy || connections[ c ].Eof ) ? -1 : connections[ c ].Fd;
+			fds[ 2 + c ].events = POLLIN;
+		}
+		pthread_mutex_unlock( &daemon.Lock );
 		
-		fclose( ifp );
-	}else{
-		printf( "%s()[%d] OUT File open error. [%s]", __func__, __LINE__, in_filename );
+		if( 0 > poll( fds, 2 + DAEMON_CONNECTIONS, DAEMON_POLL_MS ) ){
+			if( EINTR == errno ){
+				continue;
+			}
+			perror( "Poll error." );
+			result = false;
+			break;
+		}
+		if( fds[ 1 ].revents & POLLIN ){
+			while( 0 < read( daemon.Wake[ 0 ], drain, sizeof( drain ) ) ){
+			}
+		}
+		if( fds[ 0 ].revents & POLLIN ){
+			fd = accept( listen_fd, NULL, NULL );
+			if( ( 0 > fd ) && ( EINTR != errno ) ){
+				perror( "Accept error." );
+				result = false;
+				break;
+			}
+			for( c = 0 ; ( 0 <= fd ) && ( c < DAEMON_CONNECTIONS ) ; c++ ){
+				if( 0 > connections[ c ].Fd ){
+					memset( &connections[ c ], 0, sizeof( ST_SPLIT_CONNECTION ) );
+					connections[ c ].Fd = fd;
+					fd = -1;
+				}
+			}
+			if( 0 <= fd ){
+				dprintf( fd, "ERROR busy\n" );
+				close( fd );
+			}
+		}
+		for( c = 0 ; c < DAEMON_CONNECTIONS ; c++ ){
+			if( 0 != fds[ 2 + c ].revents ){
+				ts_split_daemon_receive( &connections[ c ] );
+			}
+			if( 0 > connections[ c ].Fd ){
+				continue;
+			}
+			pthread_mutex_lock( &daemon.Lock );
+			busy = connections[ c ].Busy;
+			pthread_mutex_unlock( &daemon.Lock );
+			if( !busy ){
+				ts_split_daemon_dispatch( &daemon, &connections[ c ] );
+			}
+		}
+	}
+	
+end:
+	pthread_mutex_lock( &daemon.Lock );
+	daemon.Stopping = true;
+	pthread_cond_broadcast( &daemon.Queued );
+	pthread_mutex_unlock( &daemon.Lock );
+	for( w = 0 ; w < started ; w++ ){
+		pthread_join( threads[ w ], NULL );
+	}
+	signal( SIGINT, SIG_DFL );
+	signal( SIGTERM, SIG_DFL );
+	
+	for( c = 0 ; ( NULL != connections ) && ( c < DAEMON_CONNECTIONS ) ; c++ ){
+		if( 0 <= connections[ c ].Fd ){
+			close( connections[ c ].Fd );
+		}
+	}
+	for( w = 0 ; w < 2 ; w++ ){
+		if( 0 <= daemon.Wake[ w ] ){
+			close( daemon.Wake[ w ] );
+		}
+	}
+	
+	if( 0 <= listen_fd ){
+		close( listen_fd );
+		unlink( socket_path );
+	}
+	if( 0 < started ){
+		printf( "Index cache hit = %lu / miss = %lu\n", daemon.Cache.Hits, daemon.Cache.Misses );
 	}
 	
-	printf( "Total read TS packet = %ld\n", total_packet );
+	free( threads );
+	free( connections );
+	ts_index_cache_free( &daemon.Cache );
+	pthread_mutex_destroy( &daemon.Lock );
+	pthread_cond_destroy( &daemon.Queued );
 	
 	return result;
 }
 
+/**
+* @brief		Daemon worker. Serves queued requests until the daemon stops and the queue is empty
+* @param[in]	arg		ST_SPLIT_DAEMON
+* @return		void*	NULL
+*/
+static	void*			ts_split_daemon_worker( void* arg )
+{
+	ST_SPLIT_DAEMON*		daemon = arg;
+	ST_SPLIT_CONNECTION*	connection;
+	
+	for( ;; ){
+		pthread_mutex_lock( &daemon->Lock );
+		while( ( 0 == daemon->QueueCount ) && !daemon->Stopping ){
+			pthread_cond_wait( &daemon->Queued, &daemon->Lock );
+		}
+		if( 0 == daemon->QueueCount ){
+			pthread_mutex_unlock( &daemon->Lock );
+			break;
+		}
+		connection = daemon->Queue[ daemon->QueueHead ];
+		daemon->QueueHead = ( daemon->QueueHead + 1 ) % DAEMON_CONNECTIONS;
+		daemon->QueueCount--;
+		pthread_mutex_unlock( &daemon->Lock );
+		
+		ts_split_daemon_request( daemon, connection->Request, connection->Fd );
+		
+		pthread_mutex_lock( &daemon->Lock );
+		connection->Busy = false;
+		pthread_mutex_unlock( &daemon->Lock );
+		// poll() of the main thread queues the next request of the connection.
+		if( ( 1 != write( daemon->Wake[ 1 ], "", 1 ) ) && ( EAGAIN != errno ) ){
+			perror( "Daemon wake error." );
+		}
+	}
+	
+	return NULL;
+}
+
+/**
+* @brief		Read request lines of a connection
+* @param[in]	connection	Connection polled as readable
+*/
+static	void			ts_split_daemon_receive( ST_SPLIT_CONNECTION* connection )
+{
+	ssize_t		size;
+	
+	size = read( connection->Fd, &connection->Buffer[ connection->Length ], DAEMON_LINE_SIZE - connection->Length );
+	if( 0 < size ){
+		connection->Length += size;
+	}else if( ( 0 == size ) || ( EINTR != errno ) ){
+		connection->Eof = true;
+	}
+}
+
+/**
+* @brief		Queue the next request of a connection, or close it
+* @param[in]	daemon		Daemon
+* @param[in]	connection	Connection without a request in progress
+* @details		Empty lines and # comments are skipped. The last line may end without a newline.\n
+*				The connection is closed once the client closed its side and every line was answered.
+*/
+static	void			ts_split_daemon_dispatch( ST_SPLIT_DAEMON* daemon, ST_SPLIT_CONNECTION* connection )
+{
+	char*		newline;
+	size_t		length;
+	char		word[ 8 ];
+	
+	while( 0 < connection->Length ){
+		newline = memchr( connection->Buffer, '\n', connection->Length );
+		if( NULL != newline ){
+			length = newline - connection->Buffer + 1;
+		}else if( connection->Eof ){
+			length = connection->Length;
+		}else if( DAEMON_LINE_SIZE == connection->Length ){
+			dprintf( connection->Fd, "ERROR format\n" );
+			connection->Length = 0;
+			connection->Eof = true;
+			break;
+		}else{
+			return;
+		}
+		memcpy( connection->Request, connection->Buffer, length );
+		connection->Request[ length ] = '\0';
+		connection->Length -= length;
+		memmove( connection->Buffer, &connection->Buffer[ length ], connection->Length );
+		if( ( '#' == connection->Request[ 0 ] ) || ( 1 > sscanf( connection->Request, "%7s", word ) ) ){
+			continue;
+		}
+		
+		pthread_mutex_lock( &daemon->Lock );
+		connection->Busy = true;
+		daemon->Queue[ ( daemon->QueueHead + daemon->QueueCount ) % DAEMON_CONNECTIONS ] = connection;
+		daemon->QueueCount++;
+		pthread_cond_signal( &daemon->Queued );
+		pthread_mutex_unlock( &daemon->Lock );
+		return;
+	}
+	if( connection->Eof ){
+		close( connection->Fd );
+		connection->Fd = -1;
+	}
+}
+
+/**
+* @brief		Split one range requested by a client and reply
+* @param[in]	daemon		Daemon
+* @param[in]	line		Request : "input start end output"
+* @param[in]	fd			Connection the reply is written to
+* @return		bool		Result
+*/
+static	bool			ts_split_daemon_request( ST_SPLIT_DAEMON* daemon, const char* line, int fd )
+{
+	char					in_filename[ 4096 ];
+	char					start_datetime[ 64 ];
+	char					end_datetime[ 64 ];
+	char					out_filename[ 4096 ];
+	ST_SPLIT_RANGE*			range = NULL;
+	uint32_t				range_count = 0;
+	TS_INDEX_CACHE_ENTRY*	entry = NULL;
+	int64_t					tot;
+	const char*				error = NULL;
+	
+	if( 4 != sscanf( line, "%4095s %63s %63s %4095s", in_filename, start_datetime, end_datetime, out_filename ) ){
+		error = "format";
+	}else if( !add_range( &range, &range_count, start_datetime, ( 0 == strcmp( end_datetime, "-" ) ) ? NULL : end_datetime, out_filename ) ){
+		error = "range";
+	}else if( range->Start.DateTime > range->End.DateTime ){
+		error = "range";
+	}else if( NULL == ( entry = ts_index_cache_acquire( &daemon->Cache, in_filename, daemon->Mode, daemon->Snap ) ) ){
+		printf( "%s()[%d] Index error. [%s]\n", __func__, __LINE__, in_filename );
+		error = "index";
+	}else if(    ( 0 > ( tot = ts_tot_index_search( &entry->Tot, range->Start.DateTime ) ) )
+			  || ( entry->Tot.Entries[ tot ].DateTime > range->End.DateTime ) ){
+		// No TOT in the range. Checked before the output file is created.
+		error = "tot";
+	}else if( !ts_split( in_filename, daemon->Mode, range, range_count, &entry->Tot, daemon->Snap ? &entry->Rap : NULL, daemon->Filter, daemon->Restamp, daemon->Threaded ) ){
+		error = "split";
+	}else if( ( 0 == range->TotalPacket ) && ( 0 == range->CopiedBytes ) ){
+		unlink( out_filename );
+		error = "tot";
+	}
+	if( NULL != entry ){
+		ts_index_cache_release( &daemon->Cache, entry );
+	}
+	
+	if( NULL != error ){
+		dprintf( fd, "ERROR %s\n", error );
+	}else{
+		dprintf( fd, "OK %lu\n", range->TotalPacket * TS_PACKET_SIZE + range->CopiedBytes );
+	}
+	
+	if( 0 < range_count ){
+		free( range->OutFilename );
+	}
+	free( range );
+	
+	return ( NULL == error );
+}
+
+/**
+* @brief		Build TOT index of TS file
+* @param[in]	in_filename		Input TS file path
+* @param[in]	mode			How the input is read. TS_READER_MODE_*
+* @param[in]	index_filename	Index file path
+* @param[out]	index			Index
+* @return		bool			Result
+*/
+static	bool		ts_build_index( const char* in_filename, TS_READER_MODE mode, const char* index_filename, TS_TOT_INDEX* index )
+{
+	TS_STATS_PHASE	phase = ts_stats_phase( TS_STATS_PHASE_INDEX );
+	bool			built = ts_tot_index_build( in_filename, mode, index );
+	
+	ts_stats_phase( phase );
+	if( !built ){
+		printf( "%s()[%d] Index build error. [%s]\n", __func__, __LINE__, in_filename );
+		return false;
+	}
+	if( !ts_tot_index_save( index_filename, index ) ){
+		printf( "%s()[%d] Index save error. [%s]\n", __func__, __LINE__, index_filename );
+		ts_tot_index_free( index );
+		return false;
+	}
+	printf( "Index File	 = %s ( %lu TOT )\n", index_filename, index->Header.Count );
+	
+	return true;
+}
+
+/**
+* @brief		Load random access point index, build and save it if there is none
+* @param[in]	in_filename		Input TS file path
+* @param[in]	mode			How the input is read to build the index. TS_READER_MODE_*
+* @param[out]	rap				Index. Free with ts_rap_index_free()
+* @return		bool			Result
+*/
+static	bool			ts_load_rap_index( const char* in_filename, TS_READER_MODE mode, TS_RAP_INDEX* rap )
+{
+	char		rap_filename[ 4096 ];
+	
+	ts_rap_index_path( in_filename, rap_filename, sizeof( rap_filename ) );
+	if( !ts_rap_index_load( rap_filename, in_filename, rap ) ){
+		TS_STATS_PHASE	phase = ts_stats_phase( TS_STATS_PHASE_INDEX );
+		bool			built = ts_rap_index_build( in_filename, mode, rap );
+		
+		ts_stats_phase( phase );
+		if( !built ){
+			printf( "%s()[%d] RAP index build error. [%s]\n", __func__, __LINE__, in_filename );
+			return false;
+		}
+		if( !ts_rap_index_save( rap_filename, rap ) ){
+			// The index is still used for this run.
+			printf( "%s()[%d] RAP index save error. [%s]\n", __func__, __LINE__, rap_filename );
+		}
+	}
+	printf( "RAP Index File	 = %s ( %lu RAP on PID 0x%04X )\n", rap_filename, rap->Header.Count, rap->Header.Pid );
+	
+	return true;
+}
+
 /**
 * @brief		Convert DateTime   String => ST_DATETIME
 * @param[in]	str_datetime	String datetime
 * @param[out]	st_datetime		Struct datetime
 * @return		bool			Result
 */
-static	bool			get_datetime( char* str_datetime, ST_DATETIME* st_datetime )
+static	bool			get_datetime( const char* str_datetime, ST_DATETIME* st_datetime )
+{
+	if( !ts_tot_datetime_parse( str_datetime, &st_datetime->DateTime ) ){
+		return false;
+	}
+	st_datetime->MJD = TS_DATETIME_MJD( st_datetime->DateTime );
+	st_datetime->Time = TS_DATETIME_SEC( st_datetime->DateTime );
+	
+	DEBUG_PRINT( "\tMJD %u / TIME %u <= %s\n", st_datetime->MJD, st_datetime->Time, str_datetime );
+	
+	return true;
+}
+
+/**
+* @brief		Add output range
+* @param[in,out]	ranges			Ranges
+* @param[in,out]	range_count		Number of ranges
+* @param[in]	start_datetime	Start datetime string
+* @param[in]	end_datetime	End datetime string. NULL is the tail of the input
+* @param[in]	out_filename	Output TS file path
+* @return		bool			Result
+*/
+static	bool			add_range( ST_SPLIT_RANGE** ranges, uint32_t* range_count, const char* start_datetime, const char* end_datetime, const char* out_filename )
 {
-	int		year, month, day;
-	int		hour, min, sec;
+	ST_SPLIT_RANGE*		range;
+	
+	range = realloc( *ranges, ( *range_count + 1 ) * sizeof( ST_SPLIT_RANGE ) );
+	if( NULL == range ){
+		return false;
+	}
+	*ranges = range;
+	range = &range[ *range_count ];
+	memset( range, 0, sizeof( ST_SPLIT_RANGE ) );
+	range->Writer.Fd = -1;
 	
-	if( EOF == sscanf( str_datetime, "%d/%d/%d-%d:%d:%d", &year, &month, &day, &hour, &min, &sec ) ){
+	DEBUG_PRINT( "Start		 = %s\n", start_datetime );
+	if( false == get_datetime( start_datetime, &range->Start ) ){
+		printf( "Start datetime format error. [%s]\n", start_datetime );
+		return false;
+	}
+	if( NULL == end_datetime ){
+		DEBUG_PRINT( "End		 = Tail\n" );
+		range->End.MJD = 0xFFFF;
+		range->End.Time = 0xFFFFFFFF;
+		range->End.DateTime = 0xFFFFFFFFFFFFFFFF;
+	}else{
+		DEBUG_PRINT( "End		 = %s\n", end_datetime );
+		if( false == get_datetime( end_datetime, &range->End ) ){
+			printf( "End datetime format error. [%s]\n", end_datetime );
+			return false;
+		}
+	}
+	range->OutFilename = strdup( out_filename );
+	if( NULL == range->OutFilename ){
 		return false;
 	}
+	( *range_count )++;
+	
+	return true;
+}
+
+/**
+* @brief		Load schedule file
+* @param[in]	schedule_filename	Schedule file path
+* @param[in,out]	ranges				Ranges
+* @param[in,out]	range_count			Number of ranges
+* @return		bool				Result
+* @details		One range per line : "start end output". Empty lines and lines starting with '#' are ignored.\n
+*				Example : 2018/09/01-10:00:00 2018/09/01-10:30:00 program1.ts
+*/
+static	bool			load_schedule( const char* schedule_filename, ST_SPLIT_RANGE** ranges, uint32_t* range_count )
+{
+	FILE*		fp;
+	char		line[ 4096 ];
+	char		start_datetime[ 64 ];
+	char		end_datetime[ 64 ];
+	char		out_filename[ 4096 ];
+	uint32_t	line_no = 0;
+	bool		result = true;
 	
-	// Calc MJD
-	if( ( month == 1) || ( month == 2 ) ){
-		year = year - 1;
-		month = month + 12;
+	fp = fopen( schedule_filename, "r" );
+	if( NULL == fp ){
+		printf( "%s()[%d] Schedule file open error. [%s]\n", __func__, __LINE__, schedule_filename );
+		return false;
 	}
-	st_datetime->MJD = floor( 365.25 * year ) + ( year / 400 ) - ( year / 100 ) + floor( 30.59 * ( month - 2 ) ) + day - 678912;
-	st_datetime->Time = hour * 3600 + min * 60 + sec;
 	
-	st_datetime->DateTime = ( ( uint64_t )st_datetime->MJD ) << 32 | ( uint64_t )st_datetime->Time;
+	while( result && fgets( line, sizeof( line ), fp ) ){
+		line_no++;
+		if( ( '#' == line[ 0 ] ) || ( 1 > sscanf( line, "%63s", start_datetime ) ) ){
+			continue;
+		}
+		if( 3 != sscanf( line, "%63s %63s %4095s", start_datetime, end_datetime, out_filename ) ){
+			printf( "Schedule format error. [%s:%u]\n", schedule_filename, line_no );
+			result = false;
+			break;
+		}
+		result = add_range( ranges, range_count, start_datetime, end_datetime, out_filename );
+	}
 	
-	DEBUG_PRINT( "\n\t-----------\n" );
-	DEBUG_PRINT( "\tMJD  %u <= %04d/%02d/%02d\n", st_datetime->MJD, year, month, day );
-	DEBUG_PRINT( "\tTIME %u <= %02d:%02d:%02d\n", st_datetime->Time, hour, min, sec );
-	DEBUG_PRINT( "\tDate TIME %lu\n", st_datetime->DateTime );
-	DEBUG_PRINT( "\t-----------\n" );
+	fclose( fp );
 	
-	return true;
+	return result;
 }
 
 /**
@@ -320,10 +1346,31 @@ static	bool			get_datetime( char* str_datetime, ST_DATETIME* st_datetime )
 */
 static	void			show_help( void )
 {
-	printf( " -i\tInput TS file path.\n" );
+	printf( " -i\tInput TS file path. \"-\" reads stdin.\n" );
 	printf( " -o\tOutput TS file path.\n" );
 	printf( " -s\tStart Date time.(exp 2018/01/02-09:00:00)\n" );
 	printf( " -e\tEnd Date time.(exp 2018/01/02-09:15:00)\n" );
+	printf( "\tRepeat -s/-e/-o to write several ranges in one pass. The n-th -o uses the n-th -s and -e.\n" );
+	printf( " -r\tSchedule file. One range per line : \"start end output\".\n" );
+	printf( " -L\tLive mode. Rotate output every N seconds of TOT time ( 60 = minute, 3600 = hour ).\n" );
+	printf( "\t-i is \"-\" ( stdin ) or \"%saddress:port\", -o is the prefix of the rotated files.\n", TS_LIVE_UDP_PREFIX );
+	printf( " -g\tStart at the random access point ( GOP ) of the video PID before the start TOT, end at the one nearest to the end TOT.\n" );
+	printf( "\tThe index ( input path + \"%s\" ) is built on first use. Needs a seekable input.\n", TS_RAP_INDEX_SUFFIX );
+	printf( " -z\tRestamp PCR / PTS / DTS of each output to start at %d second. Discontinuities are joined.\n", ( int )( TS_RESTAMP_ORIGIN / PCR_CLOCK_EXT ) );
+	printf( " -p\tWrite only these PIDs. Comma separated ( exp 0x100,0x110 ).\n" );
+	printf( " -x\tDrop these PIDs. Comma separated.\n" );
+	printf( " -P\tWrite only this program_number ( PAT, PMT, PCR, ES and TOT ). PAT lists only this program. Can be used with -p.\n" );
+	printf( " -N\tDrop null packets ( PID 0x%04X ).\n", PID_NULL );
+	printf( "\tThe PID filter and -z disable the kernel copy of a seekable input.\n" );
+	printf( " -A\tRead the input and write the outputs from separate threads ( network storage ).\n" );
+	printf( " -D\tDaemon mode. Serve split requests on this Unix domain socket path until SIGINT / SIGTERM.\n" );
+	printf( "\tOne request per line : \"input start end output\" ( end \"-\" is the tail ), one reply per line : \"OK <bytes written>\" or \"ERROR <reason>\".\n" );
+	printf( "\tTOT / RAP indexes of recent recordings are kept in memory. -g -z -p -x -N -A apply to every request.\n" );
+	printf( " -w\tDaemon worker threads. Default %d.\n", DAEMON_WORKERS );
+	printf( " -c\tRecordings whose indexes the daemon keeps. Default %d.\n", DAEMON_CACHE_ENTRIES );
+	printf( " -I\tBuild TOT index file ( input path + \"%s\" ). Existing index is used automatically.\n", TS_TOT_INDEX_SUFFIX );
+	printf( " --no-cache\n\tRead the input with O_DIRECT from a read-ahead thread, so a full scan does not evict the page cache. The kernel copy of a range still uses the cache.\n" );
+	printf( " --stats[=file]\n\tWrite read / seek / resync counters and phase times as one JSON line to stderr or appended to file.\n" );
 	printf( " -h\tShow Help.\n" );
 }
 /**
@@ -332,17 +1379,46 @@ static	void			show_help( void )
 int						main( int args, char* argc[] )
 {
 	char*				in_filename = NULL;
-	char*				out_filename = NULL;
 	
-	char*				start_datetime = NULL;
-	char*				end_datetime = NULL;
+	char*				out_filenames[ MAX_RANGE_OPTIONS ];
+	char*				start_datetimes[ MAX_RANGE_OPTIONS ];
+	char*				end_datetimes[ MAX_RANGE_OPTIONS ];
+	uint32_t			out_count = 0;
+	uint32_t			start_count = 0;
+	uint32_t			end_count = 0;
+	char*				schedule_filename = NULL;
+	
+	ST_SPLIT_RANGE*		ranges = NULL;
+	uint32_t			range_count = 0;
+	uint32_t			r;
 	
-	ST_DATETIME			st_start;
-	ST_DATETIME			st_end;
+	uint32_t			live_period = 0;
+	bool				build_index = false;
+	char				index_filename[ 4096 ];
+	TS_TOT_INDEX		index;
+	bool				use_index = false;
+	bool				snap = false;
+	bool				restamp = false;
+	bool				threaded = false;
+	TS_READER_MODE		reader_mode = TS_READER_MODE_MMAP;
+	TS_RAP_INDEX		rap;
+	bool				use_rap = false;
+	TS_PID_FILTER		filter;
+	bool				use_filter = false;
+	unsigned long		program_number;
+	char*				number_end;
+	bool				stats = false;
+	char*				stats_filename = NULL;
+	char*				socket_path = NULL;
+	uint32_t			workers = DAEMON_WORKERS;
+	uint32_t			cache_entries = DAEMON_CACHE_ENTRIES;
 	
-	char				ch;
+	int					ch;
+	int					result = 0;
 	
-	while( (ch = getopt( args, argc, "i:o:s:e:h") ) != -1 ){
+	ts_pid_filter_init( &filter );
+	
+	while( (ch = getopt_long( args, argc, "i:o:s:e:r:L:gzp:x:P:NAD:w:c:Ih", LongOptions, NULL ) ) != -1 ){
 		if( ch == 255 ){
 			break;
 		}
@@ -351,13 +1427,88 @@ int						main( int args, char* argc[] )
 				in_filename = optarg;
 				break;
 			case 'o':
-				out_filename = optarg;
+				if( MAX_RANGE_OPTIONS <= out_count ){
+					printf( "Too many -o. Use -r schedule file.\n" );
+					return -1;
+				}
+				out_filenames[ out_count++ ] = optarg;
 				break;
 			case 's':
-				start_datetime = optarg;
+				if( MAX_RANGE_OPTIONS <= start_count ){
+					printf( "Too many -s. Use -r schedule file.\n" );
+					return -1;
+				}
+				start_datetimes[ start_count++ ] = optarg;
 				break;
 			case 'e':
-				end_datetime = optarg;
+				if( MAX_RANGE_OPTIONS <= end_count ){
+					printf( "Too many -e. Use -r schedule file.\n" );
+					return -1;
+				}
+				end_datetimes[ end_count++ ] = optarg;
+				break;
+			case 'r':
+				schedule_filename = optarg;
+				break;
+			case 'L':
+				live_period = atol( optarg );
+				break;
+			case 'g':
+				snap = true;
+				break;
+			case 'z':
+				restamp = true;
+				break;
+			case 'p':
+			case 'x':
+				if( !ts_pid_filter_add_list( &filter, optarg, 'p' == ch ) ){
+					printf( "PID list format error. [%s]\n", optarg );
+					ts_pid_filter_free( &filter );
+					return -1;
+				}
+				use_filter = true;
+				break;
+			case 'P':
+				// program_number 0 is the network PID, not a program.
+				program_number = strtoul( optarg, &number_end, 0 );
+				if( ( number_end == optarg ) || ( '\0' != *number_end ) || ( 0 == program_number ) || ( 0xFFFF < program_number ) ){
+					printf( "program_number must be 1 to 65535. [%s]\n", optarg );
+					ts_pid_filter_free( &filter );
+					return -1;
+				}
+				if( ( NULL != filter.Sections ) || !ts_pid_filter_program( &filter, ( uint16_t )program_number ) ){
+					printf( "Program selection error. [%s]\n", optarg );
+					ts_pid_filter_free( &filter );
+					return -1;
+				}
+				use_filter = true;
+				break;
+			case 'N':
+				ts_pid_filter_exclude( &filter, PID_NULL );
+				use_filter = true;
+				break;
+			case 'A':
+				threaded = true;
+				reader_mode = TS_READER_MODE_THREAD;
+				break;
+			case 'D':
+				socket_path = optarg;
+				break;
+			case 'w':
+				workers = atol( optarg );
+				break;
+			case 'c':
+				cache_entries = atol( optarg );
+				break;
+			case 'I':
+				build_index = true;
+				break;
+			case OPTION_NO_CACHE:
+				reader_mode = TS_READER_MODE_DIRECT;
+				break;
+			case OPTION_STATS:
+				stats = true;
+				stats_filename = optarg;
 				break;
 			case 'h':
 			default:
@@ -367,53 +1518,132 @@ int						main( int args, char* argc[] )
 		}
 	}
 	
+	if( NULL != socket_path ){
+		if( ( NULL != filter.Sections ) || stats || ( 0 == workers ) || ( 0 == cache_entries ) ){
+			printf( "-D needs -w and -c over 0, and can not be used with -P or --stats.\n" );
+			result = -1;
+			goto end;
+		}
+		result = ts_split_daemon( socket_path, workers, cache_entries, reader_mode, snap, restamp, threaded, use_filter ? &filter : NULL ) ? 0 : -1;
+		goto end;
+	}
+	
 	if( NULL == in_filename ){
 		printf( "Please input IN File. -i filepath \n" );
+		return -1;
+	}
+	if( stats ){
+		ts_stats_enable();
+	}
+	
+	if( 0 < live_period ){
+		if( 1 != out_count ){
+			printf( "Please input one Out File prefix. -o prefix \n" );
+			return -1;
+		}
+		ts_stats_phase( TS_STATS_PHASE_SCAN );
+		result = ts_split_live( in_filename, out_filenames[ 0 ], live_period ) ? 0 : -1;
+		goto end;
 	}
-	if( NULL == out_filename ){
+	
+	ts_tot_index_path( in_filename, index_filename, sizeof( index_filename ) );
+	if( build_index ){
+		if( !ts_build_index( in_filename, reader_mode, index_filename, &index ) ){
+			result = -1;
+			goto end;
+		}
+		use_index = true;
+		if( ( 0 == out_count ) && ( NULL == schedule_filename ) ){
+			goto end;
+		}
+	}
+	
+	if( ( 0 == out_count ) && ( NULL == schedule_filename ) ){
 		printf( "Please input Out File. -o filepath \n" );
+		result = -1;
 	}
-	if( NULL == start_datetime && NULL == start_datetime ){
+	if( start_count < out_count ){
 		printf( "Please input Start Datetime. -s starttime \n" );
-		printf( "Please input End Datetime. -s starttime \n" );
+		result = -1;
 	}
-	if( 	NULL == in_filename 
-		||	NULL == out_filename
-		||	( NULL == start_datetime && NULL == start_datetime ) ){
-		return -1;
+	if( 0 != result ){
+		goto end;
+	}
+	
+	for( r = 0 ; r < out_count ; r++ ){
+		if( !add_range( &ranges, &range_count, start_datetimes[ r ], ( r < end_count ) ? end_datetimes[ r ] : NULL, out_filenames[ r ] ) ){
+			result = -1;
+			goto end;
+		}
+	}
+	if( ( NULL != schedule_filename ) && !load_schedule( schedule_filename, &ranges, &range_count ) ){
+		result = -1;
+		goto end;
+	}
+	if( 0 == range_count ){
+		printf( "No range to split.\n" );
+		result = -1;
+		goto end;
 	}
 	
 	printf( "IN File	 = %s\n", in_filename );
-	printf( "OUT File	 = %s\n", out_filename );
-	if( NULL == start_datetime ){
-		DEBUG_PRINT( "Start		 = Head\n" );
-		st_start.MJD = 0;
-		st_start.Time = 0;
-		st_start.DateTime = 0xFFFFFFFFFFFFFFFF;
-	}else{
-		DEBUG_PRINT( "Start		 = %s\n", start_datetime );
-		if( false == get_datetime( start_datetime, &st_start ) ){
-			printf( "Start datetime format error.\n" );
-			return -1;
+	
+	if( !use_index ){
+		use_index = ts_tot_index_load( index_filename, in_filename, &index );
+		if( use_index ){
+			printf( "Index File	 = %s\n", index_filename );
 		}
 	}
-	if( NULL == end_datetime ){
-		DEBUG_PRINT( "End		 = Tail\n" );
-		st_end.MJD = 0xFFFF;
-		st_end.Time = 0xFFFFFFFF;
-		st_end.DateTime = 0xFFFFFFFFFFFFFFFF;
-	}else{
-		DEBUG_PRINT( "End		 = %s\n", end_datetime );
-		if( false == get_datetime( end_datetime, &st_end ) ){
-			printf( "End datetime format error.\n" );
-			return -1;
+	
+	if( snap ){
+		struct stat		st;
+		
+		if(    ( 0 == ( ( 0 == strcmp( in_filename, "-" ) ) ? fstat( STDIN_FILENO, &st ) : stat( in_filename, &st ) ) )
+			&& !S_ISREG( st.st_mode ) ){
+			// The index needs a scan of the whole input before the split.
+			printf( "-g needs a seekable input file, not a pipe. [%s]\n", in_filename );
+			result = -1;
+			goto end;
+		}
+		if( !ts_load_rap_index( in_filename, reader_mode, &rap ) ){
+			result = -1;
+			goto end;
+		}
+		use_rap = true;
+	}
+	
+	if( !ts_split( in_filename, reader_mode, ranges, range_count, use_index ? &index : NULL, use_rap ? &rap : NULL, use_filter ? &filter : NULL, restamp, threaded ) ){
+		printf( "Split is error.\n" );
+		result = -1;
+	}
+	for( r = 0 ; r < range_count ; r++ ){
+		if( ( 0 != ranges[ r ].TotalPacket ) || ( 0 != ranges[ r ].CopiedBytes ) ){
+			continue;
 		}
+		// Nothing is written. The empty file is removed as the daemon does for "ERROR tot".
+		if( 0 == result ){
+			printf( "No TOT in the range. [%s]\n", ranges[ r ].OutFilename );
+		}
+		unlink( ranges[ r ].OutFilename );
+		result = -1;
 	}
 	
-	if( !ts_split( in_filename, out_filename, &st_start, &st_end ) ){
-		perror( "Split is error.\n" );
+end:
+	if( use_index ){
+		ts_tot_index_free( &index );
+	}
+	if( use_rap ){
+		ts_rap_index_free( &rap );
 	}
+	ts_pid_filter_free( &filter );
+	for( r = 0 ; r < range_count ; r++ ){
+		free( ranges[ r ].OutFilename );
+	}
+	free( ranges );
 	
-	return 0;
+	if( !ts_stats_report( stats_filename, "ts_tot_spliter", in_filename ) ){
+		perror( "Stats output." );
+	}
+	
+	return result;
 }
-